@@ -0,0 +1,473 @@
+/**
+ * @file SchedulerBenchmarks.cpp
+ *
+ * This module contains benchmarks of the Twarlock::Twitch API call
+ * scheduler.  API calls are made through a fake transport which answers
+ * every request right away, so that only the cost of the scheduler
+ * (and the HTTP client beneath it) is measured.
+ *
+ * The largest benchmarks can be skipped by setting the
+ * TWARLOCK_BENCHMARK_MAX_CALLS environment variable to the largest
+ * number of API calls to make in one benchmark.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "TimeKeeper.hpp"
+#include "Twitch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <gtest/gtest.h>
+#include <Http/Connection.hpp>
+#include <Http/IClientTransport.hpp>
+#include <inttypes.h>
+#include <Json/Value.hpp>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    /**
+     * This counts the memory allocations made by all threads, so that
+     * the number of allocations made per API call can be reported.
+     */
+    std::atomic< size_t > allocations(0);
+
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    const auto memory = malloc((size == 0) ? 1 : size);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+namespace {
+
+    /**
+     * This is the response the fake transport gives to every request.
+     */
+    const std::string fakeResponse = (
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 11\r\n"
+        "\r\n"
+        "{\"data\":[]}"
+    );
+
+    class FakeConnection;
+
+    /**
+     * This answers the requests sent through fake connections,
+     * from a thread of its own, as a network would.
+     */
+    class Responder {
+        // Public Methods
+    public:
+        Responder() {
+            worker_ = std::thread(&Responder::Worker, this);
+        }
+
+        ~Responder() noexcept {
+            {
+                std::lock_guard< decltype(mutex_) > lock(mutex_);
+                stop_ = true;
+                wakeCondition_.notify_all();
+            }
+            worker_.join();
+        }
+
+        /**
+         * This method queues a response to be given on the given
+         * connection.
+         *
+         * @param[in] connection
+         *     This is the connection on which to give the response.
+         */
+        void Post(std::weak_ptr< FakeConnection > connection) {
+            std::lock_guard< decltype(mutex_) > lock(mutex_);
+            connections_.push_back(std::move(connection));
+            wakeCondition_.notify_all();
+        }
+
+        // Private Methods
+    private:
+        void Worker();
+
+        // Private Properties
+    private:
+        std::mutex mutex_;
+        std::condition_variable wakeCondition_;
+        std::deque< std::weak_ptr< FakeConnection > > connections_;
+        bool stop_ = false;
+        std::thread worker_;
+    };
+
+    /**
+     * This is a connection which is answered by a Responder
+     * rather than a server.
+     */
+    class FakeConnection
+        : public Http::Connection
+        , public std::enable_shared_from_this< FakeConnection >
+    {
+        // Public Methods
+    public:
+        FakeConnection(
+            std::shared_ptr< Responder > responder,
+            DataReceivedDelegate dataReceivedDelegate,
+            BrokenDelegate brokenDelegate
+        )
+            : responder_(responder)
+            , dataReceivedDelegate_(dataReceivedDelegate)
+            , brokenDelegate_(brokenDelegate)
+        {
+        }
+
+        /**
+         * This method gives the fake response to the client.
+         */
+        void Respond() {
+            std::unique_lock< decltype(mutex_) > lock(mutex_);
+            const auto dataReceivedDelegate = dataReceivedDelegate_;
+            lock.unlock();
+            if (dataReceivedDelegate != nullptr) {
+                dataReceivedDelegate(
+                    std::vector< uint8_t >(
+                        fakeResponse.begin(),
+                        fakeResponse.end()
+                    )
+                );
+            }
+        }
+
+        // Http::Connection
+    public:
+        virtual std::string GetPeerAddress() override {
+            return "127.0.0.1";
+        }
+
+        virtual std::string GetPeerId() override {
+            return "127.0.0.1:443";
+        }
+
+        virtual void SetDataReceivedDelegate(DataReceivedDelegate dataReceivedDelegate) override {
+            std::lock_guard< decltype(mutex_) > lock(mutex_);
+            dataReceivedDelegate_ = dataReceivedDelegate;
+        }
+
+        virtual void SetBrokenDelegate(BrokenDelegate brokenDelegate) override {
+            std::lock_guard< decltype(mutex_) > lock(mutex_);
+            brokenDelegate_ = brokenDelegate;
+        }
+
+        virtual void SendData(const std::vector< uint8_t >& data) override {
+            std::unique_lock< decltype(mutex_) > lock(mutex_);
+            request_.append(data.begin(), data.end());
+
+            // The requests made by the benchmarks have no body, so each
+            // one ends with the blank line after its headers.
+            size_t numRequests = 0;
+            for (;;) {
+                const auto endOfHeaders = request_.find("\r\n\r\n");
+                if (endOfHeaders == std::string::npos) {
+                    break;
+                }
+                request_.erase(0, endOfHeaders + 4);
+                ++numRequests;
+            }
+            lock.unlock();
+            while (numRequests-- > 0) {
+                responder_->Post(shared_from_this());
+            }
+        }
+
+        virtual void Break(bool clean) override {
+            std::unique_lock< decltype(mutex_) > lock(mutex_);
+            const auto brokenDelegate = brokenDelegate_;
+            brokenDelegate_ = nullptr;
+            dataReceivedDelegate_ = nullptr;
+            lock.unlock();
+            if (brokenDelegate != nullptr) {
+                brokenDelegate(clean);
+            }
+        }
+
+        // Private Properties
+    private:
+        std::mutex mutex_;
+        std::shared_ptr< Responder > responder_;
+        DataReceivedDelegate dataReceivedDelegate_;
+        BrokenDelegate brokenDelegate_;
+
+        /**
+         * This holds the part of a request received so far.
+         */
+        std::string request_;
+    };
+
+    void Responder::Worker() {
+        std::unique_lock< decltype(mutex_) > lock(mutex_);
+        for (;;) {
+            wakeCondition_.wait(
+                lock,
+                [this]{
+                    return (
+                        stop_
+                        || !connections_.empty()
+                    );
+                }
+            );
+            if (stop_) {
+                break;
+            }
+            const auto connection = connections_.front().lock();
+            connections_.pop_front();
+            lock.unlock();
+            if (connection != nullptr) {
+                connection->Respond();
+            }
+            lock.lock();
+        }
+    }
+
+    /**
+     * This is a transport which makes fake connections, answered
+     * by a Responder.
+     */
+    class FakeTransport
+        : public Http::IClientTransport
+    {
+        // Http::IClientTransport
+    public:
+        virtual std::shared_ptr< Http::Connection > Connect(
+            const std::string& scheme,
+            const std::string& hostNameOrAddress,
+            uint16_t port,
+            Http::Connection::DataReceivedDelegate dataReceivedDelegate,
+            Http::Connection::BrokenDelegate brokenDelegate
+        ) override {
+            return std::make_shared< FakeConnection >(
+                responder_,
+                dataReceivedDelegate,
+                brokenDelegate
+            );
+        }
+
+        // Private Properties
+    private:
+        std::shared_ptr< Responder > responder_ = std::make_shared< Responder >();
+    };
+
+    /**
+     * This returns the largest number of API calls a benchmark
+     * may make, as configured by the TWARLOCK_BENCHMARK_MAX_CALLS
+     * environment variable.
+     *
+     * @return
+     *     The largest number of API calls a benchmark may make
+     *     is returned.
+     */
+    size_t GetMaxCalls() {
+        const auto maxCalls = getenv("TWARLOCK_BENCHMARK_MAX_CALLS");
+        if (maxCalls == nullptr) {
+            return SIZE_MAX;
+        }
+        return (size_t)strtoull(maxCalls, NULL, 10);
+    }
+
+    /**
+     * This function posts the given number of API calls to a Twitch
+     * instance using the fake transport, waits for all of them to
+     * complete, and reports how long it took and how many memory
+     * allocations were made.  The scheduler's own statistics, such as
+     * how long calls waited before being dispatched and how long
+     * callbacks took, are reported when the instance is demobilized.
+     *
+     * @param[in] numCalls
+     *     This is the number of API calls to make.
+     *
+     * @param[in] maxConcurrentRequests
+     *     This is the maximum number of API calls which may be in
+     *     progress at the same time.
+     *
+     * @param[in] mixPriorities
+     *     This indicates whether or not to cycle the API calls through
+     *     all priorities, rather than making them all normal priority.
+     *
+     * @param[in] traceDiagnostics
+     *     This indicates whether or not to also subscribe to diagnostic
+     *     messages at level 0, where every request is traced, so that
+     *     the cost of formatting and delivering those messages
+     *     is included.
+     */
+    void RunBenchmark(
+        size_t numCalls,
+        int maxConcurrentRequests,
+        bool mixPriorities,
+        bool traceDiagnostics = false
+    ) {
+        if (numCalls > GetMaxCalls()) {
+            printf("Skipped (more than TWARLOCK_BENCHMARK_MAX_CALLS calls)\n");
+            return;
+        }
+        Twarlock::Twitch twitch;
+        const auto diagnosticsSubscription = twitch.SubscribeToDiagnostics(
+            [](
+                std::string senderName,
+                size_t level,
+                std::string message
+            ){
+                printf("%s\n", message.c_str());
+            },
+            2
+        );
+        std::atomic< size_t > traceMessages(0);
+        SystemAbstractions::DiagnosticsSender::UnsubscribeDelegate traceSubscription;
+        if (traceDiagnostics) {
+            traceSubscription = twitch.SubscribeToDiagnostics(
+                [&traceMessages](
+                    std::string senderName,
+                    size_t level,
+                    std::string message
+                ){
+                    ++traceMessages;
+                },
+                0
+            );
+        }
+        twitch.SetTransport(std::make_shared< FakeTransport >());
+        auto configuration = Json::Object();
+        configuration.Set("clientId", "benchmark");
+        configuration.Set("oauthToken", "benchmark");
+        configuration.Set("rateLimit", 2000000000);
+        configuration.Set("maxConcurrentRequests", maxConcurrentRequests);
+        configuration.Set("schedulerStats", true);
+        twitch.Mobilize(
+            configuration,
+            "",
+            std::make_shared< Twarlock::TimeKeeper >()
+        );
+        std::mutex mutex;
+        std::condition_variable completedCondition;
+        size_t numSucceeded = 0;
+        size_t numFailed = 0;
+        const auto onComplete = [&](bool success){
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (success) {
+                ++numSucceeded;
+            } else {
+                ++numFailed;
+            }
+            if (numSucceeded + numFailed == numCalls) {
+                completedCondition.notify_all();
+            }
+        };
+        static const Twarlock::Twitch::Priority priorities[] = {
+            Twarlock::Twitch::Priority::Interactive,
+            Twarlock::Twitch::Priority::Normal,
+            Twarlock::Twitch::Priority::Bulk,
+        };
+        static const size_t numPriorities = sizeof(priorities) / sizeof(priorities[0]);
+        const auto allocationsBefore = allocations.load();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numCalls; ++i) {
+            twitch.PostApiCall(
+                Twarlock::Twitch::Api::Helix,
+                "users?id=" + std::to_string(i),
+                [onComplete](Json::Value&& response){ onComplete(true); },
+                [onComplete](unsigned int statusCode){ onComplete(false); },
+                (
+                    mixPriorities
+                    ? priorities[i % numPriorities]
+                    : Twarlock::Twitch::Priority::Normal
+                )
+            );
+        }
+        const auto posted = std::chrono::steady_clock::now();
+        const auto allocationsPosting = allocations.load() - allocationsBefore;
+        {
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            completedCondition.wait(
+                lock,
+                [&]{ return (numSucceeded + numFailed == numCalls); }
+            );
+        }
+        const auto finished = std::chrono::steady_clock::now();
+        const auto allocationsTotal = allocations.load() - allocationsBefore;
+        const auto postingTime = std::chrono::duration< double >(posted - start).count();
+        const auto totalTime = std::chrono::duration< double >(finished - start).count();
+        printf(
+            "%zu calls, %d at a time%s%s: posted in %.3lf s (%.3lf us per call),"
+            " completed in %.3lf s (%.0lf calls per second)\n",
+            numCalls,
+            maxConcurrentRequests,
+            (mixPriorities ? ", mixed priorities" : ""),
+            (traceDiagnostics ? ", level 0 subscriber" : ""),
+            postingTime,
+            postingTime * 1000000.0 / (double)numCalls,
+            totalTime,
+            (double)numCalls / totalTime
+        );
+        printf(
+            "Allocations per call: %.1lf posting, %.1lf in total\n",
+            (double)allocationsPosting / (double)numCalls,
+            (double)allocationsTotal / (double)numCalls
+        );
+        if (traceDiagnostics) {
+            printf(
+                "Trace messages per call: %.1lf\n",
+                (double)traceMessages.load() / (double)numCalls
+            );
+        }
+        twitch.Demobilize();
+        if (traceSubscription != nullptr) {
+            traceSubscription();
+        }
+        diagnosticsSubscription();
+        EXPECT_EQ(numCalls, numSucceeded);
+        EXPECT_EQ((size_t)0, numFailed);
+    }
+
+}
+
+TEST(SchedulerBenchmarks, TenThousandCalls) {
+    RunBenchmark(10000, 16, false);
+}
+
+TEST(SchedulerBenchmarks, OneHundredThousandCalls) {
+    RunBenchmark(100000, 16, false);
+}
+
+TEST(SchedulerBenchmarks, OneMillionCalls) {
+    RunBenchmark(1000000, 16, false);
+}
+
+TEST(SchedulerBenchmarks, OneHundredThousandCallsOneAtATime) {
+    RunBenchmark(100000, 1, false);
+}
+
+TEST(SchedulerBenchmarks, OneHundredThousandCallsMixedPriorities) {
+    RunBenchmark(100000, 16, true);
+}
+
+TEST(SchedulerBenchmarks, OneHundredThousandCallsWithAndWithoutTraceSubscriber) {
+    RunBenchmark(100000, 16, false, false);
+    RunBenchmark(100000, 16, false, true);
+}
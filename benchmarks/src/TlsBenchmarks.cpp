@@ -0,0 +1,311 @@
+/**
+ * @file TlsBenchmarks.cpp
+ *
+ * This module contains benchmarks of preparing the CA certificates
+ * trusted when connecting to Twitch, and of the TLS handshakes made
+ * with them.  Handshakes are made with a local server, whose certificate
+ * is signed by the benchmark CA in the "certs" directory, so that only
+ * the cost of the handshake itself is measured.
+ *
+ * The CA certificate bundle used is the one found next to the benchmark
+ * program, or the one at the path given by the
+ * TWARLOCK_BENCHMARK_CA_BUNDLE environment variable.  The benchmark CA
+ * is added to the end of it, so that the whole bundle has to be parsed
+ * before the server can be trusted.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "CaCerts.hpp"
+#include "LoadFile.hpp"
+
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <SystemAbstractions/File.hpp>
+#include <SystemAbstractions/NetworkConnection.hpp>
+#include <SystemAbstractions/NetworkEndpoint.hpp>
+#include <TlsDecorator/TlsDecorator.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the address of the local server.
+     */
+    constexpr uint32_t localhost = 0x7F000001;
+
+    /**
+     * This is the number of handshakes made in each benchmark.
+     */
+    constexpr size_t numHandshakes = 100;
+
+    /**
+     * This is the number of times the bundle is extracted in the
+     * extraction benchmark.
+     */
+    constexpr size_t numExtractions = 100;
+
+    /**
+     * This is the number of seconds to wait for a handshake to complete
+     * before giving up.
+     */
+    constexpr int handshakeTimeoutSeconds = 10;
+
+    /**
+     * This loads the file at the given path.
+     *
+     * @param[in] path
+     *     This is the path of the file to load.
+     *
+     * @param[out] contents
+     *     This is where to store the contents of the file.
+     *
+     * @return
+     *     An indication of whether or not the file was loaded is returned.
+     */
+    bool Load(
+        const std::string& path,
+        std::string& contents
+    ) {
+        SystemAbstractions::DiagnosticsSender diagnosticsSender("TlsBenchmarks");
+        (void)diagnosticsSender.SubscribeToDiagnostics(
+            [](
+                std::string senderName,
+                size_t level,
+                std::string message
+            ){
+                printf("%s\n", message.c_str());
+            },
+            SystemAbstractions::DiagnosticsSender::Levels::WARNING
+        );
+        return Twarlock::LoadFile(path, "benchmark file", diagnosticsSender, contents);
+    }
+
+    /**
+     * This loads the CA certificate bundle to use in the benchmarks,
+     * with the benchmark CA added to the end.
+     *
+     * @param[out] bundle
+     *     This is where to store the bundle.
+     *
+     * @return
+     *     An indication of whether or not the bundle was loaded is returned.
+     */
+    bool LoadBundle(std::string& bundle) {
+        std::string bundlePath = SystemAbstractions::File::GetExeParentDirectory() + "/cert.pem";
+        const auto bundlePathOverride = getenv("TWARLOCK_BENCHMARK_CA_BUNDLE");
+        if (bundlePathOverride != nullptr) {
+            bundlePath = bundlePathOverride;
+        }
+        std::string benchmarkCa;
+        if (
+            !Load(bundlePath, bundle)
+            || !Load(std::string(TWARLOCK_BENCHMARK_CERTS_DIR) + "/ca.pem", benchmarkCa)
+        ) {
+            return false;
+        }
+        bundle += "\n";
+        bundle += benchmarkCa;
+        return true;
+    }
+
+    /**
+     * This is a local TLS server which echoes back whatever it receives.
+     */
+    class EchoServer {
+        // Public Methods
+    public:
+        ~EchoServer() noexcept {
+            endpoint_.Close();
+            std::lock_guard< decltype(mutex_) > lock(mutex_);
+            for (const auto& connection: connections_) {
+                connection->Close(false);
+            }
+        }
+
+        /**
+         * This method starts the server listening on an ephemeral port.
+         *
+         * @return
+         *     An indication of whether or not the server started
+         *     is returned.
+         */
+        bool Start() {
+            std::string cert;
+            std::string key;
+            if (
+                !Load(std::string(TWARLOCK_BENCHMARK_CERTS_DIR) + "/server.pem", cert)
+                || !Load(std::string(TWARLOCK_BENCHMARK_CERTS_DIR) + "/server-key.pem", key)
+            ) {
+                return false;
+            }
+            return endpoint_.Open(
+                [this, cert, key](std::shared_ptr< SystemAbstractions::NetworkConnection > connection){
+                    const auto tls = std::make_shared< TlsDecorator::TlsDecorator >();
+                    tls->ConfigureAsServer(connection, cert, key, "");
+                    std::weak_ptr< TlsDecorator::TlsDecorator > tlsWeak(tls);
+                    if (
+                        !tls->Process(
+                            [tlsWeak](const std::vector< uint8_t >& message){
+                                const auto tls = tlsWeak.lock();
+                                if (tls != nullptr) {
+                                    tls->SendMessage(message);
+                                }
+                            },
+                            [](bool graceful){}
+                        )
+                    ) {
+                        return;
+                    }
+                    std::lock_guard< decltype(mutex_) > lock(mutex_);
+                    connections_.push_back(tls);
+                },
+                [](uint32_t address, uint16_t port, const std::vector< uint8_t >& body){},
+                SystemAbstractions::NetworkEndpoint::Mode::Connection,
+                localhost,
+                0,
+                0
+            );
+        }
+
+        /**
+         * This method returns the port on which the server is listening.
+         *
+         * @return
+         *     The port on which the server is listening is returned.
+         */
+        uint16_t GetPort() {
+            return endpoint_.GetBoundPort();
+        }
+
+        // Private Properties
+    private:
+        SystemAbstractions::NetworkEndpoint endpoint_;
+        std::mutex mutex_;
+        std::vector< std::shared_ptr< TlsDecorator::TlsDecorator > > connections_;
+    };
+
+    /**
+     * This makes a connection to the given local server, trusting the
+     * given CA certificates, and waits for a message to be echoed back,
+     * which can only happen once the handshake is complete.
+     *
+     * @param[in] caCerts
+     *     These are the CA certificates to trust.
+     *
+     * @param[in] port
+     *     This is the port on which the server is listening.
+     *
+     * @return
+     *     An indication of whether or not the handshake completed
+     *     is returned.
+     */
+    bool Handshake(
+        const std::string& caCerts,
+        uint16_t port
+    ) {
+        const auto connection = std::make_shared< SystemAbstractions::NetworkConnection >();
+        const auto tls = std::make_shared< TlsDecorator::TlsDecorator >();
+        tls->ConfigureAsClient(connection, caCerts, "localhost");
+        const auto echoed = std::make_shared< std::promise< bool > >();
+        const auto answered = std::make_shared< std::once_flag >();
+        if (
+            !tls->Connect(localhost, port)
+            || !tls->Process(
+                [echoed, answered](const std::vector< uint8_t >& message){
+                    std::call_once(*answered, [&]{ echoed->set_value(true); });
+                },
+                [echoed, answered](bool graceful){
+                    std::call_once(*answered, [&]{ echoed->set_value(false); });
+                }
+            )
+        ) {
+            return false;
+        }
+        tls->SendMessage({'x'});
+        auto echoedFuture = echoed->get_future();
+        const auto success = (
+            (echoedFuture.wait_for(std::chrono::seconds(handshakeTimeoutSeconds)) == std::future_status::ready)
+            && echoedFuture.get()
+        );
+        tls->Close(false);
+        return success;
+    }
+
+    /**
+     * This makes a number of handshakes with the given local server,
+     * trusting the given CA certificates, and reports how long they took.
+     *
+     * @param[in] description
+     *     This describes the CA certificates trusted.
+     *
+     * @param[in] caCerts
+     *     These are the CA certificates to trust.
+     *
+     * @param[in] port
+     *     This is the port on which the server is listening.
+     */
+    void RunHandshakes(
+        const char* description,
+        const std::string& caCerts,
+        uint16_t port
+    ) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numHandshakes; ++i) {
+            ASSERT_TRUE(Handshake(caCerts, port)) << description;
+        }
+        const auto totalTime = std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        printf(
+            "%zu handshakes trusting %s (%zu bytes): %.3lf s (%.3lf ms per handshake)\n",
+            numHandshakes,
+            description,
+            caCerts.length(),
+            totalTime,
+            totalTime * 1000.0 / (double)numHandshakes
+        );
+    }
+
+}
+
+TEST(TlsBenchmarks, ExtractCaCerts) {
+    std::string bundle;
+    ASSERT_TRUE(LoadBundle(bundle));
+    size_t numCerts = 0;
+    std::string extracted;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numExtractions; ++i) {
+        extracted = Twarlock::ExtractCaCerts(bundle, numCerts);
+    }
+    const auto totalTime = std::chrono::duration< double >(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    ASSERT_GT(numCerts, 0);
+    printf(
+        "Extracted %zu certificates (%zu of %zu bytes kept) in %.3lf ms\n",
+        numCerts,
+        extracted.length(),
+        bundle.length(),
+        totalTime * 1000.0 / (double)numExtractions
+    );
+}
+
+TEST(TlsBenchmarks, HandshakesWithRawAndExtractedBundle) {
+    std::string bundle;
+    ASSERT_TRUE(LoadBundle(bundle));
+    size_t numCerts = 0;
+    const auto extracted = Twarlock::ExtractCaCerts(bundle, numCerts);
+    EchoServer server;
+    ASSERT_TRUE(server.Start());
+    RunHandshakes("raw bundle", bundle, server.GetPort());
+    RunHandshakes("extracted bundle", extracted, server.GetPort());
+}
@@ -0,0 +1,573 @@
+/**
+ * @file RegressionTests.cpp
+ *
+ * This module contains end-to-end regression tests of Twarlock.  Each
+ * test starts a local stand-in for Twitch, serving the fixtures in the
+ * "fixtures" directory over HTTPS with a certificate signed by the
+ * benchmark CA, runs the Twarlock program against it, and checks what
+ * the program wrote out against the fixtures.
+ *
+ * Each run reports how long it took, how many requests it made,
+ * how much CPU time it used, and its peak resident set size, so that
+ * changes in the cost of a command show up from one build to the next.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "StandInServer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <functional>
+#include <gtest/gtest.h>
+#include <Json/Value.hpp>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <StringExtensions/StringExtensions.hpp>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the number of seconds the stand-in server waits before
+     * sending each response, unless a test says otherwise, so that
+     * requests overlap the way they do with Twitch.
+     */
+    constexpr double defaultLatency = 0.005;
+
+    /**
+     * This is the largest number of list entries the stand-in server puts
+     * in one page, so that the fixtures span several pages.
+     */
+    constexpr size_t pageSize = 7;
+
+    /**
+     * This holds what happened when the Twarlock program was run.
+     */
+    struct RunResult {
+        /**
+         * This is the exit status of the program, or -1 if it didn't
+         * exit normally.
+         */
+        int exitStatus = -1;
+
+        /**
+         * This is the number of seconds the program ran.
+         */
+        double wallTime = 0.0;
+
+        /**
+         * This is the number of seconds of CPU time the program used,
+         * in user and system mode together.
+         */
+        double cpuTime = 0.0;
+
+        /**
+         * This is the peak resident set size of the program, in kilobytes.
+         */
+        long peakRss = 0;
+
+        /**
+         * These are counts of what the stand-in server did for the run.
+         */
+        Twarlock::StandInServer::Statistics statistics;
+
+        /**
+         * These are the records written by the program in the
+         * "ndjson" format.
+         */
+        std::vector< Json::Value > records;
+
+        /**
+         * This is what the program wrote to its standard output stream.
+         */
+        std::string output;
+
+        /**
+         * This is what the program wrote to its standard error stream.
+         */
+        std::string log;
+    };
+
+    /**
+     * This reads the whole file at the given path.
+     *
+     * @param[in] path
+     *     This is the path of the file to read.
+     *
+     * @return
+     *     The contents of the file, or an empty string if the file
+     *     couldn't be read, are returned.
+     */
+    std::string ReadWholeFile(const std::string& path) {
+        std::string contents;
+        const auto file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            return contents;
+        }
+        char buffer[65536];
+        size_t amountRead;
+        while ((amountRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            contents.append(buffer, amountRead);
+        }
+        (void)fclose(file);
+        return contents;
+    }
+
+    /**
+     * This writes the given contents to the file at the given path,
+     * replacing anything already there.
+     *
+     * @param[in] path
+     *     This is the path of the file to write.
+     *
+     * @param[in] contents
+     *     This is what to write to the file.
+     *
+     * @return
+     *     An indication of whether or not the file was written
+     *     is returned.
+     */
+    bool WriteWholeFile(
+        const std::string& path,
+        const std::string& contents
+    ) {
+        const auto file = fopen(path.c_str(), "wb");
+        if (file == NULL) {
+            return false;
+        }
+        const auto written = (fwrite(contents.data(), 1, contents.length(), file) == contents.length());
+        return (
+            (fclose(file) == 0)
+            && written
+        );
+    }
+
+    /**
+     * This returns the given record as one string, holding the values
+     * of the given fields separated by vertical bars, so that records
+     * can be compared and sorted.
+     *
+     * @param[in] record
+     *     This is the record to flatten.
+     *
+     * @param[in] fields
+     *     These are the names of the fields to include.
+     *
+     * @return
+     *     The record, flattened into one string, is returned.
+     */
+    std::string Flatten(
+        const Json::Value& record,
+        const std::vector< std::string >& fields
+    ) {
+        std::string flattened;
+        for (const auto& field: fields) {
+            if (!flattened.empty()) {
+                flattened += '|';
+            }
+            flattened += (std::string)record[field];
+        }
+        return flattened;
+    }
+
+    /**
+     * This returns the given records, flattened and sorted.
+     *
+     * @param[in] records
+     *     These are the records to flatten and sort.
+     *
+     * @param[in] fields
+     *     These are the names of the fields to include.
+     *
+     * @return
+     *     The given records, flattened and sorted, are returned.
+     */
+    std::vector< std::string > FlattenAll(
+        const std::vector< Json::Value >& records,
+        const std::vector< std::string >& fields
+    ) {
+        std::vector< std::string > flattened;
+        for (const auto& record: records) {
+            flattened.push_back(Flatten(record, fields));
+        }
+        std::sort(flattened.begin(), flattened.end());
+        return flattened;
+    }
+
+}
+
+/**
+ * This is the test fixture for these tests, providing common
+ * setup and teardown for each test.
+ */
+struct RegressionTests
+    : public ::testing::Test
+{
+    // Properties
+
+    /**
+     * These are the users, follows, bans, ban events, channels and
+     * tokens served by the stand-in server.
+     */
+    Json::Value fixtures;
+
+    /**
+     * These are the display names of the users in the fixtures,
+     * keyed by ID.
+     */
+    std::map< std::string, std::string > displayNames;
+
+    /**
+     * This is the directory holding the files made for each run.
+     */
+    std::string scratchPath;
+
+    /**
+     * These are the settings which shape how the stand-in server
+     * behaves in the next run.
+     */
+    Twarlock::StandInServer::Configuration serverConfiguration;
+
+    // Methods
+
+    /**
+     * This method runs the Twarlock program with the given arguments
+     * against a fresh stand-in server, and reports how much it cost.
+     *
+     * @param[in] description
+     *     This describes the run, for the report.
+     *
+     * @param[in] args
+     *     These are the command and arguments to give the program.
+     *
+     * @param[out] run
+     *     This is where to store what happened.
+     */
+    void RunTwarlock(
+        const std::string& description,
+        const std::vector< std::string >& args,
+        RunResult& run
+    ) {
+        Twarlock::StandInServer server;
+        ASSERT_TRUE(
+            server.Start(
+                TWARLOCK_REGRESSION_FIXTURES_DIR "/twitch.json",
+                TWARLOCK_REGRESSION_CERTS_DIR,
+                serverConfiguration
+            )
+        );
+        const auto host = StringExtensions::sprintf("localhost:%u", (unsigned int)server.GetPort());
+        auto configuration = Json::Object();
+        configuration.Set("apiHost", host);
+        configuration.Set("idHost", host);
+        configuration.Set("caCerts", TWARLOCK_REGRESSION_CERTS_DIR "/ca.pem");
+        configuration.Set("clientId", "regression");
+        configuration.Set("oauthToken", "regression-token-1");
+        auto scopes = Json::Array();
+        scopes.Add("moderation:read");
+        configuration.Set("scopes", scopes);
+        auto secondCredential = Json::Object();
+        secondCredential.Set("oauthToken", "regression-token-2");
+        auto secondScopes = Json::Array();
+        secondScopes.Add("user:read:email");
+        secondCredential.Set("scopes", secondScopes);
+        auto credentials = Json::Array();
+        credentials.Add(secondCredential);
+        configuration.Set("credentials", credentials);
+        auto retry = Json::Object();
+        retry.Set("baseDelay", 0.05);
+        retry.Set("maxDelay", 1.0);
+        configuration.Set("retry", retry);
+        configuration.Set("diagnosticsThreshold", (int)SystemAbstractions::DiagnosticsSender::Levels::WARNING);
+        const auto configurationPath = scratchPath + "/Twarlock.json";
+        const auto recordsPath = scratchPath + "/records.ndjson";
+        const auto outputPath = scratchPath + "/stdout.txt";
+        const auto logPath = scratchPath + "/stderr.txt";
+        (void)remove(recordsPath.c_str());
+        ASSERT_TRUE(WriteWholeFile(configurationPath, configuration.ToEncoding()));
+        std::vector< std::string > argvStrings{
+            TWARLOCK_REGRESSION_PROGRAM,
+            "-c", configurationPath,
+            "--format", "ndjson",
+            "--output", recordsPath,
+        };
+        argvStrings.insert(argvStrings.end(), args.begin(), args.end());
+        std::vector< char* > argv;
+        for (auto& arg: argvStrings) {
+            argv.push_back(&arg[0]);
+        }
+        argv.push_back(nullptr);
+        // The files for the program's output and log are opened before
+        // forking, since the stand-in server's threads are running, and
+        // only async-signal-safe functions may be called in the child.
+        const auto outputFile = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        const auto logFile = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_GE(outputFile, 0);
+        ASSERT_GE(logFile, 0);
+        const auto start = std::chrono::steady_clock::now();
+        const auto pid = fork();
+        if (pid == 0) {
+            if (
+                (dup2(outputFile, STDOUT_FILENO) < 0)
+                || (dup2(logFile, STDERR_FILENO) < 0)
+            ) {
+                _exit(127);
+            }
+            (void)execv(argv[0], argv.data());
+            _exit(127);
+        }
+        (void)close(outputFile);
+        (void)close(logFile);
+        ASSERT_GT(pid, 0);
+        int status = 0;
+        struct rusage usage;
+        ASSERT_EQ(pid, wait4(pid, &status, 0, &usage));
+        run.wallTime = std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        run.statistics = server.GetStatistics();
+        server.Stop();
+        if (WIFEXITED(status)) {
+            run.exitStatus = WEXITSTATUS(status);
+        }
+        run.cpuTime = (
+            (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1000000.0
+            + (double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1000000.0
+        );
+        run.peakRss = usage.ru_maxrss;
+        run.output = ReadWholeFile(outputPath);
+        run.log = ReadWholeFile(logPath);
+        for (const auto& line: StringExtensions::Split(ReadWholeFile(recordsPath), '\n')) {
+            if (!line.empty()) {
+                run.records.push_back(Json::Value::FromEncoding(line));
+            }
+        }
+        printf(
+            "%s: %.3lf s wall, %.3lf s CPU, %ld KiB peak RSS, %zu requests (%zu faults, %zu rate limited), %zu records\n",
+            description.c_str(),
+            run.wallTime,
+            run.cpuTime,
+            run.peakRss,
+            run.statistics.requests,
+            run.statistics.faults,
+            run.statistics.rateLimited,
+            run.records.size()
+        );
+        EXPECT_EQ(0, run.exitStatus) << run.log;
+    }
+
+    /**
+     * This method returns the ID of the user in the fixtures with
+     * the given login name.
+     *
+     * @param[in] login
+     *     This is the login name of the user.
+     *
+     * @return
+     *     The ID of the user, or an empty string if there is no
+     *     such user, is returned.
+     */
+    std::string GetUserId(const std::string& login) {
+        const auto& users = fixtures["users"];
+        for (size_t i = 0; i < users.GetSize(); ++i) {
+            if ((std::string)users[i]["login"] == login) {
+                return users[i]["id"];
+            }
+        }
+        return "";
+    }
+
+    /**
+     * This method returns the follows in the fixtures for which the given
+     * function returns true, flattened and sorted, with the given fields
+     * in the order given.  The "from_name" and "to_name" fields are made
+     * from the display names of the users.
+     *
+     * @param[in] fields
+     *     These are the names of the fields to include.
+     *
+     * @param[in] select
+     *     This is the function which picks out follows by the IDs
+     *     of the follower and the user followed.
+     *
+     * @return
+     *     The selected follows, flattened and sorted, are returned.
+     */
+    std::vector< std::string > SelectFollows(
+        const std::vector< std::string >& fields,
+        std::function< bool(const std::string& fromId, const std::string& toId) > select
+    ) {
+        std::vector< Json::Value > selected;
+        const auto& follows = fixtures["follows"];
+        for (size_t i = 0; i < follows.GetSize(); ++i) {
+            const std::string fromId = follows[i]["from_id"];
+            const std::string toId = follows[i]["to_id"];
+            if (!select(fromId, toId)) {
+                continue;
+            }
+            auto record = Json::Object();
+            record.Set("from_name", displayNames[fromId]);
+            record.Set("to_name", displayNames[toId]);
+            record.Set("followed_at", follows[i]["followed_at"]);
+            selected.push_back(std::move(record));
+        }
+        return FlattenAll(selected, fields);
+    }
+
+    // ::testing::Test
+
+    virtual void SetUp() {
+        fixtures = Json::Value::FromEncoding(
+            ReadWholeFile(TWARLOCK_REGRESSION_FIXTURES_DIR "/twitch.json")
+        );
+        ASSERT_EQ(Json::Value::Type::Object, fixtures.GetType());
+        const auto& users = fixtures["users"];
+        for (size_t i = 0; i < users.GetSize(); ++i) {
+            displayNames[(std::string)users[i]["id"]] = (std::string)users[i]["display_name"];
+        }
+        char scratchPathTemplate[] = "/tmp/TwarlockRegression.XXXXXX";
+        ASSERT_FALSE(mkdtemp(scratchPathTemplate) == NULL);
+        scratchPath = scratchPathTemplate;
+        serverConfiguration.latency = defaultLatency;
+        serverConfiguration.pageSize = pageSize;
+    }
+
+    virtual void TearDown() {
+        if (scratchPath.empty()) {
+            return;
+        }
+        for (const auto& fileName: {"Twarlock.json", "records.ndjson", "stdout.txt", "stderr.txt"}) {
+            (void)remove((scratchPath + "/" + fileName).c_str());
+        }
+        (void)rmdir(scratchPath.c_str());
+    }
+};
+
+TEST_F(RegressionTests, Followers) {
+    RunResult run;
+    RunTwarlock("followers", {"followers", "alpha"}, run);
+    const auto channelId = GetUserId("alpha");
+    const std::vector< std::string > fields{"followed_at", "from_name"};
+    EXPECT_EQ(
+        SelectFollows(
+            fields,
+            [&](const std::string& fromId, const std::string& toId){
+                return (toId == channelId);
+            }
+        ),
+        FlattenAll(run.records, fields)
+    );
+}
+
+TEST_F(RegressionTests, FollowersWithInjectedFaults) {
+    serverConfiguration.latency = 0.02;
+    serverConfiguration.faultInterval = 4;
+    RunResult run;
+    RunTwarlock("followers with faults", {"followers", "alpha"}, run);
+    EXPECT_GT(run.statistics.faults, 0);
+    const auto channelId = GetUserId("alpha");
+    const std::vector< std::string > fields{"followed_at", "from_name"};
+    EXPECT_EQ(
+        SelectFollows(
+            fields,
+            [&](const std::string& fromId, const std::string& toId){
+                return (toId == channelId);
+            }
+        ),
+        FlattenAll(run.records, fields)
+    );
+}
+
+TEST_F(RegressionTests, Bans) {
+    RunResult run;
+    RunTwarlock("bans", {"bans", "alpha"}, run);
+    std::vector< Json::Value > bans;
+    const auto& fixtureBans = fixtures["bans"][GetUserId("alpha")];
+    for (size_t i = 0; i < fixtureBans.GetSize(); ++i) {
+        auto ban = Json::Object();
+        ban.Set("user_name", displayNames[(std::string)fixtureBans[i]["user_id"]]);
+        ban.Set("user_id", fixtureBans[i]["user_id"]);
+        bans.push_back(std::move(ban));
+    }
+    const std::vector< std::string > fields{"user_name", "user_id"};
+    EXPECT_EQ(
+        FlattenAll(bans, fields),
+        FlattenAll(run.records, fields)
+    );
+}
+
+TEST_F(RegressionTests, BanEvents) {
+    RunResult run;
+    RunTwarlock("ban-events", {"ban-events", "alpha"}, run);
+    std::vector< Json::Value > banEvents;
+    const auto& fixtureBanEvents = fixtures["banEvents"][GetUserId("alpha")];
+    for (size_t i = 0; i < fixtureBanEvents.GetSize(); ++i) {
+        auto banEvent = Json::Object();
+        banEvent.Set("event_timestamp", fixtureBanEvents[i]["event_timestamp"]);
+        banEvent.Set("event_type", fixtureBanEvents[i]["event_type"]);
+        banEvent.Set("user_name", displayNames[(std::string)fixtureBanEvents[i]["user_id"]]);
+        banEvent.Set("user_id", fixtureBanEvents[i]["user_id"]);
+        banEvents.push_back(std::move(banEvent));
+    }
+    const std::vector< std::string > fields{"event_timestamp", "event_type", "user_name", "user_id"};
+    EXPECT_EQ(
+        FlattenAll(banEvents, fields),
+        FlattenAll(run.records, fields)
+    );
+}
+
+TEST_F(RegressionTests, Following) {
+    const std::vector< std::string > logins{"alpha", "bravo", "charlie", "delta"};
+    std::set< std::string > userIds;
+    for (const auto& login: logins) {
+        (void)userIds.insert(GetUserId(login));
+    }
+    std::vector< std::string > args{"following"};
+    args.insert(args.end(), logins.begin(), logins.end());
+    RunResult run;
+    RunTwarlock("following", args, run);
+    const std::vector< std::string > fields{"from_name", "to_name", "followed_at"};
+    EXPECT_EQ(
+        SelectFollows(
+            fields,
+            [&](const std::string& fromId, const std::string& toId){
+                return (
+                    (userIds.find(fromId) != userIds.end())
+                    && (userIds.find(toId) != userIds.end())
+                );
+            }
+        ),
+        FlattenAll(run.records, fields)
+    );
+}
+
+TEST_F(RegressionTests, KrakenAndOAuth2) {
+    RunResult info;
+    RunTwarlock("info", {"info", "alpha"}, info);
+    const auto& channel = fixtures["channels"][GetUserId("alpha")];
+    EXPECT_NE(
+        std::string::npos,
+        info.output.find(
+            StringExtensions::sprintf(
+                "Channel 'alpha' has %d followers and %d views.",
+                (int)channel["followers"],
+                (int)channel["views"]
+            )
+        )
+    ) << info.output;
+    RunResult validate;
+    RunTwarlock("oauth-validate", {"oauth-validate"}, validate);
+    EXPECT_NE(std::string::npos, validate.output.find("Login: alpha")) << validate.output;
+    EXPECT_NE(std::string::npos, validate.output.find("moderation:read")) << validate.output;
+}
@@ -0,0 +1,1425 @@
+/**
+ * @file StandInServer.cpp
+ *
+ * This module contains the implementation of the Twarlock::StandInServer
+ * class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "LoadFile.hpp"
+#include "StandInServer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctype.h>
+#include <functional>
+#include <inttypes.h>
+#include <Json/Value.hpp>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <StringExtensions/StringExtensions.hpp>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <SystemAbstractions/NetworkConnection.hpp>
+#include <SystemAbstractions/NetworkEndpoint.hpp>
+#include <thread>
+#include <TlsDecorator/TlsDecorator.hpp>
+#include <utility>
+
+namespace {
+
+    /**
+     * This is the address of the local host.
+     */
+    constexpr uint32_t localhost = 0x7F000001;
+
+    /**
+     * This is the largest request line and headers accepted from a client
+     * before the connection is dropped.
+     */
+    constexpr size_t maxRequestHeaderLength = 65536;
+
+    /**
+     * This is the number of list entries put in one page of a Helix list
+     * if the client doesn't ask for a number.
+     */
+    constexpr size_t defaultFirst = 20;
+
+    /**
+     * This is the largest number of list entries a client may ask for
+     * in one page of a Helix list.
+     */
+    constexpr size_t maxFirst = 100;
+
+    /**
+     * This holds the parts of a request the server looks at.
+     */
+    struct Request {
+        /**
+         * This is the request method, such as "GET".
+         */
+        std::string method;
+
+        /**
+         * This is the path of the resource requested, without the query.
+         */
+        std::string path;
+
+        /**
+         * These are the names and values of the query parameters,
+         * in the order given.
+         */
+        std::vector< std::pair< std::string, std::string > > query;
+
+        /**
+         * These are the request headers, keyed by name in lower case.
+         */
+        std::map< std::string, std::string > headers;
+    };
+
+    /**
+     * This holds a response to be sent to a client.
+     */
+    struct Response {
+        /**
+         * This is the status code of the response.
+         */
+        unsigned int statusCode = 200;
+
+        /**
+         * These are the names and values of any headers to add to the
+         * response, besides Content-Type and Content-Length.
+         */
+        std::vector< std::pair< std::string, std::string > > headers;
+
+        /**
+         * This is the body of the response.
+         */
+        std::string body;
+    };
+
+    /**
+     * This holds the state of one client connection.
+     */
+    struct Connection {
+        /**
+         * This is the secure layer of the connection.
+         */
+        std::shared_ptr< TlsDecorator::TlsDecorator > tls;
+
+        /**
+         * This holds data received but not yet parsed as a request.
+         */
+        std::string buffer;
+
+        /**
+         * This is set once the connection is to be closed, so that
+         * nothing more received on it is handled.
+         */
+        bool closing = false;
+    };
+
+    /**
+     * This holds a response waiting to be sent to a client.
+     */
+    struct PendingResponse {
+        /**
+         * This is the connection on which to send the response.
+         */
+        std::weak_ptr< Connection > connection;
+
+        /**
+         * This is the encoding of the response.
+         */
+        std::string encoding;
+
+        /**
+         * This indicates whether or not to close the connection
+         * after sending the response.
+         */
+        bool close = false;
+    };
+
+    /**
+     * This holds the state of the rate limit of one token.
+     */
+    struct RateLimitWindow {
+        /**
+         * This is the number of requests the token may still make
+         * in the current window.
+         */
+        size_t remaining = 0;
+
+        /**
+         * This is the time, in seconds since the UNIX epoch, at which
+         * the current window ends.
+         */
+        double reset = 0.0;
+    };
+
+    /**
+     * This returns the current time, in seconds since the UNIX epoch,
+     * which is how Twitch gives the time in the Ratelimit-Reset header.
+     *
+     * @return
+     *     The current time, in seconds since the UNIX epoch, is returned.
+     */
+    double GetEpochTime() {
+        return std::chrono::duration< double >(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    /**
+     * This returns the given string with any percent-encoded
+     * characters decoded.
+     *
+     * @param[in] s
+     *     This is the string to decode.
+     *
+     * @return
+     *     The decoded string is returned.
+     */
+    std::string PercentDecode(const std::string& s) {
+        std::string decoded;
+        for (size_t i = 0; i < s.length(); ++i) {
+            unsigned int c;
+            if (
+                (s[i] == '%')
+                && (i + 2 < s.length())
+                && isxdigit((unsigned char)s[i + 1])
+                && isxdigit((unsigned char)s[i + 2])
+                && (sscanf(s.substr(i + 1, 2).c_str(), "%x", &c) == 1)
+            ) {
+                decoded += (char)c;
+                i += 2;
+            } else if (s[i] == '+') {
+                decoded += ' ';
+            } else {
+                decoded += s[i];
+            }
+        }
+        return decoded;
+    }
+
+    /**
+     * This returns the given string in lower case.
+     *
+     * @param[in] s
+     *     This is the string to convert.
+     *
+     * @return
+     *     The given string in lower case is returned.
+     */
+    std::string ToLower(const std::string& s) {
+        std::string lower;
+        lower.reserve(s.length());
+        for (const auto c: s) {
+            lower += (char)tolower((unsigned char)c);
+        }
+        return lower;
+    }
+
+    /**
+     * This parses the request line and headers of a request.
+     *
+     * @param[in] head
+     *     This is the request line and headers, without the empty line
+     *     which ends them.
+     *
+     * @param[out] request
+     *     This is where to store the parts of the request.
+     *
+     * @return
+     *     An indication of whether or not the request line and headers
+     *     were parsed is returned.
+     */
+    bool ParseRequest(
+        const std::string& head,
+        Request& request
+    ) {
+        auto lineEnd = head.find("\r\n");
+        const auto requestLine = head.substr(0, lineEnd);
+        const auto methodEnd = requestLine.find(' ');
+        const auto targetEnd = requestLine.rfind(' ');
+        if (
+            (methodEnd == std::string::npos)
+            || (targetEnd <= methodEnd)
+            || (requestLine.compare(targetEnd + 1, 5, "HTTP/") != 0)
+        ) {
+            return false;
+        }
+        request.method = requestLine.substr(0, methodEnd);
+        const auto target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        const auto queryDelimiter = target.find('?');
+        request.path = PercentDecode(target.substr(0, queryDelimiter));
+        if (queryDelimiter != std::string::npos) {
+            for (const auto& parameter: StringExtensions::Split(target.substr(queryDelimiter + 1), '&')) {
+                if (parameter.empty()) {
+                    continue;
+                }
+                const auto nameEnd = parameter.find('=');
+                if (nameEnd == std::string::npos) {
+                    request.query.emplace_back(PercentDecode(parameter), "");
+                } else {
+                    request.query.emplace_back(
+                        PercentDecode(parameter.substr(0, nameEnd)),
+                        PercentDecode(parameter.substr(nameEnd + 1))
+                    );
+                }
+            }
+        }
+        while (lineEnd != std::string::npos) {
+            const auto lineStart = lineEnd + 2;
+            lineEnd = head.find("\r\n", lineStart);
+            const auto line = head.substr(lineStart, lineEnd - lineStart);
+            const auto nameEnd = line.find(':');
+            if (nameEnd == std::string::npos) {
+                return false;
+            }
+            request.headers[ToLower(line.substr(0, nameEnd))] = StringExtensions::Trim(line.substr(nameEnd + 1));
+        }
+        return true;
+    }
+
+    /**
+     * This returns the values of the query parameter of the given request
+     * with the given name, in the order given.
+     *
+     * @param[in] request
+     *     This is the request whose query parameters to search.
+     *
+     * @param[in] name
+     *     This is the name of the query parameter to find.
+     *
+     * @return
+     *     The values of the query parameter with the given name
+     *     are returned.
+     */
+    std::vector< std::string > GetQueryValues(
+        const Request& request,
+        const std::string& name
+    ) {
+        std::vector< std::string > values;
+        for (const auto& parameter: request.query) {
+            if (parameter.first == name) {
+                values.push_back(parameter.second);
+            }
+        }
+        return values;
+    }
+
+    /**
+     * This returns the first value of the query parameter of the given
+     * request with the given name.
+     *
+     * @param[in] request
+     *     This is the request whose query parameters to search.
+     *
+     * @param[in] name
+     *     This is the name of the query parameter to find.
+     *
+     * @return
+     *     The first value of the query parameter with the given name,
+     *     or an empty string if there isn't one, is returned.
+     */
+    std::string GetQueryValue(
+        const Request& request,
+        const std::string& name
+    ) {
+        const auto values = GetQueryValues(request, name);
+        return (values.empty() ? "" : values[0]);
+    }
+
+    /**
+     * This returns the token given in the Authorization header of the
+     * given request, with any "Bearer" or "OAuth" prefix taken off.
+     *
+     * @param[in] request
+     *     This is the request whose token to return.
+     *
+     * @return
+     *     The token given by the request, or an empty string if none
+     *     was given, is returned.
+     */
+    std::string GetToken(const Request& request) {
+        const auto authorization = request.headers.find("authorization");
+        if (authorization == request.headers.end()) {
+            return "";
+        }
+        const auto schemeEnd = authorization->second.find(' ');
+        if (schemeEnd == std::string::npos) {
+            return "";
+        }
+        return StringExtensions::Trim(authorization->second.substr(schemeEnd + 1));
+    }
+
+    /**
+     * This returns the reason phrase to put in the status line
+     * of a response with the given status code.
+     *
+     * @param[in] statusCode
+     *     This is the status code of the response.
+     *
+     * @return
+     *     The reason phrase for the given status code is returned.
+     */
+    const char* GetReasonPhrase(unsigned int statusCode) {
+        switch (statusCode) {
+            case 200: return "OK";
+            case 400: return "Bad Request";
+            case 401: return "Unauthorized";
+            case 403: return "Forbidden";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 429: return "Too Many Requests";
+            case 500: return "Internal Server Error";
+            case 502: return "Bad Gateway";
+            case 503: return "Service Unavailable";
+            case 504: return "Gateway Timeout";
+            default: return "Error";
+        }
+    }
+
+    /**
+     * This returns the encoding of the given response.
+     *
+     * @param[in] response
+     *     This is the response to encode.
+     *
+     * @param[in] close
+     *     This indicates whether or not the connection is closed
+     *     after the response is sent.
+     *
+     * @return
+     *     The encoding of the given response is returned.
+     */
+    std::string EncodeResponse(
+        const Response& response,
+        bool close
+    ) {
+        auto encoding = StringExtensions::sprintf(
+            "HTTP/1.1 %u %s\r\n"
+            "Content-Type: application/json; charset=utf-8\r\n"
+            "Content-Length: %zu\r\n",
+            response.statusCode,
+            GetReasonPhrase(response.statusCode),
+            response.body.length()
+        );
+        for (const auto& header: response.headers) {
+            encoding += header.first + ": " + header.second + "\r\n";
+        }
+        if (close) {
+            encoding += "Connection: close\r\n";
+        }
+        encoding += "\r\n";
+        encoding += response.body;
+        return encoding;
+    }
+
+    /**
+     * This returns an error response, with a body shaped like the
+     * ones Twitch sends.
+     *
+     * @param[in] statusCode
+     *     This is the status code of the response.
+     *
+     * @param[in] message
+     *     This is the message to put in the body of the response.
+     *
+     * @return
+     *     The error response is returned.
+     */
+    Response MakeErrorResponse(
+        unsigned int statusCode,
+        const std::string& message
+    ) {
+        auto body = Json::Object();
+        body.Set("error", GetReasonPhrase(statusCode));
+        body.Set("status", (int)statusCode);
+        body.Set("message", message);
+        Response response;
+        response.statusCode = statusCode;
+        response.body = body.ToEncoding();
+        return response;
+    }
+
+    /**
+     * This returns a successful response with the given body.
+     *
+     * @param[in] body
+     *     This is the body of the response.
+     *
+     * @return
+     *     The successful response is returned.
+     */
+    Response MakeResponse(const Json::Value& body) {
+        Response response;
+        response.body = body.ToEncoding();
+        return response;
+    }
+
+    /**
+     * This returns the prefix of the cursors of the given list,
+     * which ties each cursor to the list it came from.
+     *
+     * @param[in] list
+     *     This identifies the list.
+     *
+     * @return
+     *     The prefix of the cursors of the given list is returned.
+     */
+    std::string GetCursorPrefix(const std::string& list) {
+        return StringExtensions::sprintf(
+            "%08x",
+            (unsigned int)(std::hash< std::string >()(list) & 0xFFFFFFFF)
+        );
+    }
+
+    /**
+     * This fills in the given page of the given list, with the entries
+     * at the position given by the cursor of the given request, if any.
+     * A cursor for the next page is added if there are more entries.
+     *
+     * @param[in] entries
+     *     These are the entries of the list.
+     *
+     * @param[in] list
+     *     This identifies the list, so that cursors of other lists
+     *     aren't accepted.
+     *
+     * @param[in] request
+     *     This is the request for the page.
+     *
+     * @param[in] pageSize
+     *     This is the largest number of entries to put in the page,
+     *     whatever number the request asks for.
+     *
+     * @param[in,out] page
+     *     This is where to add the entries and pagination of the page.
+     *
+     * @return
+     *     An indication of whether or not the request for the page
+     *     was valid is returned.
+     */
+    bool Paginate(
+        const std::vector< Json::Value >& entries,
+        const std::string& list,
+        const Request& request,
+        size_t pageSize,
+        Json::Value& page
+    ) {
+        const auto cursorPrefix = GetCursorPrefix(list);
+        size_t offset = 0;
+        const auto after = GetQueryValue(request, "after");
+        if (!after.empty()) {
+            int offsetEnd = 0;
+            if (
+                (after.compare(0, cursorPrefix.length(), cursorPrefix) != 0)
+                || (sscanf(after.c_str() + cursorPrefix.length(), "%zx%n", &offset, &offsetEnd) != 1)
+                || ((size_t)offsetEnd != after.length() - cursorPrefix.length())
+                || (offset > entries.size())
+            ) {
+                return false;
+            }
+        }
+        size_t first = defaultFirst;
+        const auto firstValue = GetQueryValue(request, "first");
+        if (
+            !firstValue.empty()
+            && (
+                (sscanf(firstValue.c_str(), "%zu", &first) != 1)
+                || (first < 1)
+                || (first > maxFirst)
+            )
+        ) {
+            return false;
+        }
+        const auto count = std::min(
+            std::min(first, std::max(pageSize, (size_t)1)),
+            entries.size() - offset
+        );
+        auto data = Json::Array();
+        for (size_t i = offset; i < offset + count; ++i) {
+            data.Add(entries[i]);
+        }
+        page.Set("data", data);
+        auto pagination = Json::Object();
+        if (offset + count < entries.size()) {
+            pagination.Set(
+                "cursor",
+                cursorPrefix + StringExtensions::sprintf("%zx", offset + count)
+            );
+        }
+        page.Set("pagination", pagination);
+        return true;
+    }
+
+}
+
+namespace Twarlock {
+
+    /**
+     * This contains the private properties of a StandInServer class
+     * instance.
+     */
+    struct StandInServer::Impl {
+        // Properties
+
+        /**
+         * These are the settings which shape how the server behaves.
+         */
+        Configuration configuration;
+
+        /**
+         * These are the users, follows, bans, ban events, channels
+         * and tokens served.
+         */
+        Json::Value fixtures;
+
+        /**
+         * These are the users served, keyed by ID.
+         */
+        std::map< std::string, Json::Value > usersById;
+
+        /**
+         * These are the IDs of the users served, keyed by login name.
+         */
+        std::map< std::string, std::string > userIdsByLogin;
+
+        /**
+         * This is used to accept connections from clients.
+         */
+        SystemAbstractions::NetworkEndpoint endpoint;
+
+        /**
+         * This is the port on which the server is listening.
+         */
+        uint16_t port = 0;
+
+        /**
+         * This is used to synchronize access to the state of the server.
+         */
+        mutable std::mutex mutex;
+
+        /**
+         * This is used to wake up the responder thread when a response
+         * is queued or the server is stopped.
+         */
+        std::condition_variable wakeResponder;
+
+        /**
+         * These are the open client connections, keyed by
+         * an identifier assigned to each.
+         */
+        std::map< size_t, std::shared_ptr< Connection > > connections;
+
+        /**
+         * These are connections which broke.  They're released by the
+         * responder thread, rather than by the connection's own
+         * callback, since a connection can't be destroyed from
+         * its own thread.
+         */
+        std::vector< std::shared_ptr< Connection > > brokenConnections;
+
+        /**
+         * This is the identifier to assign to the next client connection.
+         */
+        size_t nextConnectionId = 1;
+
+        /**
+         * These are the responses waiting to be sent, keyed by the time
+         * at which to send them, followed by the order in which they
+         * were queued, so that responses due at the same time are sent
+         * in order.
+         */
+        std::map<
+            std::pair< std::chrono::steady_clock::time_point, size_t >,
+            PendingResponse
+        > pendingResponses;
+
+        /**
+         * This is the number to give the next response queued,
+         * to keep responses due at the same time in order.
+         */
+        size_t nextResponseSequence = 0;
+
+        /**
+         * These are the states of the rate limits of the tokens,
+         * keyed by token.
+         */
+        std::map< std::string, RateLimitWindow > rateLimitWindows;
+
+        /**
+         * These are counts of what the server did so far.
+         */
+        Statistics statistics;
+
+        /**
+         * This is set to tell the responder thread to stop.
+         */
+        bool stopResponder = false;
+
+        /**
+         * This is the thread which sends responses once they're due.
+         */
+        std::thread responder;
+
+        // Methods
+
+        /**
+         * This method loads the fixtures served from the given file.
+         *
+         * @param[in] fixturesPath
+         *     This is the path of the file holding the fixtures.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the fixtures were loaded
+         *     is returned.
+         */
+        bool LoadFixtures(
+            const std::string& fixturesPath,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        ) {
+            std::string encoding;
+            if (!LoadFile(fixturesPath, "fixtures", diagnosticsSender, encoding)) {
+                return false;
+            }
+            fixtures = Json::Value::FromEncoding(encoding);
+            if (fixtures.GetType() != Json::Value::Type::Object) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "Unable to parse fixtures file '%s'",
+                    fixturesPath.c_str()
+                );
+                return false;
+            }
+            usersById.clear();
+            userIdsByLogin.clear();
+            const auto& users = fixtures["users"];
+            for (size_t i = 0; i < users.GetSize(); ++i) {
+                const std::string id = users[i]["id"];
+                const std::string login = users[i]["login"];
+                usersById[id] = users[i];
+                userIdsByLogin[login] = id;
+            }
+            return true;
+        }
+
+        /**
+         * This method adds to the given list entry the ID, login name
+         * and display name of the given user, under field names which
+         * start with the given prefix.
+         *
+         * @param[in,out] entry
+         *     This is the list entry to which to add the user.
+         *
+         * @param[in] prefix
+         *     This is the beginning of the names of the fields to add,
+         *     such as "from_" or "user_".
+         *
+         * @param[in] id
+         *     This is the ID of the user to add.
+         */
+        void AddUser(
+            Json::Value& entry,
+            const std::string& prefix,
+            const std::string& id
+        ) const {
+            const auto usersByIdEntry = usersById.find(id);
+            entry.Set(prefix + "id", id);
+            if (usersByIdEntry == usersById.end()) {
+                entry.Set(prefix + "login", "");
+                entry.Set(prefix + "name", "");
+            } else {
+                entry.Set(prefix + "login", usersByIdEntry->second["login"]);
+                entry.Set(prefix + "name", usersByIdEntry->second["display_name"]);
+            }
+        }
+
+        /**
+         * This method returns what is known about the given token.
+         *
+         * @param[in] token
+         *     This is the token to look up.
+         *
+         * @return
+         *     What is known about the given token is returned.  It's not
+         *     an object if the token isn't one of the fixtures.
+         */
+        const Json::Value& GetTokenInfo(const std::string& token) const {
+            return fixtures["tokens"][token];
+        }
+
+        /**
+         * This method takes one request from the rate limit of the given
+         * token, and adds the Ratelimit-* headers to the given response.
+         *
+         * @param[in] token
+         *     This is the token used to make the request.
+         *
+         * @param[in,out] response
+         *     This is the response to which to add the headers.
+         *
+         * @return
+         *     An indication of whether or not the token had a request
+         *     left in its rate limit window is returned.
+         */
+        bool TakeRateLimit(
+            const std::string& token,
+            Response& response
+        ) {
+            const auto now = GetEpochTime();
+            auto& window = rateLimitWindows[token];
+            if (now >= window.reset) {
+                window.remaining = configuration.rateLimit;
+                window.reset = now + configuration.rateLimitWindow;
+            }
+            const auto allowed = (window.remaining > 0);
+            if (allowed) {
+                --window.remaining;
+            }
+            response.headers.emplace_back("Ratelimit-Limit", StringExtensions::sprintf("%zu", configuration.rateLimit));
+            response.headers.emplace_back("Ratelimit-Remaining", StringExtensions::sprintf("%zu", window.remaining));
+            response.headers.emplace_back("Ratelimit-Reset", StringExtensions::sprintf("%.0lf", ceil(window.reset)));
+            return allowed;
+        }
+
+        /**
+         * This method handles a request to the Helix API.
+         *
+         * @param[in] request
+         *     This is the request to handle.
+         *
+         * @param[in] resource
+         *     This is the path of the resource requested, relative to
+         *     the Helix API.
+         *
+         * @return
+         *     The response to the request is returned.
+         */
+        Response HandleHelix(
+            const Request& request,
+            const std::string& resource
+        ) {
+            const auto token = GetToken(request);
+            const auto& tokenInfo = GetTokenInfo(token);
+            if (tokenInfo.GetType() != Json::Value::Type::Object) {
+                return MakeErrorResponse(401, "Invalid OAuth token");
+            }
+            Response rateLimitHeaders;
+            if (!TakeRateLimit(token, rateLimitHeaders)) {
+                ++statistics.rateLimited;
+                auto response = MakeErrorResponse(429, "Too Many Requests");
+                response.headers = std::move(rateLimitHeaders.headers);
+                return response;
+            }
+            auto response = HandleHelixResource(request, resource, tokenInfo);
+            response.headers.insert(
+                response.headers.end(),
+                rateLimitHeaders.headers.begin(),
+                rateLimitHeaders.headers.end()
+            );
+            return response;
+        }
+
+        /**
+         * This method produces the response to a request for a Helix
+         * resource, once the request has been let through.
+         *
+         * @param[in] request
+         *     This is the request to handle.
+         *
+         * @param[in] resource
+         *     This is the path of the resource requested, relative to
+         *     the Helix API.
+         *
+         * @param[in] tokenInfo
+         *     This holds what is known about the token used to make
+         *     the request.
+         *
+         * @return
+         *     The response to the request is returned.
+         */
+        Response HandleHelixResource(
+            const Request& request,
+            const std::string& resource,
+            const Json::Value& tokenInfo
+        ) const {
+            auto page = Json::Object();
+            if (resource == "users") {
+                auto logins = GetQueryValues(request, "login");
+                auto ids = GetQueryValues(request, "id");
+                if (
+                    logins.empty()
+                    && ids.empty()
+                ) {
+                    ids.push_back(tokenInfo["user_id"]);
+                }
+                if (logins.size() + ids.size() > maxFirst) {
+                    return MakeErrorResponse(400, "Too many logins or ids");
+                }
+                for (const auto& login: logins) {
+                    const auto userIdsByLoginEntry = userIdsByLogin.find(ToLower(login));
+                    if (userIdsByLoginEntry != userIdsByLogin.end()) {
+                        ids.push_back(userIdsByLoginEntry->second);
+                    }
+                }
+                auto data = Json::Array();
+                for (const auto& id: ids) {
+                    const auto usersByIdEntry = usersById.find(id);
+                    if (usersByIdEntry != usersById.end()) {
+                        data.Add(usersByIdEntry->second);
+                    }
+                }
+                page.Set("data", data);
+                return MakeResponse(page);
+            } else if (resource == "users/follows") {
+                const auto fromId = GetQueryValue(request, "from_id");
+                const auto toId = GetQueryValue(request, "to_id");
+                if (
+                    fromId.empty()
+                    && toId.empty()
+                ) {
+                    return MakeErrorResponse(400, "Missing required parameter from_id or to_id");
+                }
+                std::vector< Json::Value > entries;
+                const auto& follows = fixtures["follows"];
+                for (size_t i = 0; i < follows.GetSize(); ++i) {
+                    const std::string followFromId = follows[i]["from_id"];
+                    const std::string followToId = follows[i]["to_id"];
+                    if (
+                        (
+                            !fromId.empty()
+                            && (followFromId != fromId)
+                        )
+                        || (
+                            !toId.empty()
+                            && (followToId != toId)
+                        )
+                    ) {
+                        continue;
+                    }
+                    auto entry = Json::Object();
+                    AddUser(entry, "from_", followFromId);
+                    AddUser(entry, "to_", followToId);
+                    entry.Set("followed_at", follows[i]["followed_at"]);
+                    entries.push_back(std::move(entry));
+                }
+                page.Set("total", (int)entries.size());
+                if (
+                    !Paginate(
+                        entries,
+                        resource + "?from_id=" + fromId + "&to_id=" + toId,
+                        request,
+                        configuration.pageSize,
+                        page
+                    )
+                ) {
+                    return MakeErrorResponse(400, "Invalid pagination");
+                }
+                return MakeResponse(page);
+            } else if (
+                (resource == "moderation/banned")
+                || (resource == "moderation/banned/events")
+            ) {
+                const auto broadcasterId = GetQueryValue(request, "broadcaster_id");
+                if (broadcasterId.empty()) {
+                    return MakeErrorResponse(400, "Missing required parameter broadcaster_id");
+                }
+                bool hasScope = false;
+                const auto& scopes = tokenInfo["scopes"];
+                for (size_t i = 0; i < scopes.GetSize(); ++i) {
+                    if ((std::string)scopes[i] == "moderation:read") {
+                        hasScope = true;
+                    }
+                }
+                if (!hasScope) {
+                    return MakeErrorResponse(401, "Missing scope: moderation:read");
+                }
+                if ((std::string)tokenInfo["user_id"] != broadcasterId) {
+                    return MakeErrorResponse(403, "Broadcaster ID must match the user ID in the token");
+                }
+                std::vector< Json::Value > entries;
+                if (resource == "moderation/banned") {
+                    const auto userIds = GetQueryValues(request, "user_id");
+                    const auto& bans = fixtures["bans"][broadcasterId];
+                    for (size_t i = 0; i < bans.GetSize(); ++i) {
+                        const std::string userId = bans[i]["user_id"];
+                        if (
+                            !userIds.empty()
+                            && (std::find(userIds.begin(), userIds.end(), userId) == userIds.end())
+                        ) {
+                            continue;
+                        }
+                        auto entry = Json::Object();
+                        AddUser(entry, "user_", userId);
+                        entry.Set("expires_at", bans[i]["expires_at"]);
+                        entries.push_back(std::move(entry));
+                    }
+                } else {
+                    const auto& banEvents = fixtures["banEvents"][broadcasterId];
+                    for (size_t i = 0; i < banEvents.GetSize(); ++i) {
+                        auto eventData = Json::Object();
+                        AddUser(eventData, "broadcaster_", broadcasterId);
+                        AddUser(eventData, "user_", banEvents[i]["user_id"]);
+                        eventData.Set("expires_at", "");
+                        auto entry = Json::Object();
+                        entry.Set("id", banEvents[i]["id"]);
+                        entry.Set("event_type", banEvents[i]["event_type"]);
+                        entry.Set("event_timestamp", banEvents[i]["event_timestamp"]);
+                        entry.Set("version", "1.0");
+                        entry.Set("event_data", eventData);
+                        entries.push_back(std::move(entry));
+                    }
+                }
+                std::string list = resource + "?broadcaster_id=" + broadcasterId;
+                for (const auto& userId: GetQueryValues(request, "user_id")) {
+                    list += "&user_id=" + userId;
+                }
+                if (
+                    !Paginate(
+                        entries,
+                        list,
+                        request,
+                        configuration.pageSize,
+                        page
+                    )
+                ) {
+                    return MakeErrorResponse(400, "Invalid pagination");
+                }
+                return MakeResponse(page);
+            } else {
+                return MakeErrorResponse(404, "Not Found");
+            }
+        }
+
+        /**
+         * This method handles a request to the Kraken API.
+         *
+         * @param[in] request
+         *     This is the request to handle.
+         *
+         * @param[in] resource
+         *     This is the path of the resource requested, relative to
+         *     the Kraken API.
+         *
+         * @return
+         *     The response to the request is returned.
+         */
+        Response HandleKraken(
+            const Request& request,
+            const std::string& resource
+        ) const {
+            static const std::string channelsPrefix = "channels/";
+            if (resource.compare(0, channelsPrefix.length(), channelsPrefix) == 0) {
+                const auto id = resource.substr(channelsPrefix.length());
+                const auto usersByIdEntry = usersById.find(id);
+                if (usersByIdEntry == usersById.end()) {
+                    return MakeErrorResponse(404, "Channel does not exist");
+                }
+                intmax_t numericId = 0;
+                (void)sscanf(id.c_str(), "%" SCNdMAX, &numericId);
+                const auto& channel = fixtures["channels"][id];
+                auto body = Json::Object();
+                body.Set("_id", numericId);
+                body.Set("name", usersByIdEntry->second["login"]);
+                body.Set("display_name", usersByIdEntry->second["display_name"]);
+                body.Set("views", (intmax_t)channel["views"]);
+                body.Set("followers", (intmax_t)channel["followers"]);
+                return MakeResponse(body);
+            } else if (resource == "users") {
+                auto users = Json::Array();
+                for (const auto& logins: GetQueryValues(request, "login")) {
+                    for (const auto& login: StringExtensions::Split(logins, ',')) {
+                        const auto userIdsByLoginEntry = userIdsByLogin.find(ToLower(login));
+                        if (userIdsByLoginEntry == userIdsByLogin.end()) {
+                            continue;
+                        }
+                        const auto& user = usersById.at(userIdsByLoginEntry->second);
+                        auto entry = Json::Object();
+                        entry.Set("_id", user["id"]);
+                        entry.Set("name", user["login"]);
+                        entry.Set("display_name", user["display_name"]);
+                        users.Add(entry);
+                    }
+                }
+                auto body = Json::Object();
+                body.Set("_total", (int)users.GetSize());
+                body.Set("users", users);
+                return MakeResponse(body);
+            } else {
+                return MakeErrorResponse(404, "Not Found");
+            }
+        }
+
+        /**
+         * This method handles a request to the OAuth2 API.
+         *
+         * @param[in] request
+         *     This is the request to handle.
+         *
+         * @param[in] resource
+         *     This is the path of the resource requested, relative to
+         *     the OAuth2 API.
+         *
+         * @return
+         *     The response to the request is returned.
+         */
+        Response HandleOAuth2(
+            const Request& request,
+            const std::string& resource
+        ) const {
+            if (resource != "validate") {
+                return MakeErrorResponse(404, "Not Found");
+            }
+            const auto& tokenInfo = GetTokenInfo(GetToken(request));
+            if (tokenInfo.GetType() != Json::Value::Type::Object) {
+                return MakeErrorResponse(401, "invalid access token");
+            }
+            return MakeResponse(tokenInfo);
+        }
+
+        /**
+         * This method handles a request, counting it, and failing it
+         * on purpose if it's due to fail.
+         *
+         * @param[in] request
+         *     This is the request to handle.
+         *
+         * @return
+         *     The response to the request is returned.
+         */
+        Response Handle(const Request& request) {
+            ++statistics.requests;
+            if (
+                (configuration.faultInterval > 0)
+                && !configuration.faultStatusCodes.empty()
+                && (statistics.requests % configuration.faultInterval == 0)
+            ) {
+                const auto statusCode = configuration.faultStatusCodes[
+                    statistics.faults % configuration.faultStatusCodes.size()
+                ];
+                ++statistics.faults;
+                auto response = MakeErrorResponse(statusCode, "Fault injected by stand-in server");
+                if (statusCode == 429) {
+                    response.headers.emplace_back("Ratelimit-Limit", StringExtensions::sprintf("%zu", configuration.rateLimit));
+                    response.headers.emplace_back("Ratelimit-Remaining", "0");
+                    response.headers.emplace_back("Ratelimit-Reset", StringExtensions::sprintf("%.0lf", ceil(GetEpochTime() + 1.0)));
+                }
+                return response;
+            }
+            if (request.method != "GET") {
+                return MakeErrorResponse(405, "Method Not Allowed");
+            }
+            static const std::string helixPrefix = "/helix/";
+            static const std::string krakenPrefix = "/kraken/";
+            static const std::string oauth2Prefix = "/oauth2/";
+            if (request.path.compare(0, helixPrefix.length(), helixPrefix) == 0) {
+                return HandleHelix(request, request.path.substr(helixPrefix.length()));
+            } else if (request.path.compare(0, krakenPrefix.length(), krakenPrefix) == 0) {
+                return HandleKraken(request, request.path.substr(krakenPrefix.length()));
+            } else if (request.path.compare(0, oauth2Prefix.length(), oauth2Prefix) == 0) {
+                return HandleOAuth2(request, request.path.substr(oauth2Prefix.length()));
+            } else {
+                return MakeErrorResponse(404, "Not Found");
+            }
+        }
+
+        /**
+         * This method queues the given response to be sent on the given
+         * connection once the configured latency has passed.
+         *
+         * @param[in] connection
+         *     This is the connection on which to send the response.
+         *
+         * @param[in] response
+         *     This is the response to send.
+         *
+         * @param[in] close
+         *     This indicates whether or not to close the connection
+         *     after sending the response.
+         */
+        void QueueResponse(
+            const std::shared_ptr< Connection >& connection,
+            const Response& response,
+            bool close
+        ) {
+            const auto due = (
+                std::chrono::steady_clock::now()
+                + std::chrono::duration_cast< std::chrono::steady_clock::duration >(
+                    std::chrono::duration< double >(configuration.latency)
+                )
+            );
+            PendingResponse pendingResponse;
+            pendingResponse.connection = connection;
+            pendingResponse.encoding = EncodeResponse(response, close);
+            pendingResponse.close = close;
+            pendingResponses[std::make_pair(due, nextResponseSequence++)] = std::move(pendingResponse);
+            wakeResponder.notify_all();
+        }
+
+        /**
+         * This method handles data received on the given connection,
+         * handling any requests which are now complete.
+         *
+         * @param[in] connection
+         *     This is the connection on which the data was received.
+         *
+         * @param[in] message
+         *     This is the data received.
+         */
+        void ReceiveData(
+            const std::shared_ptr< Connection >& connection,
+            const std::vector< uint8_t >& message
+        ) {
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            if (connection->closing) {
+                return;
+            }
+            connection->buffer.append(message.begin(), message.end());
+            for (;;) {
+                const auto headEnd = connection->buffer.find("\r\n\r\n");
+                if (headEnd == std::string::npos) {
+                    if (connection->buffer.length() > maxRequestHeaderLength) {
+                        connection->closing = true;
+                        QueueResponse(connection, MakeErrorResponse(400, "Request too large"), true);
+                    }
+                    return;
+                }
+                Request request;
+                if (!ParseRequest(connection->buffer.substr(0, headEnd), request)) {
+                    connection->closing = true;
+                    QueueResponse(connection, MakeErrorResponse(400, "Malformed request"), true);
+                    return;
+                }
+                size_t contentLength = 0;
+                const auto contentLengthHeader = request.headers.find("content-length");
+                if (
+                    (contentLengthHeader != request.headers.end())
+                    && (sscanf(contentLengthHeader->second.c_str(), "%zu", &contentLength) != 1)
+                ) {
+                    connection->closing = true;
+                    QueueResponse(connection, MakeErrorResponse(400, "Invalid Content-Length"), true);
+                    return;
+                }
+                const auto requestLength = headEnd + 4 + contentLength;
+                if (connection->buffer.length() < requestLength) {
+                    return;
+                }
+                connection->buffer.erase(0, requestLength);
+                const auto connectionHeader = request.headers.find("connection");
+                const auto close = (
+                    (connectionHeader != request.headers.end())
+                    && (ToLower(connectionHeader->second) == "close")
+                );
+                QueueResponse(connection, Handle(request), close);
+                if (close) {
+                    connection->closing = true;
+                    return;
+                }
+            }
+        }
+
+        /**
+         * This method sets up a new client connection.
+         *
+         * @param[in] lowerLayer
+         *     This is the network connection from the client.
+         *
+         * @param[in] cert
+         *     This is the server's certificate.
+         *
+         * @param[in] key
+         *     This is the server's private key.
+         */
+        void AcceptConnection(
+            std::shared_ptr< SystemAbstractions::NetworkConnection > lowerLayer,
+            const std::string& cert,
+            const std::string& key
+        ) {
+            const auto connection = std::make_shared< Connection >();
+            connection->tls = std::make_shared< TlsDecorator::TlsDecorator >();
+            connection->tls->ConfigureAsServer(lowerLayer, cert, key, "");
+            size_t connectionId;
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                connectionId = nextConnectionId++;
+                connections[connectionId] = connection;
+            }
+            std::weak_ptr< Connection > connectionWeak(connection);
+            const auto broken = [this, connectionId](bool graceful){
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                const auto connectionsEntry = connections.find(connectionId);
+                if (connectionsEntry == connections.end()) {
+                    return;
+                }
+                brokenConnections.push_back(std::move(connectionsEntry->second));
+                (void)connections.erase(connectionsEntry);
+                wakeResponder.notify_all();
+            };
+            if (
+                !connection->tls->Process(
+                    [this, connectionWeak](const std::vector< uint8_t >& message){
+                        const auto connection = connectionWeak.lock();
+                        if (connection != nullptr) {
+                            ReceiveData(connection, message);
+                        }
+                    },
+                    broken
+                )
+            ) {
+                broken(false);
+            }
+        }
+
+        /**
+         * This method is the body of the responder thread, which sends
+         * responses once they're due.
+         */
+        void Responder() {
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            while (!stopResponder) {
+                if (!brokenConnections.empty()) {
+                    auto connectionsToRelease = std::move(brokenConnections);
+                    brokenConnections.clear();
+                    lock.unlock();
+                    connectionsToRelease.clear();
+                    lock.lock();
+                    continue;
+                }
+                if (pendingResponses.empty()) {
+                    wakeResponder.wait(lock);
+                    continue;
+                }
+                const auto next = pendingResponses.begin();
+                const auto due = next->first.first;
+                if (due > std::chrono::steady_clock::now()) {
+                    (void)wakeResponder.wait_until(lock, due);
+                    continue;
+                }
+                const auto pendingResponse = std::move(next->second);
+                (void)pendingResponses.erase(next);
+                const auto connection = pendingResponse.connection.lock();
+                if (connection == nullptr) {
+                    continue;
+                }
+                const auto tls = connection->tls;
+                lock.unlock();
+                tls->SendMessage(
+                    std::vector< uint8_t >(
+                        pendingResponse.encoding.begin(),
+                        pendingResponse.encoding.end()
+                    )
+                );
+                if (pendingResponse.close) {
+                    tls->Close(true);
+                }
+                lock.lock();
+            }
+        }
+    };
+
+    StandInServer::~StandInServer() noexcept {
+        if (impl_ != nullptr) {
+            Stop();
+        }
+    }
+    StandInServer::StandInServer(StandInServer&&) noexcept = default;
+    StandInServer& StandInServer::operator=(StandInServer&&) noexcept = default;
+
+    StandInServer::StandInServer()
+        : impl_(new Impl())
+    {
+    }
+
+    bool StandInServer::Start(
+        const std::string& fixturesPath,
+        const std::string& certsPath,
+        const Configuration& configuration
+    ) {
+        Stop();
+        SystemAbstractions::DiagnosticsSender diagnosticsSender("StandInServer");
+        (void)diagnosticsSender.SubscribeToDiagnostics(
+            [](
+                std::string senderName,
+                size_t level,
+                std::string message
+            ){
+                fprintf(stderr, "%s\n", message.c_str());
+            },
+            SystemAbstractions::DiagnosticsSender::Levels::WARNING
+        );
+        std::string cert;
+        std::string key;
+        if (
+            !impl_->LoadFixtures(fixturesPath, diagnosticsSender)
+            || !LoadFile(certsPath + "/server.pem", "server certificate", diagnosticsSender, cert)
+            || !LoadFile(certsPath + "/server-key.pem", "server key", diagnosticsSender, key)
+        ) {
+            return false;
+        }
+        impl_->configuration = configuration;
+        impl_->statistics = Statistics();
+        impl_->rateLimitWindows.clear();
+        impl_->stopResponder = false;
+        impl_->responder = std::thread(&Impl::Responder, impl_.get());
+        const auto impl = impl_.get();
+        if (
+            !impl_->endpoint.Open(
+                [impl, cert, key](std::shared_ptr< SystemAbstractions::NetworkConnection > connection){
+                    impl->AcceptConnection(connection, cert, key);
+                },
+                [](uint32_t address, uint16_t port, const std::vector< uint8_t >& body){},
+                SystemAbstractions::NetworkEndpoint::Mode::Connection,
+                localhost,
+                0,
+                0
+            )
+        ) {
+            Stop();
+            return false;
+        }
+        impl_->port = impl_->endpoint.GetBoundPort();
+        return true;
+    }
+
+    void StandInServer::Stop() {
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            impl_->stopResponder = true;
+            impl_->wakeResponder.notify_all();
+        }
+        if (impl_->responder.joinable()) {
+            impl_->responder.join();
+        }
+        impl_->endpoint.Close();
+        decltype(impl_->connections) connections;
+        decltype(impl_->brokenConnections) brokenConnections;
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            connections.swap(impl_->connections);
+            brokenConnections.swap(impl_->brokenConnections);
+            impl_->pendingResponses.clear();
+        }
+        for (const auto& connectionsEntry: connections) {
+            connectionsEntry.second->tls->Close(false);
+        }
+    }
+
+    uint16_t StandInServer::GetPort() const {
+        return impl_->port;
+    }
+
+    StandInServer::Statistics StandInServer::GetStatistics() const {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->statistics;
+    }
+
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+/**
+ * @file StandInServer.hpp
+ *
+ * This module declares the Twarlock::StandInServer class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Twarlock {
+
+    /**
+     * This is a local HTTPS server which stands in for Twitch, serving
+     * the Helix, Kraken and OAuth2 APIs from fixtures, so that Twarlock
+     * can be run end to end without touching Twitch.
+     *
+     * Lists are split into pages, with cursors, no larger than the
+     * configured page size.  Helix responses carry the Ratelimit-*
+     * headers of a rate limit kept separately for each token, and
+     * the server can be set up to delay its responses and to fail
+     * some requests on purpose.
+     */
+    class StandInServer {
+        // Types
+    public:
+        /**
+         * This holds the settings which shape how the server behaves.
+         */
+        struct Configuration {
+            /**
+             * This is the number of seconds to wait before sending
+             * each response.
+             */
+            double latency = 0.0;
+
+            /**
+             * This is the largest number of list entries to put
+             * in one page.
+             */
+            size_t pageSize = 100;
+
+            /**
+             * If not zero, every request with this number in the order
+             * received (every second, third, and so on) fails on purpose.
+             */
+            size_t faultInterval = 0;
+
+            /**
+             * These are the status codes with which requests fail
+             * on purpose, used in turn.
+             */
+            std::vector< unsigned int > faultStatusCodes{429, 500, 503};
+
+            /**
+             * This is the number of Helix requests each token may make
+             * in one rate limit window.
+             */
+            size_t rateLimit = 800;
+
+            /**
+             * This is the number of seconds in one rate limit window.
+             */
+            double rateLimitWindow = 60.0;
+        };
+
+        /**
+         * This holds counts of what the server did.
+         */
+        struct Statistics {
+            /**
+             * This is the number of requests received.
+             */
+            size_t requests = 0;
+
+            /**
+             * This is the number of requests which failed on purpose.
+             */
+            size_t faults = 0;
+
+            /**
+             * This is the number of requests refused because the token
+             * used had no requests left in its rate limit window.
+             */
+            size_t rateLimited = 0;
+        };
+
+        // Lifecycle Methods
+    public:
+        ~StandInServer() noexcept;
+        StandInServer(const StandInServer&) = delete;
+        StandInServer(StandInServer&&) noexcept;
+        StandInServer& operator=(const StandInServer&) = delete;
+        StandInServer& operator=(StandInServer&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.
+         */
+        StandInServer();
+
+        /**
+         * This method starts the server listening on an ephemeral port
+         * of the local host.
+         *
+         * @param[in] fixturesPath
+         *     This is the path of the file holding the users, follows,
+         *     bans, ban events, channels and tokens to serve.
+         *
+         * @param[in] certsPath
+         *     This is the path of the directory holding the server's
+         *     certificate ("server.pem") and key ("server-key.pem").
+         *
+         * @param[in] configuration
+         *     These are the settings which shape how the server behaves.
+         *
+         * @return
+         *     An indication of whether or not the server started
+         *     is returned.
+         */
+        bool Start(
+            const std::string& fixturesPath,
+            const std::string& certsPath,
+            const Configuration& configuration
+        );
+
+        /**
+         * This method stops the server, dropping any responses
+         * not yet sent.
+         */
+        void Stop();
+
+        /**
+         * This method returns the port on which the server is listening.
+         *
+         * @return
+         *     The port on which the server is listening is returned.
+         */
+        uint16_t GetPort() const;
+
+        /**
+         * This method returns counts of what the server did so far.
+         *
+         * @return
+         *     Counts of what the server did so far are returned.
+         */
+        Statistics GetStatistics() const;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
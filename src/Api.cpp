@@ -22,7 +22,7 @@ namespace {
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
         if (environment.args.empty()) {
             diagnosticsSender.SendDiagnosticInformationString(
@@ -39,7 +39,7 @@ namespace {
                 Json::EncodingOptions encodingOptions;
                 encodingOptions.reencode = true;
                 encodingOptions.pretty = true;
-                printf("%s\n", response.ToEncoding(encodingOptions).c_str());
+                fprintf(environment.outputStream, "%s\n", response.ToEncoding(encodingOptions).c_str());
                 done->set_value();
             },
             [&](unsigned int statusCode){
@@ -54,7 +54,7 @@ namespace {
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
         if (environment.args.empty()) {
             diagnosticsSender.SendDiagnosticInformationString(
@@ -71,7 +71,7 @@ namespace {
                 Json::EncodingOptions encodingOptions;
                 encodingOptions.reencode = true;
                 encodingOptions.pretty = true;
-                printf("%s\n", response.ToEncoding(encodingOptions).c_str());
+                fprintf(environment.outputStream, "%s\n", response.ToEncoding(encodingOptions).c_str());
                 done->set_value();
             },
             [&](unsigned int statusCode){
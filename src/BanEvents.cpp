@@ -6,24 +6,338 @@
  * © 2019 by Richard Walters
  */
 
+#include "Checkpoints.hpp"
 #include "Commands.hpp"
+#include "CrawlCheckpoint.hpp"
 #include "Environment.hpp"
+#include "Output.hpp"
+#include "Paginator.hpp"
+#include "Snapshot.hpp"
 
-#include <future>
+#include <algorithm>
+#include <chrono>
 #include <inttypes.h>
 #include <StringExtensions/StringExtensions.hpp>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
-#include <unordered_set>
+#include <thread>
+#include <vector>
 
 using namespace Twarlock;
 
 namespace {
 
+    /**
+     * This is the default minimum number of seconds to wait between
+     * checks for new ban events when following them.
+     */
+    constexpr double defaultMinPollInterval = 5.0;
+
+    /**
+     * This is the default maximum number of seconds to wait between
+     * checks for new ban events when following them.
+     */
+    constexpr double defaultMaxPollInterval = 300.0;
+
+    /**
+     * This is the number of seconds to sleep at a time while waiting
+     * between checks for new ban events, before checking whether
+     * the program should shut down.
+     */
+    constexpr double shutDownCheckInterval = 0.1;
+
+    /**
+     * These are the fields extracted from each ban event listed.
+     * ParseBanEvent depends on their order.
+     */
+    const std::vector< std::string > banEventFields{
+        "id",
+        "event_timestamp",
+        "event_type",
+        "event_data.user_name",
+        "event_data.user_id",
+    };
+
+    /**
+     * This holds information about one ban or unban event.
+     */
+    struct BanEvent {
+        std::string id;
+        std::string timestamp;
+        std::string type;
+        std::string userName;
+        intmax_t userid = 0;
+    };
+
+    /**
+     * This function extracts information about a ban event from
+     * the given element of a page of ban events.
+     *
+     * @param[in] page
+     *     This is the page of ban events, with the fields given
+     *     by banEventFields.
+     *
+     * @param[in] entry
+     *     This is the index of the element describing the event.
+     *
+     * @param[out] banEvent
+     *     This is where to store information about the event.
+     *
+     * @return
+     *     An indication of whether or not the event could be understood
+     *     is returned.
+     */
+    bool ParseBanEvent(
+        const ListPage& page,
+        size_t entry,
+        BanEvent& banEvent
+    ) {
+        if (sscanf(page.Get(entry, 4).c_str(), "%" SCNdMAX, &banEvent.userid) != 1) {
+            return false;
+        }
+        banEvent.id = page.Get(entry, 0);
+        banEvent.timestamp = page.Get(entry, 1);
+        banEvent.type = page.Get(entry, 2);
+        banEvent.userName = page.Get(entry, 3);
+        return true;
+    }
+
+    /**
+     * This function writes information about the given ban event
+     * to the given output.
+     *
+     * @param[in,out] output
+     *     This is where to write information about the event.
+     *
+     * @param[in] banEvent
+     *     This is the event to write.
+     */
+    void WriteBanEvent(
+        Output& output,
+        const BanEvent& banEvent
+    ) {
+        output.WriteRecord(
+            "%s: %s for %s (%s)",
+            {
+                banEvent.timestamp,
+                banEvent.type,
+                banEvent.userName,
+                StringExtensions::sprintf("%" PRIdMAX, banEvent.userid),
+            }
+        );
+    }
+
+    /**
+     * This function downloads the ban events of the given channel which
+     * happened after the given event.
+     *
+     * @param[in] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] userid
+     *     This is the ID of the channel.
+     *
+     * @param[in] lastEventId
+     *     This is the ID of the newest event already seen, or an empty
+     *     string if no events have been seen.
+     *
+     * @param[in] lastEventTime
+     *     This is the time of the newest event already seen.  Events
+     *     older than this are considered seen, in case the newest event
+     *     seen is no longer listed.
+     *
+     * @param[out] newEvents
+     *     This is where to store the new events, newest first.
+     *
+     * @return
+     *     An indication of whether or not the events could be
+     *     downloaded is returned.
+     */
+    bool FetchNewBanEvents(
+        Twitch& twitch,
+        intmax_t userid,
+        const std::string& lastEventId,
+        int64_t lastEventTime,
+        std::vector< BanEvent >& newEvents
+    ) {
+        Paginator paginator(
+            twitch,
+            Twitch::Api::Helix,
+            StringExtensions::sprintf(
+                "moderation/banned/events?broadcaster_id=%" PRIdMAX "&first=100",
+                userid
+            ),
+            banEventFields
+        );
+        ListPage page;
+        while (paginator.NextPage(page)) {
+            bool reachedSeenEvent = false;
+            for (size_t i = 0; i < page.GetSize(); ++i) {
+                BanEvent banEvent;
+                if (!ParseBanEvent(page, i, banEvent)) {
+                    continue;
+                }
+                if (
+                    (banEvent.id == lastEventId)
+                    || (Snapshot::ParseTime(banEvent.timestamp) < lastEventTime)
+                ) {
+                    reachedSeenEvent = true;
+                    break;
+                }
+                newEvents.push_back(std::move(banEvent));
+            }
+            if (reachedSeenEvent) {
+                paginator.Stop();
+            }
+        }
+        return !paginator.HasFailed();
+    }
+
+    /**
+     * This function lists ban events of the given channel as they happen,
+     * until the program is told to shut down.  The newest event listed
+     * is remembered as a checkpoint, if checkpoints are configured,
+     * so that later runs pick up where this one leaves off.
+     *
+     * @param[in] environment
+     *     This holds the configuration of the program.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] shutDown
+     *     This is set when the program should shut down.
+     *
+     * @param[in] userid
+     *     This is the ID of the channel.
+     *
+     * @param[in,out] output
+     *     This is where to write the events.
+     *
+     * @return
+     *     An indication of whether or not the function succeeded is returned.
+     */
+    bool FollowBanEvents(
+        Environment& environment,
+        SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown,
+        intmax_t userid,
+        Output& output
+    ) {
+        Checkpoints checkpoints;
+        if (environment.configuration.Has("checkpoints")) {
+            if (
+                !checkpoints.Open(
+                    (std::string)environment.configuration["checkpoints"],
+                    diagnosticsSender
+                )
+            ) {
+                return false;
+            }
+        } else {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                "'checkpoints' not configured; the newest event listed won't be remembered for the next run"
+            );
+        }
+        const auto checkpointName = StringExtensions::sprintf(
+            "ban-events/%" PRIdMAX,
+            userid
+        );
+        std::string lastEventId;
+        int64_t lastEventTime = 0;
+        std::string checkpoint;
+        if (checkpoints.Get(checkpointName, checkpoint)) {
+            const auto delimiter = checkpoint.find(' ');
+            lastEventId = checkpoint.substr(0, delimiter);
+            if (delimiter != std::string::npos) {
+                lastEventTime = Snapshot::ParseTime(checkpoint.substr(delimiter + 1));
+            }
+        }
+        auto minPollInterval = defaultMinPollInterval;
+        auto maxPollInterval = defaultMaxPollInterval;
+        const auto& pollIntervalConfiguration = environment.configuration["banEventsPollInterval"];
+        if (pollIntervalConfiguration.Has("min")) {
+            minPollInterval = (double)pollIntervalConfiguration["min"];
+        }
+        if (pollIntervalConfiguration.Has("max")) {
+            maxPollInterval = (double)pollIntervalConfiguration["max"];
+        }
+        auto pollInterval = minPollInterval;
+        while (!shutDown) {
+            // Events are only listed, and the newest one remembered, once
+            // all the new events have been downloaded.  Otherwise, if only
+            // the newest pages were downloaded, the older events not yet
+            // downloaded would be skipped for good.
+            std::vector< BanEvent > newEvents;
+            if (
+                !FetchNewBanEvents(
+                    twitch,
+                    userid,
+                    lastEventId,
+                    lastEventTime,
+                    newEvents
+                )
+            ) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Unable to check for new ban events"
+                );
+                newEvents.clear();
+            }
+            for (auto banEvent = newEvents.rbegin(); banEvent != newEvents.rend(); ++banEvent) {
+                WriteBanEvent(output, *banEvent);
+            }
+            if (!output.Flush(diagnosticsSender)) {
+                return false;
+            }
+
+            // Check again sooner while events are happening, and back off
+            // while the channel is quiet, or while Twitch can't be reached.
+            if (newEvents.empty()) {
+                pollInterval = std::min(pollInterval * 2.0, maxPollInterval);
+            } else {
+                pollInterval = minPollInterval;
+                const auto& newestEvent = newEvents.front();
+                lastEventId = newestEvent.id;
+                lastEventTime = Snapshot::ParseTime(newestEvent.timestamp);
+                checkpoints.Set(
+                    checkpointName,
+                    newestEvent.id + " " + newestEvent.timestamp
+                );
+                if (!checkpoints.Save(diagnosticsSender)) {
+                    diagnosticsSender.SendDiagnosticInformationString(
+                        SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                        "Unable to remember the newest event listed; the next run may list it again"
+                    );
+                }
+            }
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                0,
+                "Checking for new ban events again in %.0lf seconds",
+                pollInterval
+            );
+            for (
+                double waited = 0.0;
+                !shutDown && (waited < pollInterval);
+                waited += shutDownCheckInterval
+            ) {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds((int)(shutDownCheckInterval * 1000.0))
+                );
+            }
+        }
+        return true;
+    }
+
     bool BanEvents(
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
         if (environment.args.empty()) {
             diagnosticsSender.SendDiagnosticInformationString(
@@ -37,61 +351,97 @@ namespace {
         if (userid == 0) {
             return false;
         }
-        std::string cursor;
-        printf("--------------------------------------------------\n");
-        size_t totalEvents = 0;
-        do {
-            const auto done = std::make_shared< std::promise< void > >();
-            auto uri = StringExtensions::sprintf(
+        CrawlCheckpoint checkpoint;
+        if (
+            !environment.follow
+            && !checkpoint.Open(
+                environment,
+                StringExtensions::sprintf("ban-events-list/%" PRIdMAX, userid),
+                diagnosticsSender
+            )
+        ) {
+            return false;
+        }
+        Output output;
+        if (
+            !output.Open(
+                environment,
+                diagnosticsSender,
+                checkpoint.IsResuming()
+            )
+        ) {
+            return false;
+        }
+        output.SetFields({"event_timestamp", "event_type", "user_name", "user_id"});
+        if (environment.follow) {
+            return FollowBanEvents(
+                environment,
+                diagnosticsSender,
+                twitch,
+                shutDown,
+                userid,
+                output
+            );
+        }
+        if (!checkpoint.IsResuming()) {
+            output.WriteText("--------------------------------------------------\n");
+        }
+        auto totalEvents = checkpoint.GetCount();
+        Paginator paginator(
+            twitch,
+            Twitch::Api::Helix,
+            StringExtensions::sprintf(
                 "moderation/banned/events?broadcaster_id=%" PRIdMAX "&first=100",
                 userid
-            );
-            if (!cursor.empty()) {
-                uri += StringExtensions::sprintf(
-                    "&after=%s",
-                    cursor.c_str()
+            ),
+            banEventFields,
+            Twitch::Priority::Bulk,
+            checkpoint.GetCursor()
+        );
+        ListPage page;
+        while (
+            !shutDown
+            && paginator.NextPage(page)
+        ) {
+            for (size_t i = 0; i < page.GetSize(); ++i) {
+                BanEvent banEvent;
+                if (ParseBanEvent(page, i, banEvent)) {
+                    ++totalEvents;
+                    WriteBanEvent(output, banEvent);
+                }
+            }
+            if (!output.Flush(diagnosticsSender)) {
+                return false;
+            }
+            if (
+                !page.cursor.empty()
+                && !checkpoint.Update(page.cursor, totalEvents, diagnosticsSender)
+            ) {
+                return false;
+            }
+        }
+        if (
+            shutDown
+            || paginator.HasFailed()
+        ) {
+            if (shutDown) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Interrupted; run again with --resume to continue"
                 );
             }
-            twitch.PostApiCall(
-                Twitch::Api::Helix,
-                uri,
-                [&](Json::Value&& response){
-                    cursor = response["pagination"]["cursor"];
-                    for (auto dataEntry: response["data"]) {
-                        const auto& event = dataEntry.value();
-                        const auto& eventData = event["event_data"];
-                        intmax_t eventUserid = 0;
-                        if (
-                            sscanf(
-                                ((std::string)eventData["user_id"]).c_str(), "%" SCNdMAX,
-                                &eventUserid
-                            ) == 1
-                        ) {
-                            ++totalEvents;
-                            printf(
-                                "%s: %s for %s (%" PRIdMAX ")\n",
-                                ((std::string)event["event_timestamp"]).c_str(),
-                                ((std::string)event["event_type"]).c_str(),
-                                ((std::string)eventData["user_name"]).c_str(),
-                                eventUserid
-                            );
-                        }
-                    }
-                    done->set_value();
-                },
-                [&](unsigned int statusCode){
-                    done->set_value();
-                }
-            );
-            done->get_future().get();
-        } while (!cursor.empty());
-        printf("--------------------------------------------------\n");
-        printf(
+            return false;
+        }
+        if (!checkpoint.Finish(diagnosticsSender)) {
+            return false;
+        }
+        output.WriteText("--------------------------------------------------\n");
+        output.WriteText(
             "Channel '%s' has had %zu total ban/unban events.\n",
             channelName.c_str(),
             totalEvents
         );
-        return true;
+        return output.Flush(diagnosticsSender);
     };
 
     struct RegisterInfo {
@@ -99,7 +449,16 @@ namespace {
             Command command;
             command.cmdSummary = "List channel ban events";
             command.cmdDetails = (
-                "List all channel ban/unban events."
+                "List all channel ban/unban events.  With --follow, keep"
+                " running and list new events, oldest first, as they happen,"
+                " checking more often while events are happening (see"
+                " 'banEventsPollInterval' in the configuration).  If"
+                " 'checkpoints' is configured, the newest event listed is"
+                " remembered there, so that the next run with --follow"
+                " lists only events which happened since.  Without --follow,"
+                " progress listing all events is remembered there instead,"
+                " so that if the listing is interrupted, it can be continued"
+                " with --resume."
             );
             command.argSummary = "<CHANNEL>";
             command.argDetails = {
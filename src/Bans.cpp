@@ -7,132 +7,394 @@
  */
 
 #include "Commands.hpp"
+#include "CrawlCheckpoint.hpp"
 #include "Environment.hpp"
+#include "FanOut.hpp"
+#include "Output.hpp"
+#include "Paginator.hpp"
+#include "Snapshot.hpp"
 
-#include <future>
 #include <inttypes.h>
 #include <StringExtensions/StringExtensions.hpp>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <time.h>
 #include <unordered_set>
+#include <vector>
 
 using namespace Twarlock;
 
 namespace {
 
+    /**
+     * This function downloads the banned users list of one channel,
+     * or checks if one user is banned in the channel.
+     *
+     * @param[in,out] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] userid
+     *     This is the ID of the channel.
+     *
+     * @param[in] targetUserid
+     *     This is the ID of the user to check, or zero to download
+     *     the complete list.
+     *
+     * @param[in,out] output
+     *     This is where to write the banned users.
+     *
+     * @param[in,out] checkpoint
+     *     This is used to start from where an earlier download was
+     *     interrupted, and to record progress after each page.
+     *
+     * @param[in,out] snapshot
+     *     If not null, this is where to add the banned users.  It may
+     *     already hold banned users found before being interrupted.
+     *
+     * @param[out] numListed
+     *     This is where to store the number of banned users found.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in] shutDown
+     *     This is set if the program is interrupted, in which case
+     *     no more pages are downloaded.
+     *
+     * @return
+     *     An indication of whether or not the banned users list was
+     *     downloaded is returned.
+     */
+    bool DownloadBans(
+        Twitch& twitch,
+        intmax_t userid,
+        intmax_t targetUserid,
+        Output& output,
+        CrawlCheckpoint& checkpoint,
+        Snapshot* snapshot,
+        size_t& numListed,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        const std::atomic< bool >& shutDown
+    ) {
+        std::unordered_set< intmax_t > bannedUserIds;
+        if (snapshot != nullptr) {
+            for (const auto& entry: snapshot->entries) {
+                (void)bannedUserIds.insert(entry.userid);
+            }
+        }
+        numListed = checkpoint.GetCount();
+        auto uri = StringExtensions::sprintf(
+            "moderation/banned?broadcaster_id=%" PRIdMAX,
+            userid
+        );
+        if (targetUserid == 0) {
+            uri += "&first=100";
+        } else {
+            uri += StringExtensions::sprintf(
+                "&user_id=%" PRIdMAX,
+                targetUserid
+            );
+        }
+        Paginator paginator(
+            twitch,
+            Twitch::Api::Helix,
+            uri,
+            {"user_id", "user_name", "expires_at"},
+            Twitch::Priority::Bulk,
+            checkpoint.GetCursor()
+        );
+        ListPage page;
+        while (
+            !shutDown
+            && paginator.NextPage(page)
+        ) {
+            const auto numEntriesBefore = (
+                (snapshot == nullptr)
+                ? 0
+                : snapshot->entries.size()
+            );
+            size_t numNewBannedUserIds = 0;
+            for (size_t i = 0; i < page.GetSize(); ++i) {
+                const auto& bannedUseridString = page.Get(i, 0);
+                const auto& bannedUserName = page.Get(i, 1);
+                intmax_t bannedUserid = 0;
+                if (
+                    sscanf(bannedUseridString.c_str(), "%" SCNdMAX, &bannedUserid) == 1
+                ) {
+                    if (bannedUserIds.insert(bannedUserid).second) {
+                        ++numNewBannedUserIds;
+                        if (
+                            (targetUserid == 0)
+                            || (output.GetFormat() != Output::Format::Human)
+                        ) {
+                            output.WriteRecord(
+                                "%s (%s)",
+                                {
+                                    bannedUserName,
+                                    bannedUseridString,
+                                }
+                            );
+                        }
+                        if (snapshot != nullptr) {
+                            Snapshot::Entry entry;
+                            entry.userid = bannedUserid;
+                            entry.name = bannedUserName;
+                            entry.time = Snapshot::ParseTime(page.Get(i, 2));
+                            snapshot->entries.push_back(std::move(entry));
+                        }
+                    }
+                }
+            }
+            if (!output.Flush(diagnosticsSender)) {
+                return false;
+            }
+            numListed += numNewBannedUserIds;
+            if (numNewBannedUserIds == 0) {
+                paginator.Stop();
+                continue;
+            }
+            if (page.cursor.empty()) {
+                continue;
+            }
+            if (
+                (snapshot != nullptr)
+                && !checkpoint.AppendPartialEntries(
+                    snapshot->entries.begin() + numEntriesBefore,
+                    snapshot->entries.end(),
+                    diagnosticsSender
+                )
+            ) {
+                return false;
+            }
+            if (!checkpoint.Update(page.cursor, numListed, diagnosticsSender)) {
+                return false;
+            }
+        }
+        return (
+            !shutDown
+            && !paginator.HasFailed()
+        );
+    }
+
     bool Bans(
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
-        if (environment.args.empty()) {
+        std::vector< std::string > channelNames;
+        if (
+            !environment.args.empty()
+            && !AddChannelNames(environment.args[0], channelNames, diagnosticsSender)
+        ) {
+            return false;
+        }
+        if (channelNames.empty()) {
             diagnosticsSender.SendDiagnosticInformationString(
                 SystemAbstractions::DiagnosticsSender::Levels::ERROR,
                 "channel name expected"
             );
             return false;
         }
-        const auto channelName = environment.args[0];
-        const auto userid = twitch.GetUserIdByName(channelName);
-        if (userid == 0) {
-            return false;
-        }
         std::string targetUserName;
-        intmax_t targetUserid = 0;
         if (environment.args.size() >= 2) {
             targetUserName = environment.args[1];
-            targetUserid = twitch.GetUserIdByName(targetUserName);
-            if (targetUserid == 0) {
-                return false;
-            }
         }
-        std::unordered_set< intmax_t > bannedUserIds;
-        std::string cursor;
-        if (targetUserid == 0) {
-            printf("--------------------------------------------------\n");
-        }
-        size_t numNewBannedUserIds;
-        do {
-            numNewBannedUserIds = 0;
-            const auto done = std::make_shared< std::promise< void > >();
-            auto uri = StringExtensions::sprintf(
-                "moderation/banned?broadcaster_id=%" PRIdMAX,
-                userid
+        const auto saveSnapshot = !environment.snapshotFilePath.empty();
+        if (
+            saveSnapshot
+            && !targetUserName.empty()
+        ) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "snapshot can only be saved of the complete banned users list"
             );
-            if (targetUserid == 0) {
-                uri += "&first=100";
-            } else {
-                uri += StringExtensions::sprintf(
-                    "&user_id=%" PRIdMAX,
-                    targetUserid
+            return false;
+        }
+        if (channelNames.size() > 1) {
+            if (
+                saveSnapshot
+                || environment.resume
+            ) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "--snapshot and --resume can only be used with one channel"
                 );
+                return false;
             }
-            if (!cursor.empty()) {
-                uri += StringExtensions::sprintf(
-                    "&after=%s",
-                    cursor.c_str()
-                );
+            intmax_t targetUserid = 0;
+            if (!targetUserName.empty()) {
+                targetUserid = twitch.GetUserIdByName(targetUserName);
+                if (targetUserid == 0) {
+                    return false;
+                }
             }
-            twitch.PostApiCall(
-                Twitch::Api::Helix,
-                uri,
-                [&](Json::Value&& response){
-                    cursor = response["pagination"]["cursor"];
-                    const auto& data = response["data"];
-                    if (data.GetType() == Json::Value::Type::Array) {
-                        for (auto dataEntry: data) {
-                            const auto& banned = dataEntry.value();
-                            intmax_t bannedUserid = 0;
-                            if (
-                                sscanf(
-                                    ((std::string)banned["user_id"]).c_str(), "%" SCNdMAX,
-                                    &bannedUserid
-                                ) == 1
-                            ) {
-                                if (bannedUserIds.insert(bannedUserid).second) {
-                                    ++numNewBannedUserIds;
-                                    if (targetUserid == 0) {
-                                        printf(
-                                            "%s (%" PRIdMAX ")\n",
-                                            ((std::string)banned["user_name"]).c_str(),
-                                            bannedUserid
-                                        );
-                                    }
-                                }
-                            }
-                        }
+            Output output;
+            if (!output.Open(environment, diagnosticsSender)) {
+                return false;
+            }
+            return FanOutChannels(
+                environment,
+                diagnosticsSender,
+                twitch,
+                shutDown,
+                channelNames,
+                {"user_name", "user_id"},
+                "Bans",
+                output,
+                [&](
+                    const std::string& channelName,
+                    intmax_t channelId,
+                    Output& output,
+                    intmax_t& total
+                ){
+                    CrawlCheckpoint checkpoint;
+                    size_t numListed = 0;
+                    if (
+                        !DownloadBans(
+                            twitch,
+                            channelId,
+                            targetUserid,
+                            output,
+                            checkpoint,
+                            nullptr,
+                            numListed,
+                            diagnosticsSender,
+                            shutDown
+                        )
+                    ) {
+                        return false;
+                    }
+                    total = (intmax_t)numListed;
+                    if (targetUserid != 0) {
+                        output.WriteText(
+                            "User %s (%" PRIdMAX ") %s.\n",
+                            targetUserName.c_str(),
+                            targetUserid,
+                            (
+                                (numListed == 0)
+                                ? "is not banned"
+                                : "is banned"
+                            )
+                        );
                     }
-                    done->set_value();
-                },
-                [&](unsigned int statusCode){
-                    done->set_value();
+                    return true;
                 }
             );
-            done->get_future().get();
-        } while (
-            !cursor.empty()
-            && (numNewBannedUserIds > 0)
+        }
+        const auto& channelName = channelNames[0];
+        std::vector< std::string > names{channelName};
+        if (!targetUserName.empty()) {
+            names.push_back(targetUserName);
+        }
+        const auto userIds = twitch.GetUserIdsByNames(names);
+        for (const auto& name: names) {
+            const auto userIdsEntry = userIds.find(name);
+            if (userIdsEntry == userIds.end()) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "Could not get ID of user '%s'",
+                    name.c_str()
+                );
+                return false;
+            }
+        }
+        const auto userid = userIds.find(channelName)->second;
+        const intmax_t targetUserid = (
+            targetUserName.empty()
+            ? 0
+            : userIds.find(targetUserName)->second
         );
+        CrawlCheckpoint checkpoint;
+        if (
+            (targetUserid == 0)
+            && !checkpoint.Open(
+                environment,
+                StringExtensions::sprintf("bans/%" PRIdMAX, userid),
+                diagnosticsSender
+            )
+        ) {
+            return false;
+        }
+        Output output;
+        if (
+            !output.Open(
+                environment,
+                diagnosticsSender,
+                checkpoint.IsResuming()
+            )
+        ) {
+            return false;
+        }
+        output.SetFields({"user_name", "user_id"});
+        Snapshot snapshot;
+        snapshot.kind = Snapshot::Kind::Bans;
+        snapshot.channelName = channelName;
+        snapshot.channelId = userid;
+        snapshot.time = (int64_t)::time(NULL);
+        snapshot.fullSyncTime = snapshot.time;
+        if (
+            saveSnapshot
+            && !checkpoint.LoadPartialEntries(snapshot.entries, diagnosticsSender)
+        ) {
+            return false;
+        }
+        if (
+            (targetUserid == 0)
+            && !checkpoint.IsResuming()
+        ) {
+            output.WriteText("--------------------------------------------------\n");
+        }
+        size_t numListed = 0;
+        if (
+            !DownloadBans(
+                twitch,
+                userid,
+                targetUserid,
+                output,
+                checkpoint,
+                (saveSnapshot ? &snapshot : nullptr),
+                numListed,
+                diagnosticsSender,
+                shutDown
+            )
+        ) {
+            if (shutDown) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Interrupted; run again with --resume to continue"
+                );
+            }
+            return false;
+        }
+        if (
+            saveSnapshot
+            && !snapshot.Save(environment.snapshotFilePath, diagnosticsSender)
+        ) {
+            return false;
+        }
+        if (!checkpoint.Finish(diagnosticsSender)) {
+            return false;
+        }
         if (targetUserid == 0) {
-            printf("--------------------------------------------------\n");
-            printf(
+            output.WriteText("--------------------------------------------------\n");
+            output.WriteText(
                 "Channel '%s' has %zu total Bans.\n",
                 channelName.c_str(),
-                bannedUserIds.size()
+                numListed
             );
         } else {
-            printf(
+            output.WriteText(
                 "User %s (%" PRIdMAX ") %s.\n",
                 targetUserName.c_str(),
                 targetUserid,
                 (
-                    bannedUserIds.empty()
+                    (numListed == 0)
                     ? "is not banned"
                     : "is banned"
                 )
             );
         }
-        return true;
+        return output.Flush(diagnosticsSender);
     };
 
     struct RegisterInfo {
@@ -141,11 +403,18 @@ namespace {
             command.cmdSummary = "Download or query banned users list";
             command.cmdDetails = (
                 "Download complete banned users list, or query the list"
-                " to see if a specific user is banned."
+                " to see if a specific user is banned.  If 'checkpoints' is"
+                " configured, progress downloading the complete list is"
+                " remembered there, so that if the download is interrupted,"
+                " it can be continued with --resume.  If more than one channel"
+                " is given, their lists are downloaded at the same time, up to"
+                " 'maxConcurrentChannels' (from the configuration) at once,"
+                " and written one channel at a time, followed by a summary of"
+                " each channel's total and how long it took."
             );
             command.argSummary = "<CHANNEL> [USER]";
             command.argDetails = {
-                {"CHANNEL", "Name of the channel for which to download banned user list"},
+                {"CHANNEL", "Name of the channel for which to download banned user list, several names separated by commas, or '@' followed by the path of a file listing names"},
                 {"USER", "Name of the user to check if banned"},
             };
             command.execute = Bans;
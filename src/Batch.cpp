@@ -0,0 +1,529 @@
+/**
+ * @file Batch.cpp
+ *
+ * This module defines the Twarlock::Batch command.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Commands.hpp"
+#include "Environment.hpp"
+#include "LoadFile.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <StringExtensions/StringExtensions.hpp>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define pipe(fds) _pipe(fds, 65536, _O_BINARY)
+#define fdopen _fdopen
+#define read _read
+#define close _close
+#else /* not _WIN32 */
+#include <unistd.h>
+#endif /* _WIN32 or not _WIN32 */
+
+using namespace Twarlock;
+
+namespace {
+
+    /**
+     * This is the number of jobs run at the same time, unless
+     * "maxConcurrentJobs" is set in the configuration.
+     */
+    constexpr size_t defaultMaxConcurrentJobs = 4;
+
+    /**
+     * This is the maximum number of bytes of results to read at a time
+     * from a job.
+     */
+    constexpr size_t outputChunkSize = 65536;
+
+    /**
+     * This holds one command to run as part of the batch.
+     */
+    struct Job {
+        /**
+         * This is the number of the line in the batch script
+         * holding the command.  It's used to tag the results
+         * and diagnostic messages of the job.
+         */
+        size_t lineNumber = 0;
+
+        /**
+         * This holds the command to execute, its arguments and options.
+         */
+        Environment environment;
+    };
+
+    /**
+     * This function splits the given line into words separated by
+     * whitespace.  Words may be enclosed in double quotes in order
+     * to include whitespace in them.
+     *
+     * @param[in] line
+     *     This is the line to split.
+     *
+     * @return
+     *     The words of the line are returned.
+     */
+    std::vector< std::string > SplitWords(const std::string& line) {
+        std::vector< std::string > words;
+        std::string word;
+        bool inWord = false;
+        bool quoted = false;
+        for (const auto c: line) {
+            if (quoted) {
+                if (c == '"') {
+                    quoted = false;
+                } else {
+                    word += c;
+                }
+            } else if (c == '"') {
+                quoted = true;
+                inWord = true;
+            } else if (
+                (c == ' ')
+                || (c == '\t')
+                || (c == '\r')
+            ) {
+                if (inWord) {
+                    words.push_back(std::move(word));
+                    word.clear();
+                    inWord = false;
+                }
+            } else {
+                word += c;
+                inWord = true;
+            }
+        }
+        if (inWord) {
+            words.push_back(std::move(word));
+        }
+        return words;
+    }
+
+    /**
+     * This function parses the given line of a batch script into
+     * a job.  The line holds any options, followed by the command
+     * and its arguments, just like the command line of the program.
+     * Options not given are taken from the batch itself.
+     *
+     * @param[in] words
+     *     These are the words of the line.
+     *
+     * @param[in,out] job
+     *     This is the job to fill in.  Its environment should already
+     *     be a copy of the environment of the batch.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @return
+     *     An indication of whether or not the line was parsed
+     *     is returned.
+     */
+    bool ParseJob(
+        const std::vector< std::string >& words,
+        Job& job,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        auto& environment = job.environment;
+        const std::map< std::string, std::string* > valueOptions{
+            {"--format", &environment.outputFormat},
+            {"--output", &environment.outputFilePath},
+            {"--snapshot", &environment.snapshotFilePath},
+        };
+        const std::map< std::string, bool* > flagOptions{
+            {"--follow", &environment.follow},
+            {"--resume", &environment.resume},
+        };
+        environment.args.clear();
+        environment.command.clear();
+        for (size_t i = 0; i < words.size(); ++i) {
+            const auto& word = words[i];
+            if (!environment.command.empty()) {
+                environment.args.push_back(word);
+                continue;
+            }
+            const auto valueOptionsEntry = valueOptions.find(word);
+            const auto flagOptionsEntry = flagOptions.find(word);
+            if (valueOptionsEntry != valueOptions.end()) {
+                if (++i >= words.size()) {
+                    diagnosticsSender.SendDiagnosticInformationFormatted(
+                        SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                        "line %zu: value expected after %s",
+                        job.lineNumber,
+                        word.c_str()
+                    );
+                    return false;
+                }
+                *valueOptionsEntry->second = words[i];
+            } else if (flagOptionsEntry != flagOptions.end()) {
+                *flagOptionsEntry->second = true;
+            } else {
+                environment.command = word;
+            }
+        }
+        if (environment.command.empty()) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "line %zu: command expected",
+                job.lineNumber
+            );
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * This function reads the whole standard input stream.
+     *
+     * @return
+     *     The contents of the standard input stream are returned.
+     */
+    std::string ReadStandardInput() {
+        std::string contents;
+        std::vector< char > buffer(outputChunkSize);
+        for (;;) {
+            const auto amountRead = fread(buffer.data(), 1, buffer.size(), stdin);
+            if (amountRead == 0) {
+                break;
+            }
+            contents.append(buffer.data(), amountRead);
+        }
+        return contents;
+    }
+
+    /**
+     * This function runs the given job, writing its results to the
+     * output stream of the batch, tagged by the line number of the job
+     * in the batch script.  In the human-readable format, each line is
+     * tagged with the line number in brackets.  In other formats, each
+     * record gets a "job" field holding it, and a header line is only
+     * written if it differs from the last one written.
+     *
+     * @param[in,out] job
+     *     This is the job to run.
+     *
+     * @param[in] command
+     *     This is the command which the job executes.
+     *
+     * @param[in] batchEnvironment
+     *     This is the environment of the batch.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in,out] outputMutex
+     *     This is used to keep the results of jobs from being mixed
+     *     together within a line.
+     *
+     * @param[in,out] lastHeader
+     *     This is the last header line written to the output stream of
+     *     the batch.  It's protected by outputMutex.
+     *
+     * @param[in,out] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] shutDown
+     *     This is set if the program is interrupted.
+     *
+     * @return
+     *     An indication of whether or not the job succeeded is returned.
+     */
+    bool RunJob(
+        Job& job,
+        const Command& command,
+        const Environment& batchEnvironment,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        std::mutex& outputMutex,
+        std::string& lastHeader,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown
+    ) {
+        const auto lineNumber = job.lineNumber;
+        const auto& format = job.environment.outputFormat;
+        const auto humanFormat = (
+            format.empty()
+            || (format == "human")
+        );
+        const auto hasHeader = (
+            (format == "csv")
+            || (format == "tsv")
+        );
+        if (!humanFormat) {
+            job.environment.outputGroupFields.emplace_back(
+                "job",
+                StringExtensions::sprintf("%zu", lineNumber)
+            );
+        }
+        SystemAbstractions::DiagnosticsSender jobDiagnosticsSender("Twarlock");
+        (void)jobDiagnosticsSender.SubscribeToDiagnostics(
+            [&diagnosticsSender, lineNumber](
+                std::string senderName,
+                size_t level,
+                std::string message
+            ){
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    level,
+                    "[%zu] %s",
+                    lineNumber,
+                    message.c_str()
+                );
+            }
+        );
+        int outputPipe[2];
+        if (pipe(outputPipe) != 0) {
+            jobDiagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to create pipe"
+            );
+            return false;
+        }
+        job.environment.outputStream = fdopen(outputPipe[1], "wb");
+        (void)setbuf(job.environment.outputStream, NULL);
+        const auto batchOutputStream = batchEnvironment.outputStream;
+        std::thread relay(
+            [
+                &outputMutex,
+                &lastHeader,
+                batchOutputStream,
+                lineNumber,
+                humanFormat,
+                hasHeader,
+                &outputPipe
+            ]{
+                const auto tag = (
+                    humanFormat
+                    ? StringExtensions::sprintf("[%zu] ", lineNumber)
+                    : std::string()
+                );
+                bool expectHeader = hasHeader;
+                std::vector< char > buffer(outputChunkSize);
+                std::string line;
+                for (;;) {
+                    const auto amountRead = read(outputPipe[0], buffer.data(), (unsigned int)buffer.size());
+                    if (amountRead <= 0) {
+                        break;
+                    }
+                    std::string tagged;
+                    for (int i = 0; i < (int)amountRead; ++i) {
+                        line += buffer[i];
+                        if (
+                            (buffer[i] == '\n')
+                            && expectHeader
+                        ) {
+                            // The header line is the first line, so
+                            // nothing else has been tagged yet.
+                            expectHeader = false;
+                            std::lock_guard< std::mutex > lock(outputMutex);
+                            if (line != lastHeader) {
+                                (void)fwrite(line.data(), 1, line.length(), batchOutputStream);
+                                lastHeader = line;
+                            }
+                            line.clear();
+                        } else if (buffer[i] == '\n') {
+                            tagged += tag;
+                            tagged += line;
+                            line.clear();
+                        }
+                    }
+                    if (!tagged.empty()) {
+                        std::lock_guard< std::mutex > lock(outputMutex);
+                        (void)fwrite(tagged.data(), 1, tagged.length(), batchOutputStream);
+                    }
+                }
+                if (!line.empty()) {
+                    std::lock_guard< std::mutex > lock(outputMutex);
+                    (void)fprintf(batchOutputStream, "%s%s\n", tag.c_str(), line.c_str());
+                }
+            }
+        );
+        const auto success = command.execute(
+            job.environment,
+            jobDiagnosticsSender,
+            twitch,
+            shutDown
+        );
+        (void)fclose(job.environment.outputStream);
+        relay.join();
+        (void)close(outputPipe[0]);
+        return success;
+    }
+
+    bool Batch(
+        Environment& environment,
+        SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown
+    ) {
+        std::string script;
+        if (
+            environment.args.empty()
+            || (environment.args[0] == "-")
+        ) {
+            script = ReadStandardInput();
+        } else if (
+            !LoadFile(
+                environment.args[0],
+                "batch script",
+                diagnosticsSender,
+                script
+            )
+        ) {
+            return false;
+        }
+        const auto commands = Commands::Build();
+        std::vector< Job > jobs;
+        size_t lineNumber = 0;
+        for (const auto& line: StringExtensions::Split(script, '\n')) {
+            ++lineNumber;
+            const auto words = SplitWords(line);
+            if (
+                words.empty()
+                || (words[0][0] == '#')
+            ) {
+                continue;
+            }
+            Job job;
+            job.lineNumber = lineNumber;
+            job.environment = environment;
+            job.environment.outputFilePath.clear();
+            job.environment.snapshotFilePath.clear();
+            if (!ParseJob(words, job, diagnosticsSender)) {
+                return false;
+            }
+            const auto& commandName = job.environment.command;
+            if (
+                (commands.find(commandName) == commands.end())
+                || (commandName == "batch")
+                || (commandName == "serve")
+            ) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "line %zu: no such command '%s'",
+                    lineNumber,
+                    commandName.c_str()
+                );
+                return false;
+            }
+            jobs.push_back(std::move(job));
+        }
+        auto batchEnvironment = environment;
+        if (!environment.outputFilePath.empty()) {
+            batchEnvironment.outputStream = fopen(environment.outputFilePath.c_str(), "wb");
+            if (batchEnvironment.outputStream == NULL) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "Unable to open output file '%s'",
+                    environment.outputFilePath.c_str()
+                );
+                return false;
+            }
+        }
+        size_t maxConcurrentJobs = defaultMaxConcurrentJobs;
+        if (environment.configuration.Has("maxConcurrentJobs")) {
+            const int configuredMaxConcurrentJobs = environment.configuration["maxConcurrentJobs"];
+            if (configuredMaxConcurrentJobs > 0) {
+                maxConcurrentJobs = (size_t)configuredMaxConcurrentJobs;
+            }
+        }
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            2,
+            "Running %zu jobs, up to %zu at a time",
+            jobs.size(),
+            maxConcurrentJobs
+        );
+        std::mutex jobsMutex;
+        std::mutex outputMutex;
+        std::string lastHeader;
+        size_t nextJob = 0;
+        size_t numFailed = 0;
+        std::vector< std::thread > runners;
+        for (size_t i = 0; i < std::min(maxConcurrentJobs, jobs.size()); ++i) {
+            runners.emplace_back(
+                [&]{
+                    std::unique_lock< std::mutex > lock(jobsMutex);
+                    while (
+                        !shutDown
+                        && (nextJob < jobs.size())
+                    ) {
+                        auto& job = jobs[nextJob++];
+                        lock.unlock();
+                        const auto success = RunJob(
+                            job,
+                            commands.find(job.environment.command)->second,
+                            batchEnvironment,
+                            diagnosticsSender,
+                            outputMutex,
+                            lastHeader,
+                            twitch,
+                            shutDown
+                        );
+                        lock.lock();
+                        if (!success) {
+                            ++numFailed;
+                        }
+                    }
+                }
+            );
+        }
+        for (auto& runner: runners) {
+            runner.join();
+        }
+        if (batchEnvironment.outputStream != environment.outputStream) {
+            (void)fclose(batchEnvironment.outputStream);
+        }
+        const auto numRun = nextJob;
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            2,
+            "%zu of %zu jobs run, %zu failed",
+            numRun,
+            jobs.size(),
+            numFailed
+        );
+        return (
+            (numRun == jobs.size())
+            && (numFailed == 0)
+        );
+    };
+
+    struct RegisterInfo {
+        RegisterInfo() {
+            Command command;
+            command.cmdSummary = "Run many commands at once";
+            command.cmdDetails = (
+                "Read commands, one per line, and run them at the same time,"
+                " up to 'maxConcurrentJobs' (from the configuration) at once,"
+                " sharing the same connections to Twitch, caches and rate"
+                " limit.  Each line holds any options, the command and its"
+                " arguments, just like the command line.  Blank lines and"
+                " lines starting with '#' are skipped.  Each line of results"
+                " and each diagnostic message is tagged with the number of"
+                " the line holding the command, in brackets, and written to"
+                " the output file given to the batch, if any.  In the ndjson,"
+                " csv and tsv formats, the number is given in a 'job' field"
+                " of each record instead, and a header line is only repeated"
+                " when it differs from the last one.  Commands may"
+                " have their own --output and --snapshot options; other"
+                " options given to the batch apply to every command."
+            );
+            command.argSummary = "[SCRIPT]";
+            command.argDetails = {
+                {"SCRIPT", "Path of the file holding the commands (or '-' or nothing to read the standard input)"},
+            };
+            command.execute = Batch;
+            Commands::Add("batch", std::move(command));
+        }
+    } registerInfo;
+
+}
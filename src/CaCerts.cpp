@@ -0,0 +1,46 @@
+/**
+ * @file CaCerts.cpp
+ *
+ * This module contains the implementation of the Twarlock::ExtractCaCerts
+ * function.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "CaCerts.hpp"
+
+#include <set>
+
+namespace Twarlock {
+
+    std::string ExtractCaCerts(
+        const std::string& caCerts,
+        size_t& numCerts
+    ) {
+        static const std::string beginMarker = "-----BEGIN CERTIFICATE-----";
+        static const std::string endMarker = "-----END CERTIFICATE-----";
+        std::set< std::string > certsSeen;
+        std::string certs;
+        size_t pos = 0;
+        for (;;) {
+            const auto begin = caCerts.find(beginMarker, pos);
+            if (begin == std::string::npos) {
+                break;
+            }
+            auto end = caCerts.find(endMarker, begin);
+            if (end == std::string::npos) {
+                break;
+            }
+            end += endMarker.length();
+            auto cert = caCerts.substr(begin, end - begin);
+            pos = end;
+            if (certsSeen.insert(cert).second) {
+                certs += cert;
+                certs += '\n';
+            }
+        }
+        numCerts = certsSeen.size();
+        return certs;
+    }
+
+}
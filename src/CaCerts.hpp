@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+ * @file CaCerts.hpp
+ *
+ * This module declares the Twarlock::ExtractCaCerts function.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <stddef.h>
+#include <string>
+
+namespace Twarlock {
+
+    /**
+     * This function extracts the PEM-encoded certificates from the given
+     * CA certificate bundle, dropping any duplicates along with all the
+     * commentary (subject names, text dumps of certificate fields, etc.)
+     * found between them, so that the TLS library has as little as
+     * possible to parse each time a connection is made.
+     *
+     * @param[in] caCerts
+     *     This is the CA certificate bundle to parse.
+     *
+     * @param[out] numCerts
+     *     This is where to store the number of certificates extracted.
+     *
+     * @return
+     *     The PEM-encoded certificates found in the bundle are returned.
+     */
+    std::string ExtractCaCerts(
+        const std::string& caCerts,
+        size_t& numCerts
+    );
+
+}
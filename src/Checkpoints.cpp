@@ -0,0 +1,260 @@
+/**
+ * @file Checkpoints.cpp
+ *
+ * This module contains the implementation of the Twarlock::Checkpoints class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Checkpoints.hpp"
+#include "LoadFile.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <StringExtensions/StringExtensions.hpp>
+#include <SystemAbstractions/File.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#else /* not _WIN32 */
+#include <unistd.h>
+#endif /* _WIN32 or not _WIN32 */
+
+namespace {
+
+    /**
+     * This is held while checkpoints are being saved, so that commands
+     * running at the same time (in a batch, or served to different
+     * clients) don't overwrite each other's checkpoints.
+     */
+    std::mutex saveMutex;
+
+    /**
+     * This is used to give each temporary file written while saving
+     * checkpoints a unique name.
+     */
+    std::atomic< unsigned int > nextTempFileId(1);
+
+    /**
+     * This function returns the identifier of the running process,
+     * used to keep the temporary files of different processes apart.
+     *
+     * @return
+     *     The identifier of the running process is returned.
+     */
+    int GetProcessId() {
+#ifdef _WIN32
+        return _getpid();
+#else /* not _WIN32 */
+        return (int)getpid();
+#endif /* _WIN32 or not _WIN32 */
+    }
+
+    /**
+     * This function parses the contents of a checkpoint file.
+     *
+     * @param[in] contents
+     *     These are the contents of the checkpoint file.
+     *
+     * @param[out] checkpoints
+     *     This is where to store the checkpoints, keyed by name.
+     */
+    void ParseCheckpoints(
+        const std::string& contents,
+        std::map< std::string, std::string >& checkpoints
+    ) {
+        size_t lineStart = 0;
+        while (lineStart < contents.length()) {
+            auto lineEnd = contents.find('\n', lineStart);
+            if (lineEnd == std::string::npos) {
+                lineEnd = contents.length();
+            }
+            const auto delimiter = contents.find('\t', lineStart);
+            if (delimiter < lineEnd) {
+                checkpoints[contents.substr(lineStart, delimiter - lineStart)] = (
+                    contents.substr(delimiter + 1, lineEnd - delimiter - 1)
+                );
+            }
+            lineStart = lineEnd + 1;
+        }
+    }
+
+}
+
+namespace Twarlock {
+
+    /**
+     * This contains the private properties of a Checkpoints class instance.
+     */
+    struct Checkpoints::Impl {
+        /**
+         * This holds the checkpoints, keyed by name.
+         */
+        std::map< std::string, std::string > checkpoints;
+
+        /**
+         * These are the names of the checkpoints set since they were
+         * last loaded or saved.
+         */
+        std::set< std::string > changed;
+
+        /**
+         * These are the names of the checkpoints removed since they were
+         * last loaded or saved.
+         */
+        std::set< std::string > removed;
+
+        /**
+         * This is the path to the file holding the checkpoints, or an
+         * empty string if checkpoints aren't backed by a file.
+         */
+        std::string path;
+    };
+
+    Checkpoints::~Checkpoints() noexcept = default;
+    Checkpoints::Checkpoints(Checkpoints&&) noexcept = default;
+    Checkpoints& Checkpoints::operator=(Checkpoints&&) noexcept = default;
+
+    Checkpoints::Checkpoints()
+        : impl_(new Impl())
+    {
+    }
+
+    bool Checkpoints::Open(
+        const std::string& path,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        impl_->checkpoints.clear();
+        impl_->changed.clear();
+        impl_->removed.clear();
+        impl_->path = path;
+        std::lock_guard< std::mutex > lock(saveMutex);
+        if (!SystemAbstractions::File(path).IsExisting()) {
+            return true;
+        }
+        std::string contents;
+        if (
+            !LoadFile(
+                path,
+                "checkpoints",
+                diagnosticsSender,
+                contents
+            )
+        ) {
+            return false;
+        }
+        ParseCheckpoints(contents, impl_->checkpoints);
+        return true;
+    }
+
+    bool Checkpoints::IsOpen() const {
+        return !impl_->path.empty();
+    }
+
+    bool Checkpoints::Get(
+        const std::string& name,
+        std::string& value
+    ) const {
+        const auto checkpointsEntry = impl_->checkpoints.find(name);
+        if (checkpointsEntry == impl_->checkpoints.end()) {
+            return false;
+        }
+        value = checkpointsEntry->second;
+        return true;
+    }
+
+    void Checkpoints::Set(
+        const std::string& name,
+        const std::string& value
+    ) {
+        impl_->checkpoints[name] = value;
+        (void)impl_->changed.insert(name);
+        (void)impl_->removed.erase(name);
+    }
+
+    void Checkpoints::Remove(const std::string& name) {
+        (void)impl_->checkpoints.erase(name);
+        (void)impl_->changed.erase(name);
+        (void)impl_->removed.insert(name);
+    }
+
+    bool Checkpoints::Save(const SystemAbstractions::DiagnosticsSender& diagnosticsSender) {
+        if (impl_->path.empty()) {
+            return true;
+        }
+
+        // Pick up any checkpoints saved by others since the file was
+        // loaded, and apply only the changes made here on top of them.
+        std::lock_guard< std::mutex > lock(saveMutex);
+        std::map< std::string, std::string > checkpoints;
+        if (SystemAbstractions::File(impl_->path).IsExisting()) {
+            std::string contents;
+            if (
+                !LoadFile(
+                    impl_->path,
+                    "checkpoints",
+                    diagnosticsSender,
+                    contents
+                )
+            ) {
+                return false;
+            }
+            ParseCheckpoints(contents, checkpoints);
+        }
+        for (const auto& name: impl_->changed) {
+            checkpoints[name] = impl_->checkpoints[name];
+        }
+        for (const auto& name: impl_->removed) {
+            (void)checkpoints.erase(name);
+        }
+        const auto tempPath = StringExtensions::sprintf(
+            "%s.%d.%u.tmp",
+            impl_->path.c_str(),
+            GetProcessId(),
+            nextTempFileId++
+        );
+        const auto file = fopen(tempPath.c_str(), "wb");
+        bool success = (file != NULL);
+        if (success) {
+            for (const auto& checkpointsEntry: checkpoints) {
+                if (
+                    fprintf(
+                        file,
+                        "%s\t%s\n",
+                        checkpointsEntry.first.c_str(),
+                        checkpointsEntry.second.c_str()
+                    ) < 0
+                ) {
+                    success = false;
+                    break;
+                }
+            }
+            if (fclose(file) != 0) {
+                success = false;
+            }
+        }
+        if (success) {
+#ifdef _WIN32
+            (void)remove(impl_->path.c_str());
+#endif /* _WIN32 */
+            success = (rename(tempPath.c_str(), impl_->path.c_str()) == 0);
+        }
+        if (success) {
+            impl_->checkpoints = std::move(checkpoints);
+            impl_->changed.clear();
+            impl_->removed.clear();
+        } else {
+            (void)remove(tempPath.c_str());
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to save checkpoints to '%s'",
+                impl_->path.c_str()
+            );
+        }
+        return success;
+    }
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+/**
+ * @file Checkpoints.hpp
+ *
+ * This module declares the Twarlock::Checkpoints class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <memory>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+
+namespace Twarlock {
+
+    /**
+     * This remembers, in a small file, how far commands have progressed
+     * through lists they download, so that later runs can pick up where
+     * earlier ones left off.
+     *
+     * The file holds one line per checkpoint, with the name of the
+     * checkpoint and its value separated by a tab.  The file is rewritten
+     * whenever checkpoints are saved.  Several instances may share the
+     * same file; each only writes the checkpoints it changed, on top of
+     * whatever the others saved.
+     */
+    class Checkpoints {
+        // Lifecycle Methods
+    public:
+        ~Checkpoints() noexcept;
+        Checkpoints(const Checkpoints&) = delete;
+        Checkpoints(Checkpoints&&) noexcept;
+        Checkpoints& operator=(const Checkpoints&) = delete;
+        Checkpoints& operator=(Checkpoints&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.
+         */
+        Checkpoints();
+
+        /**
+         * This method loads the checkpoints from the given file, and
+         * arranges for them to be saved back to it.
+         *
+         * @param[in] path
+         *     This is the path to the file holding the checkpoints.
+         *     It's fine if it doesn't exist yet.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the checkpoints could be
+         *     loaded is returned.
+         */
+        bool Open(
+            const std::string& path,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        );
+
+        /**
+         * This method returns an indication of whether or not checkpoints
+         * are backed by a file.
+         *
+         * @return
+         *     An indication of whether or not checkpoints are backed
+         *     by a file is returned.
+         */
+        bool IsOpen() const;
+
+        /**
+         * This method looks up the checkpoint with the given name.
+         *
+         * @param[in] name
+         *     This is the name of the checkpoint to look up.
+         *
+         * @param[out] value
+         *     This is where to store the value of the checkpoint, if found.
+         *
+         * @return
+         *     An indication of whether or not the checkpoint was found
+         *     is returned.
+         */
+        bool Get(
+            const std::string& name,
+            std::string& value
+        ) const;
+
+        /**
+         * This method sets the checkpoint with the given name.
+         * The change isn't written to the file until Save is called.
+         *
+         * @param[in] name
+         *     This is the name of the checkpoint to set.  It must not
+         *     contain tabs or line breaks.
+         *
+         * @param[in] value
+         *     This is the value of the checkpoint.  It must not contain
+         *     line breaks.
+         */
+        void Set(
+            const std::string& name,
+            const std::string& value
+        );
+
+        /**
+         * This method removes the checkpoint with the given name.
+         * The change isn't written to the file until Save is called.
+         *
+         * @param[in] name
+         *     This is the name of the checkpoint to remove.
+         */
+        void Remove(const std::string& name);
+
+        /**
+         * This method writes the checkpoints to the file.  The file is
+         * loaded again first, and only the checkpoints set or removed
+         * through this instance are changed, so that checkpoints saved
+         * by others in the meantime are kept.  The new contents are
+         * written to a temporary file first, with a name unique to this
+         * save, which then replaces the checkpoint file, so that the
+         * checkpoint file is never left partially written.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the checkpoints were saved
+         *     is returned.
+         */
+        bool Save(const SystemAbstractions::DiagnosticsSender& diagnosticsSender);
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
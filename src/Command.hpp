@@ -11,6 +11,7 @@
 #include "Environment.hpp"
 #include "Twitch.hpp"
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <string>
@@ -32,7 +33,7 @@ namespace Twarlock {
                 Twarlock::Environment& environment,
                 SystemAbstractions::DiagnosticsSender& diagnosticsSender,
                 Twitch& twitch,
-                const bool& shutDown
+                const std::atomic< bool >& shutDown
             )
         > execute;
     };
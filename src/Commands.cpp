@@ -29,6 +29,12 @@ namespace {
 
     CommandToAdd* nextCommand = nullptr;
 
+    /**
+     * This holds the commands which have been built so far, so that
+     * the table can be built more than once.
+     */
+    Twarlock::Commands::Table builtCommands;
+
 }
 
 namespace Twarlock {
@@ -42,17 +48,16 @@ namespace Twarlock {
     }
 
     auto Commands::Build() -> Table {
-        Table table;
         while (nextCommand != nullptr) {
             auto* command = nextCommand;
             nextCommand = command->next;
-            (void)table.insert({
+            (void)builtCommands.insert({
                 std::move(command->name),
                 std::move(command->command)
             });
             delete command;
         }
-        return table;
+        return builtCommands;
     }
 
 }
@@ -0,0 +1,319 @@
+/**
+ * @file CrawlCheckpoint.cpp
+ *
+ * This module contains the implementation of the
+ * Twarlock::CrawlCheckpoint class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Checkpoints.hpp"
+#include "CrawlCheckpoint.hpp"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+namespace Twarlock {
+
+    /**
+     * This contains the private properties of a CrawlCheckpoint
+     * class instance.
+     */
+    struct CrawlCheckpoint::Impl {
+        // Properties
+
+        Checkpoints checkpoints;
+
+        /**
+         * This is the number of things listed so far.
+         */
+        size_t count = 0;
+
+        /**
+         * This is the cursor of the next page to download.
+         */
+        std::string cursor;
+
+        /**
+         * This is the name of the checkpoint in the checkpoints file.
+         */
+        std::string name;
+
+        /**
+         * This is the file to which snapshot entries are appended,
+         * if it's open.
+         */
+        FILE* partialEntriesFile = NULL;
+
+        /**
+         * This is the path to the file holding the snapshot entries
+         * collected so far, or an empty string if no snapshot is
+         * being saved.
+         */
+        std::string partialEntriesPath;
+
+        bool resuming = false;
+
+        // Lifecycle
+
+        ~Impl() {
+            ClosePartialEntriesFile();
+        }
+        Impl(const Impl&) = delete;
+        Impl(Impl&&) = delete;
+        Impl& operator=(const Impl&) = delete;
+        Impl& operator=(Impl&&) = delete;
+
+        // Methods
+
+        Impl() = default;
+
+        void ClosePartialEntriesFile() {
+            if (partialEntriesFile != NULL) {
+                (void)fclose(partialEntriesFile);
+                partialEntriesFile = NULL;
+            }
+        }
+    };
+
+    CrawlCheckpoint::~CrawlCheckpoint() noexcept = default;
+    CrawlCheckpoint::CrawlCheckpoint(CrawlCheckpoint&&) noexcept = default;
+    CrawlCheckpoint& CrawlCheckpoint::operator=(CrawlCheckpoint&&) noexcept = default;
+
+    CrawlCheckpoint::CrawlCheckpoint()
+        : impl_(new Impl())
+    {
+    }
+
+    bool CrawlCheckpoint::Open(
+        const Environment& environment,
+        const std::string& name,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        if (!environment.configuration.Has("checkpoints")) {
+            if (environment.resume) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "--resume needs 'checkpoints' in the configuration"
+                );
+                return false;
+            }
+            return true;
+        }
+        if (
+            !impl_->checkpoints.Open(
+                (std::string)environment.configuration["checkpoints"],
+                diagnosticsSender
+            )
+        ) {
+            return false;
+        }
+        impl_->name = name;
+        if (!environment.snapshotFilePath.empty()) {
+            impl_->partialEntriesPath = environment.snapshotFilePath + ".partial";
+        }
+        std::string checkpoint;
+        if (
+            environment.resume
+            && impl_->checkpoints.Get(name, checkpoint)
+        ) {
+            const auto delimiter = checkpoint.find(' ');
+            if (
+                (delimiter != std::string::npos)
+                && (sscanf(checkpoint.c_str(), "%zu", &impl_->count) == 1)
+            ) {
+                impl_->cursor = checkpoint.substr(delimiter + 1);
+                impl_->resuming = true;
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    2,
+                    "Resuming after %zu entries",
+                    impl_->count
+                );
+            }
+        } else if (environment.resume) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                "Nothing to resume; starting from the beginning"
+            );
+        }
+        return true;
+    }
+
+    bool CrawlCheckpoint::IsResuming() const {
+        return impl_->resuming;
+    }
+
+    const std::string& CrawlCheckpoint::GetCursor() const {
+        return impl_->cursor;
+    }
+
+    size_t CrawlCheckpoint::GetCount() const {
+        return impl_->count;
+    }
+
+    bool CrawlCheckpoint::LoadPartialEntries(
+        std::vector< Snapshot::Entry >& entries,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        if (
+            !impl_->resuming
+            || impl_->partialEntriesPath.empty()
+            || (impl_->count == 0)
+        ) {
+            return true;
+        }
+        const auto file = fopen(impl_->partialEntriesPath.c_str(), "rb");
+        if (file == NULL) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to open '%s'",
+                impl_->partialEntriesPath.c_str()
+            );
+            return false;
+        }
+
+        // Only the entries collected up to the checkpoint are loaded,
+        // since any after that will be collected again.
+        char line[256];
+        size_t numLoaded = 0;
+        while (
+            (numLoaded < impl_->count)
+            && (fgets(line, sizeof(line), file) != NULL)
+        ) {
+            Snapshot::Entry entry;
+            int nameOffset = 0;
+            if (
+                sscanf(
+                    line,
+                    "%" SCNdMAX "\t%" SCNd64 "\t%n",
+                    &entry.userid,
+                    &entry.time,
+                    &nameOffset
+                ) != 2
+            ) {
+                continue;
+            }
+            entry.name = line + nameOffset;
+            while (
+                !entry.name.empty()
+                && (entry.name.back() == '\n')
+            ) {
+                entry.name.pop_back();
+            }
+            entries.push_back(std::move(entry));
+            ++numLoaded;
+        }
+        (void)fclose(file);
+        if (numLoaded < impl_->count) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Only %zu of %zu entries found in '%s'",
+                numLoaded,
+                impl_->count,
+                impl_->partialEntriesPath.c_str()
+            );
+            return false;
+        }
+
+        // Rewrite the file with only the entries loaded, so that any
+        // collected after the checkpoint aren't recorded twice.
+        impl_->partialEntriesFile = fopen(impl_->partialEntriesPath.c_str(), "wb");
+        if (impl_->partialEntriesFile == NULL) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to open '%s'",
+                impl_->partialEntriesPath.c_str()
+            );
+            return false;
+        }
+        return AppendPartialEntries(
+            entries.end() - numLoaded,
+            entries.end(),
+            diagnosticsSender
+        );
+    }
+
+    bool CrawlCheckpoint::AppendPartialEntries(
+        std::vector< Snapshot::Entry >::const_iterator begin,
+        std::vector< Snapshot::Entry >::const_iterator end,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        if (
+            impl_->name.empty()
+            || impl_->partialEntriesPath.empty()
+        ) {
+            return true;
+        }
+        if (impl_->partialEntriesFile == NULL) {
+            impl_->partialEntriesFile = fopen(
+                impl_->partialEntriesPath.c_str(),
+                (impl_->resuming ? "ab" : "wb")
+            );
+            if (impl_->partialEntriesFile == NULL) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "Unable to open '%s'",
+                    impl_->partialEntriesPath.c_str()
+                );
+                return false;
+            }
+        }
+        bool success = true;
+        for (auto entry = begin; entry != end; ++entry) {
+            if (
+                fprintf(
+                    impl_->partialEntriesFile,
+                    "%" PRIdMAX "\t%" PRId64 "\t%s\n",
+                    entry->userid,
+                    entry->time,
+                    entry->name.c_str()
+                ) < 0
+            ) {
+                success = false;
+                break;
+            }
+        }
+        if (
+            !success
+            || (fflush(impl_->partialEntriesFile) != 0)
+        ) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to write '%s'",
+                impl_->partialEntriesPath.c_str()
+            );
+            return false;
+        }
+        return true;
+    }
+
+    bool CrawlCheckpoint::Update(
+        const std::string& cursor,
+        size_t count,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        impl_->cursor = cursor;
+        impl_->count = count;
+        if (impl_->name.empty()) {
+            return true;
+        }
+        impl_->checkpoints.Set(
+            impl_->name,
+            std::to_string(count) + " " + cursor
+        );
+        return impl_->checkpoints.Save(diagnosticsSender);
+    }
+
+    bool CrawlCheckpoint::Finish(const SystemAbstractions::DiagnosticsSender& diagnosticsSender) {
+        if (impl_->name.empty()) {
+            return true;
+        }
+        impl_->ClosePartialEntriesFile();
+        if (!impl_->partialEntriesPath.empty()) {
+            (void)remove(impl_->partialEntriesPath.c_str());
+        }
+        impl_->checkpoints.Remove(impl_->name);
+        return impl_->checkpoints.Save(diagnosticsSender);
+    }
+
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+/**
+ * @file CrawlCheckpoint.hpp
+ *
+ * This module declares the Twarlock::CrawlCheckpoint class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Environment.hpp"
+#include "Snapshot.hpp"
+
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <vector>
+
+namespace Twarlock {
+
+    /**
+     * This keeps track of how far a command has progressed through
+     * downloading every page of a list, so that if the command is
+     * interrupted, it can be run again with --resume to continue from
+     * where it stopped, rather than starting over.
+     *
+     * The cursor of the next page to download, and the number of
+     * things listed so far, are kept in the checkpoints file given by
+     * the "checkpoints" configuration item.  If a snapshot is being
+     * saved, the entries collected for it so far are kept in a file
+     * next to the snapshot, with ".partial" added to its name.
+     *
+     * Results are written out before the checkpoint is updated, so
+     * if the program is killed in between, the results of the last
+     * page may be written again when the command is resumed, but none
+     * are lost.
+     */
+    class CrawlCheckpoint {
+        // Lifecycle Methods
+    public:
+        ~CrawlCheckpoint() noexcept;
+        CrawlCheckpoint(const CrawlCheckpoint&) = delete;
+        CrawlCheckpoint(CrawlCheckpoint&&) noexcept;
+        CrawlCheckpoint& operator=(const CrawlCheckpoint&) = delete;
+        CrawlCheckpoint& operator=(CrawlCheckpoint&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.
+         */
+        CrawlCheckpoint();
+
+        /**
+         * This method sets up the checkpoint for the given crawl,
+         * loading where it left off if it's being resumed.
+         *
+         * @param[in] environment
+         *     This holds the configuration of the program and the
+         *     command-line options given.
+         *
+         * @param[in] name
+         *     This uniquely identifies the crawl, such as
+         *     "followers/12345".
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the checkpoint was set up
+         *     is returned.
+         */
+        bool Open(
+            const Environment& environment,
+            const std::string& name,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        );
+
+        /**
+         * This method returns an indication of whether or not the crawl
+         * is continuing from where an earlier one stopped.
+         *
+         * @return
+         *     An indication of whether or not the crawl is continuing
+         *     from where an earlier one stopped is returned.
+         */
+        bool IsResuming() const;
+
+        /**
+         * This method returns the cursor of the next page to download,
+         * or an empty string if the crawl should start from the
+         * first page.
+         *
+         * @return
+         *     The cursor of the next page to download is returned.
+         */
+        const std::string& GetCursor() const;
+
+        /**
+         * This method returns the number of things listed so far.
+         *
+         * @return
+         *     The number of things listed so far is returned.
+         */
+        size_t GetCount() const;
+
+        /**
+         * This method loads the snapshot entries collected so far,
+         * if the crawl is being resumed.
+         *
+         * @param[out] entries
+         *     This is where to add the entries collected so far.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the entries were loaded
+         *     is returned.
+         */
+        bool LoadPartialEntries(
+            std::vector< Snapshot::Entry >& entries,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        );
+
+        /**
+         * This method records more snapshot entries collected.
+         * It should be called before Update.
+         *
+         * @param[in] begin
+         *     This points to the first entry to record.
+         *
+         * @param[in] end
+         *     This points just past the last entry to record.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the entries were recorded
+         *     is returned.
+         */
+        bool AppendPartialEntries(
+            std::vector< Snapshot::Entry >::const_iterator begin,
+            std::vector< Snapshot::Entry >::const_iterator end,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        );
+
+        /**
+         * This method records that every page before the one with the
+         * given cursor has been downloaded and its results written out.
+         *
+         * @param[in] cursor
+         *     This is the cursor of the next page to download.
+         *
+         * @param[in] count
+         *     This is the number of things listed so far.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the checkpoint was saved
+         *     is returned.
+         */
+        bool Update(
+            const std::string& cursor,
+            size_t count,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        );
+
+        /**
+         * This method removes the checkpoint, once the crawl
+         * has completed.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the checkpoint was removed
+         *     is returned.
+         */
+        bool Finish(const SystemAbstractions::DiagnosticsSender& diagnosticsSender);
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
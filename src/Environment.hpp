@@ -9,7 +9,9 @@
  */
 
 #include <Json/Value.hpp>
+#include <stdio.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace Twarlock {
@@ -35,6 +37,61 @@ namespace Twarlock {
          */
         std::string configurationFilePath;
 
+        /**
+         * This is the stream to which commands write their results,
+         * unless an output file path is given.
+         */
+        FILE* outputStream = stdout;
+
+        /**
+         * This is the path to the file to which commands which list
+         * things should write their results, or an empty string if
+         * results should be written to the standard output.
+         */
+        std::string outputFilePath;
+
+        /**
+         * This is the name of the format in which commands which list
+         * things should write their results, or an empty string if
+         * results should be written in the human-readable format.
+         */
+        std::string outputFormat;
+
+        /**
+         * These are the names and values of fields which commands which
+         * list things should add to the front of every record they write,
+         * in formats other than the human-readable format, such as to
+         * tell apart the results of the jobs of a batch.
+         */
+        std::vector< std::pair< std::string, std::string > > outputGroupFields;
+
+        /**
+         * This is the path to the file to which commands which download
+         * lists of users should save a snapshot of the list, or an empty
+         * string if no snapshot should be saved.
+         */
+        std::string snapshotFilePath;
+
+        /**
+         * This indicates whether or not commands which list events should
+         * keep running, listing new events as they happen.
+         */
+        bool follow = false;
+
+        /**
+         * This indicates whether or not commands which download every
+         * page of a list should continue from where they were last
+         * interrupted, rather than starting over.
+         */
+        bool resume = false;
+
+        /**
+         * This is the path of the socket on which a Twarlock server is
+         * listening, if the command should be executed by the server
+         * rather than by this program.
+         */
+        std::string serverSocketPath;
+
         /**
          * This holds configuration items which direct or modify
          * the behavior of the program.
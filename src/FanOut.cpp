@@ -0,0 +1,258 @@
+/**
+ * @file FanOut.cpp
+ *
+ * This module contains the implementation of the functions used by
+ * commands which can work on many channels at once.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "FanOut.hpp"
+#include "LoadFile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <inttypes.h>
+#include <mutex>
+#include <StringExtensions/StringExtensions.hpp>
+#include <thread>
+
+namespace {
+
+    /**
+     * This is the number of channels worked on at the same time, unless
+     * "maxConcurrentChannels" is set in the configuration.
+     */
+    constexpr size_t defaultMaxConcurrentChannels = 8;
+
+    /**
+     * This holds what happened when working on one channel.
+     */
+    struct ChannelResult {
+        std::string name;
+        intmax_t id = 0;
+
+        /**
+         * This indicates whether or not work on the channel was started.
+         * Channels aren't started if their IDs can't be found, or if the
+         * program is interrupted first.
+         */
+        bool started = false;
+
+        bool success = false;
+
+        /**
+         * This is the number of things found for the channel.
+         */
+        intmax_t total = 0;
+
+        /**
+         * This is how long, in seconds, it took to work on the channel.
+         */
+        double elapsed = 0.0;
+    };
+
+}
+
+namespace Twarlock {
+
+    bool AddChannelNames(
+        const std::string& arg,
+        std::vector< std::string >& channelNames,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        std::string list;
+        if (
+            !arg.empty()
+            && (arg[0] == '@')
+        ) {
+            if (
+                !LoadFile(
+                    arg.substr(1),
+                    "channel list",
+                    diagnosticsSender,
+                    list
+                )
+            ) {
+                return false;
+            }
+        } else {
+            list = arg;
+        }
+        std::string name;
+        for (const auto c: list) {
+            if (
+                (c == ',')
+                || (c == ' ')
+                || (c == '\t')
+                || (c == '\r')
+                || (c == '\n')
+            ) {
+                if (!name.empty()) {
+                    channelNames.push_back(std::move(name));
+                    name.clear();
+                }
+            } else {
+                name += c;
+            }
+        }
+        if (!name.empty()) {
+            channelNames.push_back(std::move(name));
+        }
+        return true;
+    }
+
+    bool FanOutChannels(
+        const Environment& environment,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown,
+        const std::vector< std::string >& channelNames,
+        std::initializer_list< std::string > fields,
+        const char* totalDescription,
+        Output& output,
+        ChannelWorker worker
+    ) {
+        const auto startTime = std::chrono::steady_clock::now();
+        const auto channelIds = twitch.GetUserIdsByNames(channelNames);
+        std::vector< ChannelResult > results(channelNames.size());
+        for (size_t i = 0; i < channelNames.size(); ++i) {
+            auto& result = results[i];
+            result.name = channelNames[i];
+            const auto channelIdsEntry = channelIds.find(result.name);
+            if (channelIdsEntry == channelIds.end()) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Could not get ID of user '%s'",
+                    result.name.c_str()
+                );
+            } else {
+                result.id = channelIdsEntry->second;
+            }
+        }
+        size_t maxConcurrentChannels = defaultMaxConcurrentChannels;
+        if (environment.configuration.Has("maxConcurrentChannels")) {
+            const int configuredMaxConcurrentChannels = environment.configuration["maxConcurrentChannels"];
+            if (configuredMaxConcurrentChannels > 0) {
+                maxConcurrentChannels = (size_t)configuredMaxConcurrentChannels;
+            }
+        }
+        output.SetGroupField("channel", "");
+        output.SetFields(fields);
+        std::mutex mutex;
+        size_t nextChannel = 0;
+        std::vector< std::thread > threads;
+        for (size_t i = 0; i < std::min(maxConcurrentChannels, results.size()); ++i) {
+            threads.emplace_back(
+                [&]{
+                    std::unique_lock< std::mutex > lock(mutex);
+                    while (
+                        !shutDown
+                        && (nextChannel < results.size())
+                    ) {
+                        auto& result = results[nextChannel++];
+                        if (result.id == 0) {
+                            continue;
+                        }
+                        lock.unlock();
+                        Output group;
+                        group.OpenGroup(output);
+                        group.SetGroupField("channel", result.name);
+                        group.SetFields(fields);
+                        group.WriteText("--------------------------------------------------\n");
+                        group.WriteText("Channel '%s':\n", result.name.c_str());
+                        const auto channelStartTime = std::chrono::steady_clock::now();
+                        const auto success = worker(
+                            result.name,
+                            result.id,
+                            group,
+                            result.total
+                        );
+                        const auto elapsed = std::chrono::duration< double >(
+                            std::chrono::steady_clock::now() - channelStartTime
+                        ).count();
+                        lock.lock();
+                        result.started = true;
+                        result.success = success;
+                        result.elapsed = elapsed;
+                        output.WriteGroup(group);
+                    }
+                }
+            );
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+
+        // Write the summary as text in the human-readable format,
+        // or as diagnostic messages otherwise, to keep it out of the
+        // records.
+        const auto writeSummaryLine = [&](const std::string& line){
+            if (output.GetFormat() == Output::Format::Human) {
+                output.WriteText("%s\n", line.c_str());
+            } else {
+                diagnosticsSender.SendDiagnosticInformationString(2, line);
+            }
+        };
+        size_t longestNameLength = 7;
+        for (const auto& result: results) {
+            longestNameLength = std::max(longestNameLength, result.name.length());
+        }
+        const auto nameWidth = (int)longestNameLength;
+        output.WriteText("--------------------------------------------------\n");
+        writeSummaryLine(
+            StringExtensions::sprintf(
+                "%-*s %12s %10s",
+                nameWidth, "Channel",
+                totalDescription,
+                "Seconds"
+            )
+        );
+        intmax_t grandTotal = 0;
+        size_t numSucceeded = 0;
+        for (const auto& result: results) {
+            if (result.started) {
+                writeSummaryLine(
+                    StringExtensions::sprintf(
+                        "%-*s %12" PRIdMAX " %10.3f%s",
+                        nameWidth, result.name.c_str(),
+                        result.total,
+                        result.elapsed,
+                        (result.success ? "" : "  (failed)")
+                    )
+                );
+                grandTotal += result.total;
+                if (result.success) {
+                    ++numSucceeded;
+                }
+            } else {
+                writeSummaryLine(
+                    StringExtensions::sprintf(
+                        "%-*s %12s %10s  (%s)",
+                        nameWidth, result.name.c_str(),
+                        "-",
+                        "-",
+                        ((result.id == 0) ? "not found" : "not started")
+                    )
+                );
+            }
+        }
+        writeSummaryLine(
+            StringExtensions::sprintf(
+                "%-*s %12" PRIdMAX " %10.3f  (%zu of %zu channels)",
+                nameWidth, "Total",
+                grandTotal,
+                std::chrono::duration< double >(
+                    std::chrono::steady_clock::now() - startTime
+                ).count(),
+                numSucceeded,
+                results.size()
+            )
+        );
+        return (
+            output.Flush(diagnosticsSender)
+            && (numSucceeded == results.size())
+        );
+    }
+
+}
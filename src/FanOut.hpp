@@ -0,0 +1,136 @@
+#pragma once
+
+/**
+ * @file FanOut.hpp
+ *
+ * This module declares the functions used by commands which can work
+ * on many channels at once.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Environment.hpp"
+#include "Output.hpp"
+#include "Twitch.hpp"
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <vector>
+
+namespace Twarlock {
+
+    /**
+     * This is the type of function called to do the work of a command
+     * for one channel.
+     *
+     * @param[in] channelName
+     *     This is the name of the channel.
+     *
+     * @param[in] channelId
+     *     This is the ID of the channel.
+     *
+     * @param[in,out] output
+     *     This is where to write the results for the channel.
+     *
+     * @param[out] total
+     *     This is where to store the number of things found
+     *     for the channel.
+     *
+     * @return
+     *     An indication of whether or not the work succeeded is returned.
+     */
+    using ChannelWorker = std::function<
+        bool(
+            const std::string& channelName,
+            intmax_t channelId,
+            Output& output,
+            intmax_t& total
+        )
+    >;
+
+    /**
+     * This function adds to the given list the names of the channels
+     * given in the given argument.  The argument may be a single name,
+     * several names separated by commas, or '@' followed by the path
+     * of a file holding names separated by whitespace or commas.
+     *
+     * @param[in] arg
+     *     This is the argument giving the names of the channels.
+     *
+     * @param[in,out] channelNames
+     *     This is the list to which to add the names of the channels.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @return
+     *     An indication of whether or not the names were read is returned.
+     */
+    bool AddChannelNames(
+        const std::string& arg,
+        std::vector< std::string >& channelNames,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    );
+
+    /**
+     * This function does the work of a command for each of the given
+     * channels, working on up to "maxConcurrentChannels" (from the
+     * configuration) channels at once.  All the channels share the same
+     * Twitch instance, and so the same rate limit.
+     *
+     * The results for each channel are collected and written as a group
+     * once the channel is done, preceded by a heading in the
+     * human-readable format, or with a "channel" field added to every
+     * record in other formats.  A summary of the number of things found
+     * for each channel, and how long each one took, is written at the end.
+     *
+     * @param[in] environment
+     *     This holds the configuration of the program.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in,out] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] shutDown
+     *     This is set if the program is interrupted, in which case
+     *     no more channels are started.
+     *
+     * @param[in] channelNames
+     *     These are the names of the channels on which to work.
+     *
+     * @param[in] fields
+     *     These are the names of the fields of the records written
+     *     by the worker.
+     *
+     * @param[in] totalDescription
+     *     This describes the things counted in the summary, such as
+     *     "followers".
+     *
+     * @param[in,out] output
+     *     This is where to write the results.
+     *
+     * @param[in] worker
+     *     This is the function to call to do the work for one channel.
+     *
+     * @return
+     *     An indication of whether or not the work succeeded for every
+     *     channel is returned.
+     */
+    bool FanOutChannels(
+        const Environment& environment,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown,
+        const std::vector< std::string >& channelNames,
+        std::initializer_list< std::string > fields,
+        const char* totalDescription,
+        Output& output,
+        ChannelWorker worker
+    );
+
+}
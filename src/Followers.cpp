@@ -7,79 +7,278 @@
  */
 
 #include "Commands.hpp"
+#include "CrawlCheckpoint.hpp"
 #include "Environment.hpp"
+#include "FanOut.hpp"
+#include "Output.hpp"
+#include "Paginator.hpp"
+#include "Snapshot.hpp"
 
-#include <future>
 #include <inttypes.h>
 #include <StringExtensions/StringExtensions.hpp>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <time.h>
+#include <vector>
 
 using namespace Twarlock;
 
 namespace {
 
+    /**
+     * This function downloads the follower list of one channel.
+     *
+     * @param[in,out] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] userid
+     *     This is the ID of the channel.
+     *
+     * @param[in,out] output
+     *     This is where to write the followers.
+     *
+     * @param[in,out] checkpoint
+     *     This is used to start from where an earlier download was
+     *     interrupted, and to record progress after each page.
+     *
+     * @param[in,out] snapshot
+     *     If not null, this is where to add the followers.
+     *
+     * @param[out] total
+     *     This is where to store the total number of followers,
+     *     as reported by Twitch.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in] shutDown
+     *     This is set if the program is interrupted, in which case
+     *     no more pages are downloaded.
+     *
+     * @return
+     *     An indication of whether or not the follower list was
+     *     downloaded is returned.
+     */
+    bool DownloadFollowers(
+        Twitch& twitch,
+        intmax_t userid,
+        Output& output,
+        CrawlCheckpoint& checkpoint,
+        Snapshot* snapshot,
+        intmax_t& total,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        const std::atomic< bool >& shutDown
+    ) {
+        Paginator paginator(
+            twitch,
+            Twitch::Api::Helix,
+            StringExtensions::sprintf(
+                "users/follows?to_id=%" PRIdMAX "&first=100",
+                userid
+            ),
+            {"followed_at", "from_name", "from_id"},
+            Twitch::Priority::Bulk,
+            checkpoint.GetCursor()
+        );
+        auto numListed = checkpoint.GetCount();
+        ListPage page;
+        while (
+            !shutDown
+            && paginator.NextPage(page)
+        ) {
+            total = page.total;
+            const auto numEntriesBefore = (
+                (snapshot == nullptr)
+                ? 0
+                : snapshot->entries.size()
+            );
+            for (size_t i = 0; i < page.GetSize(); ++i) {
+                const auto& followedAt = page.Get(i, 0);
+                const auto& fromName = page.Get(i, 1);
+                const auto& fromId = page.Get(i, 2);
+                output.WriteRecord(
+                    "%s - %s",
+                    {
+                        followedAt,
+                        fromName,
+                    }
+                );
+                if (snapshot != nullptr) {
+                    Snapshot::Entry entry;
+                    (void)sscanf(fromId.c_str(), "%" SCNdMAX, &entry.userid);
+                    entry.name = fromName;
+                    entry.time = Snapshot::ParseTime(followedAt);
+                    snapshot->entries.push_back(std::move(entry));
+                }
+            }
+            if (!output.Flush(diagnosticsSender)) {
+                return false;
+            }
+            numListed += page.GetSize();
+            if (page.cursor.empty()) {
+                continue;
+            }
+            if (
+                (snapshot != nullptr)
+                && !checkpoint.AppendPartialEntries(
+                    snapshot->entries.begin() + numEntriesBefore,
+                    snapshot->entries.end(),
+                    diagnosticsSender
+                )
+            ) {
+                return false;
+            }
+            if (!checkpoint.Update(page.cursor, numListed, diagnosticsSender)) {
+                return false;
+            }
+        }
+        return (
+            !shutDown
+            && !paginator.HasFailed()
+        );
+    }
+
     bool Followers(
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
-        if (environment.args.empty()) {
+        std::vector< std::string > channelNames;
+        for (const auto& arg: environment.args) {
+            if (!AddChannelNames(arg, channelNames, diagnosticsSender)) {
+                return false;
+            }
+        }
+        if (channelNames.empty()) {
             diagnosticsSender.SendDiagnosticInformationString(
                 SystemAbstractions::DiagnosticsSender::Levels::ERROR,
                 "user name expected"
             );
             return false;
         }
-        const auto userid = twitch.GetUserIdByName(environment.args[0]);
+        if (channelNames.size() > 1) {
+            if (
+                !environment.snapshotFilePath.empty()
+                || environment.resume
+            ) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "--snapshot and --resume can only be used with one user"
+                );
+                return false;
+            }
+            Output output;
+            if (!output.Open(environment, diagnosticsSender)) {
+                return false;
+            }
+            return FanOutChannels(
+                environment,
+                diagnosticsSender,
+                twitch,
+                shutDown,
+                channelNames,
+                {"followed_at", "from_name"},
+                "Followers",
+                output,
+                [&twitch, &diagnosticsSender, &shutDown](
+                    const std::string& channelName,
+                    intmax_t channelId,
+                    Output& output,
+                    intmax_t& total
+                ){
+                    CrawlCheckpoint checkpoint;
+                    return DownloadFollowers(
+                        twitch,
+                        channelId,
+                        output,
+                        checkpoint,
+                        nullptr,
+                        total,
+                        diagnosticsSender,
+                        shutDown
+                    );
+                }
+            );
+        }
+        const auto& channelName = channelNames[0];
+        const auto userid = twitch.GetUserIdByName(channelName);
         if (userid == 0) {
             return false;
         }
-        std::string cursor;
-        printf("--------------------------------------------------\n");
-        do {
-            const auto done = std::make_shared< std::promise< void > >();
-            auto uri = StringExtensions::sprintf(
-                "users/follows?to_id=%" PRIdMAX "&first=100",
-                userid
-            );
-            if (!cursor.empty()) {
-                uri += StringExtensions::sprintf(
-                    "&after=%s",
-                    cursor.c_str()
+        CrawlCheckpoint checkpoint;
+        if (
+            !checkpoint.Open(
+                environment,
+                StringExtensions::sprintf("followers/%" PRIdMAX, userid),
+                diagnosticsSender
+            )
+        ) {
+            return false;
+        }
+        Output output;
+        if (
+            !output.Open(
+                environment,
+                diagnosticsSender,
+                checkpoint.IsResuming()
+            )
+        ) {
+            return false;
+        }
+        output.SetFields({"followed_at", "from_name"});
+        if (!checkpoint.IsResuming()) {
+            output.WriteText("--------------------------------------------------\n");
+        }
+        Snapshot snapshot;
+        snapshot.kind = Snapshot::Kind::Followers;
+        snapshot.channelName = channelName;
+        snapshot.channelId = userid;
+        snapshot.time = (int64_t)::time(NULL);
+        snapshot.fullSyncTime = snapshot.time;
+        const auto saveSnapshot = !environment.snapshotFilePath.empty();
+        if (
+            saveSnapshot
+            && !checkpoint.LoadPartialEntries(snapshot.entries, diagnosticsSender)
+        ) {
+            return false;
+        }
+        intmax_t total = 0;
+        if (
+            !DownloadFollowers(
+                twitch,
+                userid,
+                output,
+                checkpoint,
+                (saveSnapshot ? &snapshot : nullptr),
+                total,
+                diagnosticsSender,
+                shutDown
+            )
+        ) {
+            if (shutDown) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Interrupted; run again with --resume to continue"
                 );
             }
-            twitch.PostApiCall(
-                Twitch::Api::Helix,
-                uri,
-                [&](Json::Value&& response){
-                    const intmax_t total = response["total"];
-                    cursor = response["pagination"]["cursor"];
-                    for (auto dataEntry: response["data"]) {
-                        const auto& follower = dataEntry.value();
-                        printf(
-                            "%s - %s\n",
-                            ((std::string)follower["followed_at"]).c_str(),
-                            ((std::string)follower["from_name"]).c_str()
-                        );
-                    }
-                    if (cursor.empty()) {
-                        printf("--------------------------------------------------\n");
-                        printf(
-                            "User '%s' has %" PRIdMAX " total followers.\n",
-                            environment.args[0].c_str(),
-                            total
-                        );
-                    }
-                    done->set_value();
-                },
-                [&](unsigned int statusCode){
-                    done->set_value();
-                }
-            );
-            done->get_future().get();
-        } while (!cursor.empty());
-        return true;
+            return false;
+        }
+        if (
+            saveSnapshot
+            && !snapshot.Save(environment.snapshotFilePath, diagnosticsSender)
+        ) {
+            return false;
+        }
+        if (!checkpoint.Finish(diagnosticsSender)) {
+            return false;
+        }
+        output.WriteText("--------------------------------------------------\n");
+        output.WriteText(
+            "User '%s' has %" PRIdMAX " total followers.\n",
+            channelName.c_str(),
+            total
+        );
+        return output.Flush(diagnosticsSender);
     };
 
     struct RegisterInfo {
@@ -87,11 +286,18 @@ namespace {
             Command command;
             command.cmdSummary = "Download follower list";
             command.cmdDetails = (
-                "Download complete follower list."
+                "Download complete follower list.  If 'checkpoints' is"
+                " configured, progress is remembered there, so that if the"
+                " download is interrupted, it can be continued with --resume."
+                "  If more than one user is given, their lists are downloaded"
+                " at the same time, up to 'maxConcurrentChannels' (from the"
+                " configuration) at once, and written one user at a time,"
+                " followed by a summary of each user's total and how long"
+                " it took."
             );
-            command.argSummary = "<USER>";
+            command.argSummary = "<USER>...";
             command.argDetails = {
-                {"USER", "Name of the user for which to download follower information"},
+                {"USER", "Name of the user for which to download follower information, several names separated by commas, or '@' followed by the path of a file listing names"},
             };
             command.execute = Followers;
             Commands::Add("followers", std::move(command));
@@ -0,0 +1,256 @@
+/**
+ * @file FollowersSync.cpp
+ *
+ * This module defines the Twarlock::FollowersSync command.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Commands.hpp"
+#include "Environment.hpp"
+#include "Output.hpp"
+#include "Paginator.hpp"
+#include "Snapshot.hpp"
+
+#include <inttypes.h>
+#include <map>
+#include <StringExtensions/StringExtensions.hpp>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <SystemAbstractions/File.hpp>
+#include <time.h>
+#include <unordered_set>
+
+using namespace Twarlock;
+
+namespace {
+
+    bool FollowersSync(
+        Environment& environment,
+        SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown
+    ) {
+        if (environment.args.empty()) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "user name expected"
+            );
+            return false;
+        }
+        if (environment.snapshotFilePath.empty()) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "snapshot file path expected (--snapshot)"
+            );
+            return false;
+        }
+        const auto userid = twitch.GetUserIdByName(environment.args[0]);
+        if (userid == 0) {
+            return false;
+        }
+
+        // Load the followers known from the last time the list was
+        // synchronized, if any.
+        Snapshot previous;
+        bool havePrevious = false;
+        if (SystemAbstractions::File(environment.snapshotFilePath).IsExisting()) {
+            if (!previous.Load(environment.snapshotFilePath, diagnosticsSender)) {
+                return false;
+            }
+            if (
+                (previous.kind != Snapshot::Kind::Followers)
+                || (previous.channelId != userid)
+            ) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "Snapshot '%s' is not of the followers of '%s'",
+                    environment.snapshotFilePath.c_str(),
+                    environment.args[0].c_str()
+                );
+                return false;
+            }
+            havePrevious = true;
+        }
+        std::map< intmax_t, Snapshot::Entry > followers;
+        for (auto& entry: previous.entries) {
+            const auto followerId = entry.userid;
+            followers[followerId] = std::move(entry);
+        }
+
+        // Decide whether to download the complete list, in order
+        // to notice followers who have unfollowed since the last time,
+        // or only the part of the list added since the last time.
+        const auto now = (int64_t)::time(NULL);
+        const auto fullSyncInterval = (int64_t)(
+            environment.configuration.Has("followersFullSyncInterval")
+            ? (intmax_t)environment.configuration["followersFullSyncInterval"]
+            : 0
+        );
+        const auto fullSync = (
+            !havePrevious
+            || (
+                (fullSyncInterval > 0)
+                && (now - previous.fullSyncTime >= fullSyncInterval)
+            )
+        );
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            1,
+            "Synchronizing %s follower list of '%s'",
+            (fullSync ? "complete" : "new part of"),
+            environment.args[0].c_str()
+        );
+
+        Output output;
+        if (
+            !output.Open(
+                environment,
+                diagnosticsSender
+            )
+        ) {
+            return false;
+        }
+        output.SetFields({"change", "followed_at", "from_name"});
+        output.WriteText("--------------------------------------------------\n");
+        Paginator paginator(
+            twitch,
+            Twitch::Api::Helix,
+            StringExtensions::sprintf(
+                "users/follows?to_id=%" PRIdMAX "&first=100",
+                userid
+            ),
+            {"followed_at", "from_name", "from_id"}
+        );
+        std::unordered_set< intmax_t > seenFollowerIds;
+        size_t newFollows = 0;
+        intmax_t total = 0;
+        ListPage page;
+        while (
+            !shutDown
+            && paginator.NextPage(page)
+        ) {
+            total = page.total;
+            bool reachedKnownFollower = false;
+            for (size_t i = 0; i < page.GetSize(); ++i) {
+                const auto& followedAt = page.Get(i, 0);
+                Snapshot::Entry entry;
+                if (sscanf(page.Get(i, 2).c_str(), "%" SCNdMAX, &entry.userid) != 1) {
+                    continue;
+                }
+                entry.name = page.Get(i, 1);
+                entry.time = Snapshot::ParseTime(followedAt);
+                (void)seenFollowerIds.insert(entry.userid);
+                const auto followersEntry = followers.find(entry.userid);
+                if (
+                    (followersEntry != followers.end())
+                    && (followersEntry->second.time == entry.time)
+                ) {
+                    // The list is ordered newest first, so once a follow
+                    // already known is reached, the rest are known too.
+                    if (!fullSync) {
+                        reachedKnownFollower = true;
+                        break;
+                    }
+                    followersEntry->second.name = entry.name;
+                    continue;
+                }
+                ++newFollows;
+                output.WriteRecord(
+                    "%s: %s - %s",
+                    {
+                        "follow",
+                        followedAt,
+                        entry.name,
+                    }
+                );
+                followers[entry.userid] = std::move(entry);
+            }
+            if (!output.Flush(diagnosticsSender)) {
+                return false;
+            }
+            if (reachedKnownFollower) {
+                paginator.Stop();
+            }
+        }
+        if (
+            shutDown
+            || paginator.HasFailed()
+        ) {
+            return false;
+        }
+
+        // After downloading the complete list, any followers known
+        // before who weren't in it have unfollowed.
+        size_t unfollows = 0;
+        if (fullSync) {
+            auto followersEntry = followers.begin();
+            while (followersEntry != followers.end()) {
+                if (seenFollowerIds.find(followersEntry->first) == seenFollowerIds.end()) {
+                    ++unfollows;
+                    output.WriteRecord(
+                        "%s: %s - %s",
+                        {
+                            "unfollow",
+                            Snapshot::FormatTime(followersEntry->second.time),
+                            followersEntry->second.name,
+                        }
+                    );
+                    followersEntry = followers.erase(followersEntry);
+                } else {
+                    ++followersEntry;
+                }
+            }
+            if (!output.Flush(diagnosticsSender)) {
+                return false;
+            }
+        }
+
+        Snapshot snapshot;
+        snapshot.kind = Snapshot::Kind::Followers;
+        snapshot.channelName = environment.args[0];
+        snapshot.channelId = userid;
+        snapshot.time = now;
+        snapshot.fullSyncTime = (fullSync ? now : previous.fullSyncTime);
+        snapshot.entries.reserve(followers.size());
+        for (auto& followersEntry: followers) {
+            snapshot.entries.push_back(std::move(followersEntry.second));
+        }
+        if (!snapshot.Save(environment.snapshotFilePath, diagnosticsSender)) {
+            return false;
+        }
+        output.WriteText("--------------------------------------------------\n");
+        output.WriteText(
+            "User '%s' has %zu new followers and %zu unfollows;"
+            " %zu followers known, %" PRIdMAX " total followers.\n",
+            environment.args[0].c_str(),
+            newFollows,
+            unfollows,
+            snapshot.entries.size(),
+            total
+        );
+        return output.Flush(diagnosticsSender);
+    };
+
+    struct RegisterInfo {
+        RegisterInfo() {
+            Command command;
+            command.cmdSummary = "Bring a follower list snapshot up to date";
+            command.cmdDetails = (
+                "Download only the part of a follower list added since"
+                " the snapshot given with --snapshot was saved, list the new"
+                " followers, and merge them into the snapshot.  If the"
+                " snapshot doesn't exist yet, or the configured"
+                " 'followersFullSyncInterval' (in seconds) has passed since"
+                " the complete list was last downloaded, the complete list"
+                " is downloaded instead, in order to also list and remove"
+                " followers who have unfollowed."
+            );
+            command.argSummary = "<USER>";
+            command.argDetails = {
+                {"USER", "Name of the user for which to synchronize follower information"},
+            };
+            command.execute = FollowersSync;
+            Commands::Add("followers-sync", std::move(command));
+        }
+    } registerInfo;
+
+}
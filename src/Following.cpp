@@ -8,131 +8,471 @@
 
 #include "Commands.hpp"
 #include "Environment.hpp"
+#include "ListPage.hpp"
+#include "Output.hpp"
 
 #include <future>
 #include <inttypes.h>
+#include <map>
 #include <string>
 #include <StringExtensions/StringExtensions.hpp>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 using namespace Twarlock;
 
 namespace {
 
-    bool Following(
-        Environment& environment,
-        SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+    /**
+     * This holds information about one user following another.
+     */
+    struct Follow {
+        std::string fromName;
+        std::string toName;
+        std::string followedAt;
+    };
+
+    /**
+     * This holds what has been downloaded so far of the list of users
+     * followed by one user.
+     */
+    struct FollowList {
+        /**
+         * This is the total number of users followed, as reported
+         * by Twitch.
+         */
+        intmax_t total = 0;
+
+        /**
+         * This is the cursor to use to get the next page of the list,
+         * or an empty string if the list is complete.
+         */
+        std::string cursor;
+
+        /**
+         * This indicates whether or not a page of the list could not
+         * be downloaded or decoded, in which case the list is incomplete.
+         */
+        bool failed = false;
+
+        /**
+         * This holds the users followed who are among the users
+         * being compared.
+         *
+         * The keys are the IDs of the users followed.
+         */
+        std::unordered_map< intmax_t, Follow > follows;
+    };
+
+    /**
+     * This function posts a request for the next page of the given
+     * list of users followed by the given user.
+     *
+     * @param[in] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] fromUserId
+     *     This is the ID of the user whose follows are to be listed.
+     *
+     * @param[in] userIds
+     *     These are the IDs of the users being compared.  Follows of any
+     *     other users are not kept.
+     *
+     * @param[in,out] followList
+     *     This is the list to which to add the page.
+     *
+     * @return
+     *     A future which becomes ready once the page has been added
+     *     to the list is returned.
+     */
+    std::future< void > PostFollowListPage(
         Twitch& twitch,
-        const bool& shutDown
+        intmax_t fromUserId,
+        const std::unordered_set< intmax_t >& userIds,
+        FollowList& followList
     ) {
-        if (environment.args.size() < 2) {
-            diagnosticsSender.SendDiagnosticInformationString(
-                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
-                "at least two user names expected"
-            );
-            return false;
-        }
-        if (environment.args.size() > 100) {
-            diagnosticsSender.SendDiagnosticInformationString(
-                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
-                "too many user names provided (100 maximum)"
+        const auto done = std::make_shared< std::promise< void > >();
+        auto uri = StringExtensions::sprintf(
+            "users/follows?from_id=%" PRIdMAX "&first=100",
+            fromUserId
+        );
+        if (!followList.cursor.empty()) {
+            uri += StringExtensions::sprintf(
+                "&after=%s",
+                followList.cursor.c_str()
             );
-            return false;
         }
-        std::unordered_set< std::string > namesOfUserIdsNeeded;
-        std::string uri = "users";
-        for (const auto& arg: environment.args) {
-            if (namesOfUserIdsNeeded.empty()) {
-                uri += '?';
-            } else {
-                uri += '&';
-            }
-            uri += "login=";
-            uri += arg;
-            (void)namesOfUserIdsNeeded.insert(arg);
-        }
-        std::unordered_map< std::string, intmax_t > userIdsByLogin;
-        auto done = std::make_shared< std::promise< void > >();
-        twitch.PostApiCall(
+        auto* followListPtr = &followList;
+        const auto* userIdsPtr = &userIds;
+        twitch.PostApiCallForBody(
             Twitch::Api::Helix,
             uri,
-            [&](Json::Value&& response){
-                const auto& data = response["data"];
-                for (size_t i = 0; i < data.GetSize(); ++i) {
-                    intmax_t userid;
-                    if (
-                        sscanf(
-                            ((std::string)data[i]["id"]).c_str(), "%" SCNdMAX,
-                            &userid
-                        ) == 1
-                    ) {
-                        const std::string login = data[i]["login"];
-                        userIdsByLogin[login] = userid;
-                        (void)namesOfUserIdsNeeded.erase(login);
-                    }
+            [done, followListPtr, userIdsPtr](const std::string& body){
+                if (
+                    !VisitListEntries(
+                        body,
+                        {"to_id", "from_name", "to_name", "followed_at"},
+                        [followListPtr, userIdsPtr](const std::vector< std::string >& values){
+                            intmax_t toUserId;
+                            if (
+                                (sscanf(values[0].c_str(), "%" SCNdMAX, &toUserId) == 1)
+                                && (userIdsPtr->find(toUserId) != userIdsPtr->end())
+                            ) {
+                                auto& entry = followListPtr->follows[toUserId];
+                                entry.fromName = values[1];
+                                entry.toName = values[2];
+                                entry.followedAt = values[3];
+                            }
+                        },
+                        followListPtr->cursor,
+                        followListPtr->total
+                    )
+                ) {
+                    followListPtr->cursor.clear();
+                    followListPtr->failed = true;
                 }
                 done->set_value();
             },
-            [&](unsigned int statusCode){
+            [done, followListPtr](unsigned int statusCode){
+                followListPtr->cursor.clear();
+                followListPtr->failed = true;
                 done->set_value();
-            }
+            },
+            Twitch::Priority::Bulk,
+            twitch.NewCaller()
         );
-        done->get_future().get();
-        for (const auto& name: namesOfUserIdsNeeded) {
-            diagnosticsSender.SendDiagnosticInformationFormatted(
-                SystemAbstractions::DiagnosticsSender::Levels::WARNING,
-                "Could not get ID of user '%s'",
-                name.c_str()
-            );
+        return done->get_future();
+    }
+
+    /**
+     * This function checks which of the given users follow each other
+     * by downloading the complete list of users followed by each user,
+     * and looking up each pair of users in these lists.
+     *
+     * The first page of each list is requested before deciding to use
+     * this approach, since the totals it carries are needed to choose
+     * between this approach and querying each pair of users directly.
+     *
+     * @param[in] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] userIdsByLogin
+     *     These are the users to compare.
+     *
+     * @param[in] userIds
+     *     These are the IDs of the users to compare.
+     *
+     * @param[in,out] followLists
+     *     These hold the first page of each user's follow list,
+     *     and are completed by this function.
+     *
+     * @param[in,out] output
+     *     This is where to write the follows found.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in] shutDown
+     *     This is set if the program is interrupted, in which case
+     *     no more pages are downloaded, and nothing is compared.
+     *
+     * @return
+     *     An indication of whether or not every follow list was
+     *     downloaded and compared is returned.
+     */
+    bool CompareFollowLists(
+        Twitch& twitch,
+        const std::map< std::string, intmax_t >& userIdsByLogin,
+        const std::unordered_set< intmax_t >& userIds,
+        std::map< intmax_t, FollowList >& followLists,
+        Output& output,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        const std::atomic< bool >& shutDown
+    ) {
+        for (;;) {
+            if (shutDown) {
+                return false;
+            }
+            std::vector< std::future< void > > pages;
+            for (auto& followListsEntry: followLists) {
+                if (!followListsEntry.second.cursor.empty()) {
+                    pages.push_back(
+                        PostFollowListPage(
+                            twitch,
+                            followListsEntry.first,
+                            userIds,
+                            followListsEntry.second
+                        )
+                    );
+                }
+            }
+            if (pages.empty()) {
+                break;
+            }
+            for (auto& page: pages) {
+                page.get();
+            }
         }
-        if (userIdsByLogin.size() < 2) {
-            diagnosticsSender.SendDiagnosticInformationString(
-                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
-                "at least two user IDs needed to compare followers"
-            );
+        bool anyFailed = false;
+        for (const auto& userIdsByLoginEntry: userIdsByLogin) {
+            if (followLists[userIdsByLoginEntry.second].failed) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "Could not download the users followed by '%s'",
+                    userIdsByLoginEntry.first.c_str()
+                );
+                anyFailed = true;
+            }
+        }
+        if (anyFailed) {
             return false;
         }
-        printf("--------------------------------------------------\n");
         for (const auto& userIdsByLoginEntry: userIdsByLogin) {
-            const auto& toName = userIdsByLoginEntry.first;
             const auto toUserId = userIdsByLoginEntry.second;
             for (const auto& userIdsByLoginEntry: userIdsByLogin) {
-                const auto& fromName = userIdsByLoginEntry.first;
                 const auto fromUserId = userIdsByLoginEntry.second;
                 if (toUserId == fromUserId) {
                     continue;
                 }
+                const auto& follows = followLists[fromUserId].follows;
+                const auto followsEntry = follows.find(toUserId);
+                if (followsEntry != follows.end()) {
+                    const auto& follow = followsEntry->second;
+                    output.WriteRecord(
+                        "%s followed %s at %s",
+                        {
+                            follow.fromName,
+                            follow.toName,
+                            follow.followedAt,
+                        }
+                    );
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * This function checks which of the given users follow each other
+     * by querying Twitch once for each ordered pair of users.
+     *
+     * @param[in] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] userIdsByLogin
+     *     These are the users to compare.
+     *
+     * @param[in,out] output
+     *     This is where to write the follows found.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in] shutDown
+     *     This is set if the program is interrupted, in which case
+     *     no more pairs are compared.
+     *
+     * @return
+     *     An indication of whether or not every pair of users was
+     *     compared is returned.
+     */
+    bool ComparePairs(
+        Twitch& twitch,
+        const std::map< std::string, intmax_t >& userIdsByLogin,
+        Output& output,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        const std::atomic< bool >& shutDown
+    ) {
+        size_t numFailed = 0;
+        const auto caller = twitch.NewCaller();
+        for (const auto& userIdsByLoginEntry: userIdsByLogin) {
+            const auto toUserId = userIdsByLoginEntry.second;
+            for (const auto& userIdsByLoginEntry: userIdsByLogin) {
+                const auto fromUserId = userIdsByLoginEntry.second;
+                if (toUserId == fromUserId) {
+                    continue;
+                }
+                if (shutDown) {
+                    (void)output.Flush(diagnosticsSender);
+                    return false;
+                }
                 const auto done = std::make_shared< std::promise< void > >();
                 const auto uri = StringExtensions::sprintf(
                     "users/follows?to_id=%" PRIdMAX "&from_id=%" PRIdMAX,
                     toUserId, fromUserId
                 );
-                twitch.PostApiCall(
+                twitch.PostApiCallForBody(
                     Twitch::Api::Helix,
                     uri,
-                    [&](Json::Value&& response){
-                        for (auto dataEntry: response["data"]) {
-                            const auto& follower = dataEntry.value();
-                            printf(
-                                "%s followed %s at %s\n",
-                                ((std::string)follower["from_name"]).c_str(),
-                                ((std::string)follower["to_name"]).c_str(),
-                                ((std::string)follower["followed_at"]).c_str()
-                            );
+                    [&](const std::string& body){
+                        std::string cursor;
+                        intmax_t total;
+                        if (
+                            !VisitListEntries(
+                                body,
+                                {"from_name", "to_name", "followed_at"},
+                                [&](const std::vector< std::string >& values){
+                                    output.WriteRecord(
+                                        "%s followed %s at %s",
+                                        {values[0], values[1], values[2]}
+                                    );
+                                },
+                                cursor,
+                                total
+                            )
+                        ) {
+                            ++numFailed;
                         }
                         done->set_value();
                     },
                     [&](unsigned int statusCode){
+                        ++numFailed;
                         done->set_value();
-                    }
+                    },
+                    Twitch::Priority::Normal,
+                    caller
                 );
                 done->get_future().get();
             }
         }
-        printf("--------------------------------------------------\n");
+        if (!output.Flush(diagnosticsSender)) {
+            return false;
+        }
+        if (numFailed > 0) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Could not compare %zu pairs of users",
+                numFailed
+            );
+            return false;
+        }
         return true;
+    }
+
+    bool Following(
+        Environment& environment,
+        SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown
+    ) {
+        if (environment.args.size() < 2) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "at least two user names expected"
+            );
+            return false;
+        }
+        if (environment.args.size() > 100) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "too many user names provided (100 maximum)"
+            );
+            return false;
+        }
+        const auto userIdsByLogin = twitch.GetUserIdsByNames(environment.args);
+        for (const auto& name: environment.args) {
+            if (userIdsByLogin.find(name) == userIdsByLogin.end()) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Could not get ID of user '%s'",
+                    name.c_str()
+                );
+            }
+        }
+        if (userIdsByLogin.size() < 2) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "at least two user IDs needed to compare followers"
+            );
+            return false;
+        }
+        Output output;
+        if (
+            !output.Open(
+                environment,
+                diagnosticsSender
+            )
+        ) {
+            return false;
+        }
+        output.SetFields({"from_name", "to_name", "followed_at"});
+        std::unordered_set< intmax_t > userIds;
+        for (const auto& userIdsByLoginEntry: userIdsByLogin) {
+            (void)userIds.insert(userIdsByLoginEntry.second);
+        }
+        std::map< intmax_t, FollowList > followLists;
+        std::vector< std::future< void > > firstPages;
+        for (const auto userid: userIds) {
+            firstPages.push_back(
+                PostFollowListPage(
+                    twitch,
+                    userid,
+                    userIds,
+                    followLists[userid]
+                )
+            );
+        }
+        for (auto& firstPage: firstPages) {
+            firstPage.get();
+        }
+        bool anyFirstPageFailed = false;
+        size_t followListCalls = 0;
+        for (const auto& followListsEntry: followLists) {
+            const auto& followList = followListsEntry.second;
+            if (followList.failed) {
+                anyFirstPageFailed = true;
+            }
+            if (
+                !followList.cursor.empty()
+                && (followList.total > 100)
+            ) {
+                followListCalls += (size_t)((followList.total - 1) / 100);
+            }
+        }
+        const auto pairCalls = userIds.size() * (userIds.size() - 1);
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            1,
+            "Comparing follow lists would take %zu more API calls; comparing pairs would take %zu",
+            followListCalls,
+            pairCalls
+        );
+        output.WriteText("--------------------------------------------------\n");
+        bool success;
+        if (
+            !anyFirstPageFailed
+            && (followListCalls <= pairCalls)
+        ) {
+            success = CompareFollowLists(
+                twitch,
+                userIdsByLogin,
+                userIds,
+                followLists,
+                output,
+                diagnosticsSender,
+                shutDown
+            );
+        } else {
+            if (anyFirstPageFailed) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    1,
+                    "Could not download every follow list; comparing pairs instead"
+                );
+            }
+            success = ComparePairs(
+                twitch,
+                userIdsByLogin,
+                output,
+                diagnosticsSender,
+                shutDown
+            );
+        }
+        output.WriteText("--------------------------------------------------\n");
+        return (
+            output.Flush(diagnosticsSender)
+            && success
+        );
     };
 
     struct RegisterInfo {
@@ -22,7 +22,7 @@ namespace {
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
         if (environment.args.empty()) {
             diagnosticsSender.SendDiagnosticInformationString(
@@ -35,7 +35,8 @@ namespace {
         if (userid == 0) {
             return false;
         }
-        printf(
+        fprintf(
+            environment.outputStream,
             "User '%s' has id: %" PRIdMAX "\n",
             environment.args[0].c_str(),
             userid
@@ -50,7 +51,8 @@ namespace {
             [&](Json::Value&& response){
                 const intmax_t views = response["views"];
                 const intmax_t followers = response["followers"];
-                printf(
+                fprintf(
+                    environment.outputStream,
                     "Channel '%s' has %" PRIdMAX " followers and %" PRIdMAX " views.\n",
                     environment.args[0].c_str(),
                     followers,
@@ -0,0 +1,533 @@
+/**
+ * @file ListPage.cpp
+ *
+ * This module contains the implementation of the Twarlock::ListPage
+ * structure and the Twarlock::VisitListEntries function.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "ListPage.hpp"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+namespace {
+
+    /**
+     * This is the code point substituted for any surrogate escaped
+     * in a string which isn't part of a valid surrogate pair.
+     */
+    constexpr uint32_t replacementCharacter = 0xFFFD;
+
+    /**
+     * This is used to scan a JSON encoding one token at a time.
+     */
+    struct Scanner {
+        // Properties
+
+        /**
+         * This is the next character to scan.
+         */
+        const char* next;
+
+        /**
+         * This marks the end of the encoding.
+         */
+        const char* end;
+
+        // Methods
+
+        explicit Scanner(const std::string& encoding)
+            : next(encoding.data())
+            , end(encoding.data() + encoding.length())
+        {
+        }
+
+        void SkipWhitespace() {
+            while (
+                (next != end)
+                && (
+                    (*next == ' ')
+                    || (*next == '\t')
+                    || (*next == '\r')
+                    || (*next == '\n')
+                )
+            ) {
+                ++next;
+            }
+        }
+
+        /**
+         * This method consumes the given character, if it's next
+         * after any whitespace.
+         *
+         * @param[in] c
+         *     This is the character to consume.
+         *
+         * @return
+         *     An indication of whether or not the character was consumed
+         *     is returned.
+         */
+        bool Consume(char c) {
+            SkipWhitespace();
+            if (
+                (next == end)
+                || (*next != c)
+            ) {
+                return false;
+            }
+            ++next;
+            return true;
+        }
+
+        /**
+         * This method returns the next character after any whitespace,
+         * without consuming it.
+         *
+         * @return
+         *     The next character is returned, or a null character
+         *     if there are no more.
+         */
+        char Peek() {
+            SkipWhitespace();
+            return ((next == end) ? '\0' : *next);
+        }
+
+        static void AppendUtf8(
+            std::string& output,
+            uint32_t codePoint
+        ) {
+            if (codePoint < 0x80) {
+                output += (char)codePoint;
+            } else if (codePoint < 0x800) {
+                output += (char)(0xC0 | (codePoint >> 6));
+                output += (char)(0x80 | (codePoint & 0x3F));
+            } else if (codePoint < 0x10000) {
+                output += (char)(0xE0 | (codePoint >> 12));
+                output += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                output += (char)(0x80 | (codePoint & 0x3F));
+            } else {
+                output += (char)(0xF0 | (codePoint >> 18));
+                output += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+                output += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                output += (char)(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        bool ReadHex4(uint32_t& value) {
+            if (end - next < 4) {
+                return false;
+            }
+            value = 0;
+            for (size_t i = 0; i < 4; ++i) {
+                const auto c = *next++;
+                value <<= 4;
+                if ((c >= '0') && (c <= '9')) {
+                    value += (uint32_t)(c - '0');
+                } else if ((c >= 'a') && (c <= 'f')) {
+                    value += (uint32_t)(c - 'a' + 10);
+                } else if ((c >= 'A') && (c <= 'F')) {
+                    value += (uint32_t)(c - 'A' + 10);
+                } else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * This method scans a string.
+         *
+         * @param[out] output
+         *     If not null, this is where to store the decoded string.
+         *
+         * @return
+         *     An indication of whether or not a valid string was scanned
+         *     is returned.
+         */
+        bool ReadString(std::string* output) {
+            if (!Consume('"')) {
+                return false;
+            }
+            if (output != nullptr) {
+                output->clear();
+            }
+            while (next != end) {
+                // Copy runs of plain characters all at once.
+                const auto runStart = next;
+                while (
+                    (next != end)
+                    && (*next != '"')
+                    && (*next != '\\')
+                ) {
+                    ++next;
+                }
+                if (output != nullptr) {
+                    output->append(runStart, next);
+                }
+                if (next == end) {
+                    break;
+                }
+                if (*next++ == '"') {
+                    return true;
+                }
+                if (next == end) {
+                    break;
+                }
+                const auto escape = *next++;
+                char c = escape;
+                switch (escape) {
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    case '"':
+                    case '\\':
+                    case '/': break;
+
+                    case 'u': {
+                        uint32_t codePoint;
+                        if (!ReadHex4(codePoint)) {
+                            return false;
+                        }
+                        if (
+                            (codePoint >= 0xD800)
+                            && (codePoint < 0xDC00)
+                        ) {
+                            // A high surrogate is only combined with
+                            // a low surrogate escaped right after it.
+                            // Otherwise it's replaced, and whatever
+                            // follows it is scanned on its own.
+                            const auto afterHighSurrogate = next;
+                            uint32_t lowSurrogate = 0;
+                            if (
+                                (end - next >= 6)
+                                && (next[0] == '\\')
+                                && (next[1] == 'u')
+                            ) {
+                                next += 2;
+                                if (!ReadHex4(lowSurrogate)) {
+                                    return false;
+                                }
+                            }
+                            if (
+                                (lowSurrogate >= 0xDC00)
+                                && (lowSurrogate < 0xE000)
+                            ) {
+                                codePoint = (
+                                    0x10000
+                                    + ((codePoint - 0xD800) << 10)
+                                    + (lowSurrogate - 0xDC00)
+                                );
+                            } else {
+                                next = afterHighSurrogate;
+                                codePoint = replacementCharacter;
+                            }
+                        } else if (
+                            (codePoint >= 0xDC00)
+                            && (codePoint < 0xE000)
+                        ) {
+                            codePoint = replacementCharacter;
+                        }
+                        if (output != nullptr) {
+                            AppendUtf8(*output, codePoint);
+                        }
+                        continue;
+                    } break;
+
+                    default: {
+                        return false;
+                    } break;
+                }
+                if (output != nullptr) {
+                    *output += c;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * This method scans a number, true, false, or null.
+         *
+         * @param[out] output
+         *     If not null, this is where to store the value as it appears
+         *     in the encoding, or an empty string if it's null.
+         *
+         * @return
+         *     An indication of whether or not a value was scanned
+         *     is returned.
+         */
+        bool ReadLiteral(std::string* output) {
+            SkipWhitespace();
+            const auto start = next;
+            while (
+                (next != end)
+                && (
+                    ((*next >= '0') && (*next <= '9'))
+                    || ((*next >= 'a') && (*next <= 'z'))
+                    || (*next == '-')
+                    || (*next == '+')
+                    || (*next == '.')
+                    || (*next == 'E')
+                )
+            ) {
+                ++next;
+            }
+            if (next == start) {
+                return false;
+            }
+            if (output != nullptr) {
+                output->assign(start, next);
+                if (*output == "null") {
+                    output->clear();
+                }
+            }
+            return true;
+        }
+
+        /**
+         * This method scans any value, without keeping it.
+         *
+         * @return
+         *     An indication of whether or not a valid value was scanned
+         *     is returned.
+         */
+        bool SkipValue() {
+            switch (Peek()) {
+                case '"': {
+                    return ReadString(nullptr);
+                } break;
+
+                case '{': {
+                    return ReadObject(
+                        [this](const std::string&){
+                            return SkipValue();
+                        }
+                    );
+                } break;
+
+                case '[': {
+                    return ReadArray(
+                        [this]{
+                            return SkipValue();
+                        }
+                    );
+                } break;
+
+                default: {
+                    return ReadLiteral(nullptr);
+                } break;
+            }
+        }
+
+        /**
+         * This method scans an object, calling the given function
+         * to scan the value of each member.
+         *
+         * @param[in] onMember
+         *     This is called with the name of each member, to scan
+         *     its value.
+         *
+         * @return
+         *     An indication of whether or not a valid object was scanned
+         *     is returned.
+         */
+        bool ReadObject(const std::function< bool(const std::string& name) >& onMember) {
+            if (!Consume('{')) {
+                return false;
+            }
+            if (Consume('}')) {
+                return true;
+            }
+            std::string name;
+            do {
+                if (
+                    !ReadString(&name)
+                    || !Consume(':')
+                    || !onMember(name)
+                ) {
+                    return false;
+                }
+            } while (Consume(','));
+            return Consume('}');
+        }
+
+        /**
+         * This method scans an array, calling the given function
+         * to scan each element.
+         *
+         * @param[in] onElement
+         *     This is called to scan each element.
+         *
+         * @return
+         *     An indication of whether or not a valid array was scanned
+         *     is returned.
+         */
+        bool ReadArray(const std::function< bool() >& onElement) {
+            if (!Consume('[')) {
+                return false;
+            }
+            if (Consume(']')) {
+                return true;
+            }
+            do {
+                if (!onElement()) {
+                    return false;
+                }
+            } while (Consume(','));
+            return Consume(']');
+        }
+
+        /**
+         * This method scans a value which may hold requested fields.
+         *
+         * @param[in] path
+         *     This is the name of the value, relative to the element
+         *     of the list which holds it.
+         *
+         * @param[in] fields
+         *     These are the names of the requested fields.
+         *
+         * @param[out] values
+         *     This is where to store the values of requested fields.
+         *
+         * @return
+         *     An indication of whether or not a valid value was scanned
+         *     is returned.
+         */
+        bool ReadProjectedValue(
+            const std::string& path,
+            const std::vector< std::string >& fields,
+            std::vector< std::string >& values
+        ) {
+            for (size_t i = 0; i < fields.size(); ++i) {
+                if (fields[i] == path) {
+                    switch (Peek()) {
+                        case '"': {
+                            return ReadString(&values[i]);
+                        } break;
+
+                        case '{':
+                        case '[': {
+                            return SkipValue();
+                        } break;
+
+                        default: {
+                            return ReadLiteral(&values[i]);
+                        } break;
+                    }
+                }
+            }
+            if (Peek() == '{') {
+                const auto prefix = (path.empty() ? path : path + ".");
+                bool wanted = path.empty();
+                for (const auto& field: fields) {
+                    if (field.compare(0, prefix.length(), prefix) == 0) {
+                        wanted = true;
+                        break;
+                    }
+                }
+                if (wanted) {
+                    return ReadObject(
+                        [&](const std::string& name){
+                            return ReadProjectedValue(prefix + name, fields, values);
+                        }
+                    );
+                }
+            }
+            return SkipValue();
+        }
+    };
+
+}
+
+namespace Twarlock {
+
+    bool VisitListEntries(
+        const std::string& encoding,
+        const std::vector< std::string >& fields,
+        const std::function< void(const std::vector< std::string >& values) >& onEntry,
+        std::string& cursor,
+        intmax_t& total
+    ) {
+        cursor.clear();
+        total = 0;
+        Scanner scanner(encoding);
+        std::vector< std::string > values(fields.size());
+        return scanner.ReadObject(
+            [&](const std::string& name){
+                if (
+                    (name == "data")
+                    && (scanner.Peek() == '[')
+                ) {
+                    return scanner.ReadArray(
+                        [&]{
+                            for (auto& value: values) {
+                                value.clear();
+                            }
+                            if (!scanner.ReadProjectedValue("", fields, values)) {
+                                return false;
+                            }
+                            onEntry(values);
+                            return true;
+                        }
+                    );
+                } else if (
+                    (name == "pagination")
+                    && (scanner.Peek() == '{')
+                ) {
+                    return scanner.ReadObject(
+                        [&](const std::string& name){
+                            if (
+                                (name == "cursor")
+                                && (scanner.Peek() == '"')
+                            ) {
+                                return scanner.ReadString(&cursor);
+                            }
+                            return scanner.SkipValue();
+                        }
+                    );
+                } else if (name == "total") {
+                    std::string totalText;
+                    if (!scanner.ReadLiteral(&totalText)) {
+                        return false;
+                    }
+                    if (sscanf(totalText.c_str(), "%" SCNdMAX, &total) != 1) {
+                        total = 0;
+                    }
+                    return true;
+                } else {
+                    return scanner.SkipValue();
+                }
+            }
+        );
+    }
+
+    bool ListPage::Decode(const std::string& encoding) {
+        values.clear();
+        return VisitListEntries(
+            encoding,
+            fields,
+            [this](const std::vector< std::string >& entryValues){
+                values.insert(values.end(), entryValues.begin(), entryValues.end());
+            },
+            cursor,
+            total
+        );
+    }
+
+    size_t ListPage::GetSize() const {
+        return (
+            fields.empty()
+            ? 0
+            : values.size() / fields.size()
+        );
+    }
+
+    const std::string& ListPage::Get(size_t entry, size_t field) const {
+        return values[entry * fields.size() + field];
+    }
+
+}
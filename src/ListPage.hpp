@@ -0,0 +1,132 @@
+#pragma once
+
+/**
+ * @file ListPage.hpp
+ *
+ * This module declares the Twarlock::ListPage structure.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Twarlock {
+
+    /**
+     * This function scans the given encoding of a Twitch API response
+     * listing things, such as a page of followers, and visits the
+     * requested fields of each element of its "data" array, without
+     * building a tree of values for the whole response.
+     *
+     * @param[in] encoding
+     *     This is the JSON encoding of the response.
+     *
+     * @param[in] fields
+     *     These are the names of the fields to visit in each element.
+     *     Fields of objects nested in an element are named by joining
+     *     names with periods, as in "event_data.user_id".
+     *
+     * @param[in] onEntry
+     *     This is called for each element of the "data" array, with the
+     *     values of the requested fields, in the same order as the names
+     *     given.  String values are decoded; other values are given as
+     *     they appear in the encoding, except null values, which are
+     *     given as empty strings, as are missing fields.
+     *
+     * @param[out] cursor
+     *     This is where to store the "pagination.cursor" of the response,
+     *     or an empty string if it doesn't have one.
+     *
+     * @param[out] total
+     *     This is where to store the "total" of the response, or zero
+     *     if it doesn't have one.
+     *
+     * @return
+     *     An indication of whether or not the encoding was valid
+     *     is returned.
+     */
+    bool VisitListEntries(
+        const std::string& encoding,
+        const std::vector< std::string >& fields,
+        const std::function< void(const std::vector< std::string >& values) >& onEntry,
+        std::string& cursor,
+        intmax_t& total
+    );
+
+    /**
+     * This holds the requested fields of each element in one page of
+     * a Twitch API response listing things, as extracted by
+     * VisitListEntries.
+     */
+    struct ListPage {
+        // Properties
+
+        /**
+         * These are the names of the fields extracted from each element.
+         */
+        std::vector< std::string > fields;
+
+        /**
+         * These are the values of the fields of each element, one element
+         * after another, in the same order as the names of the fields.
+         */
+        std::vector< std::string > values;
+
+        /**
+         * This is the cursor to use to request the page after this one,
+         * or an empty string if this is the last page.
+         */
+        std::string cursor;
+
+        /**
+         * This is the total number of things in the whole list, if
+         * the response gave it, or zero if not.
+         */
+        intmax_t total = 0;
+
+        // Methods
+
+        /**
+         * This method replaces the contents of the page with those
+         * extracted from the given encoding of a Twitch API response.
+         *
+         * @param[in] encoding
+         *     This is the JSON encoding of the response.
+         *
+         * @return
+         *     An indication of whether or not the encoding was valid
+         *     is returned.
+         */
+        bool Decode(const std::string& encoding);
+
+        /**
+         * This method returns the number of elements in the page.
+         *
+         * @return
+         *     The number of elements in the page is returned.
+         */
+        size_t GetSize() const;
+
+        /**
+         * This method returns the value of the given field of the given
+         * element of the page.
+         *
+         * @param[in] entry
+         *     This is the index of the element.
+         *
+         * @param[in] field
+         *     This is the index of the field, in the list of names
+         *     of the fields.
+         *
+         * @return
+         *     The value of the given field of the given element
+         *     is returned.
+         */
+        const std::string& Get(size_t entry, size_t field) const;
+    };
+
+}
@@ -0,0 +1,94 @@
+/**
+ * @file LoadSnapshot.cpp
+ *
+ * This module defines the Twarlock::LoadSnapshot command.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Commands.hpp"
+#include "Environment.hpp"
+#include "Output.hpp"
+#include "Snapshot.hpp"
+
+#include <inttypes.h>
+#include <StringExtensions/StringExtensions.hpp>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+
+using namespace Twarlock;
+
+namespace {
+
+    bool LoadSnapshot(
+        Environment& environment,
+        SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown
+    ) {
+        if (environment.args.empty()) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "snapshot file path expected"
+            );
+            return false;
+        }
+        Snapshot snapshot;
+        if (!snapshot.Load(environment.args[0], diagnosticsSender)) {
+            return false;
+        }
+        Output output;
+        if (
+            !output.Open(
+                environment,
+                diagnosticsSender
+            )
+        ) {
+            return false;
+        }
+        const auto isFollowers = (snapshot.kind == Snapshot::Kind::Followers);
+        output.SetFields({
+            "user_name",
+            "user_id",
+            (isFollowers ? "followed_at" : "expires_at"),
+        });
+        output.WriteText(
+            "%s of channel '%s' (%" PRIdMAX ") as of %s\n",
+            (isFollowers ? "Followers" : "Bans"),
+            snapshot.channelName.c_str(),
+            snapshot.channelId,
+            Snapshot::FormatTime(snapshot.time).c_str()
+        );
+        output.WriteText("--------------------------------------------------\n");
+        for (const auto& entry: snapshot.entries) {
+            output.WriteRecord(
+                "%s (%s) %s",
+                {
+                    entry.name,
+                    StringExtensions::sprintf("%" PRIdMAX, entry.userid),
+                    Snapshot::FormatTime(entry.time),
+                }
+            );
+        }
+        output.WriteText("--------------------------------------------------\n");
+        output.WriteText("%zu total entries.\n", snapshot.entries.size());
+        return output.Flush(diagnosticsSender);
+    };
+
+    struct RegisterInfo {
+        RegisterInfo() {
+            Command command;
+            command.cmdSummary = "List the contents of a snapshot";
+            command.cmdDetails = (
+                "Load a snapshot saved by the followers or bans command,"
+                " and list the users in it."
+            );
+            command.argSummary = "<SNAPSHOT>";
+            command.argDetails = {
+                {"SNAPSHOT", "Path to the snapshot file to load"},
+            };
+            command.execute = LoadSnapshot;
+            Commands::Add("snapshot", std::move(command));
+        }
+    } registerInfo;
+
+}
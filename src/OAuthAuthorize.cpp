@@ -22,7 +22,7 @@ namespace {
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
         if (environment.args.size() < 1) {
             diagnosticsSender.SendDiagnosticInformationString(
@@ -55,7 +55,7 @@ namespace {
             Twitch::Api::RawGet,
             url,
             [&](Json::Value&& response){
-                printf("%s\n", response.ToEncoding().c_str());
+                fprintf(environment.outputStream, "%s\n", response.ToEncoding().c_str());
                 done->set_value();
             },
             [&](unsigned int statusCode){
@@ -22,7 +22,7 @@ namespace {
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
         const auto done = std::make_shared< std::promise< void > >();
         twitch.PostApiCall(
@@ -33,11 +33,11 @@ namespace {
                 ((std::string)environment.configuration["oauthToken"]).c_str()
             ),
             [&](Json::Value&& response){
-                printf("OAuth token revoked.\n");
+                fprintf(environment.outputStream, "OAuth token revoked.\n");
                 done->set_value();
             },
             [&](unsigned int statusCode){
-                printf("OAuth token invalid.\n");
+                fprintf(environment.outputStream, "OAuth token invalid.\n");
                 done->set_value();
             }
         );
@@ -22,7 +22,7 @@ namespace {
         Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender,
         Twitch& twitch,
-        const bool& shutDown
+        const std::atomic< bool >& shutDown
     ) {
         const auto done = std::make_shared< std::promise< void > >();
         twitch.PostApiCall(
@@ -30,14 +30,14 @@ namespace {
             "validate",
             [&](Json::Value&& response){
                 const std::string login = response["login"];
-                printf("Login: %s\n", login.c_str());
+                fprintf(environment.outputStream, "Login: %s\n", login.c_str());
                 const intmax_t expiresIn = response["expires_in"];
-                printf("Expires in: %" PRIdMAX "\n", expiresIn);
+                fprintf(environment.outputStream, "Expires in: %" PRIdMAX "\n", expiresIn);
                 const auto& scopes = response["scopes"];
-                printf("Scopes:\n");
+                fprintf(environment.outputStream, "Scopes:\n");
                 for (size_t i = 0; i < scopes.GetSize(); ++i) {
                     const std::string scope = scopes[i];
-                    printf("  %s\n", scope.c_str());
+                    fprintf(environment.outputStream, "  %s\n", scope.c_str());
                 }
                 done->set_value();
             },
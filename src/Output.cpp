@@ -0,0 +1,548 @@
+/**
+ * @file Output.cpp
+ *
+ * This module contains the implementation of the Twarlock::Output class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Output.hpp"
+
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+#include <StringExtensions/StringExtensions.hpp>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the number of bytes of results to collect before
+     * they're written out.
+     */
+    constexpr size_t outputBufferSize = 1024 * 1024;
+
+    /**
+     * This function appends the given value to the given buffer,
+     * encoded as a JSON string.
+     *
+     * @param[in,out] buffer
+     *     This is the buffer to which to append the value.
+     *
+     * @param[in] value
+     *     This is the value to append.
+     */
+    void AppendJsonString(
+        std::string& buffer,
+        const std::string& value
+    ) {
+        buffer += '"';
+        for (const auto c: value) {
+            switch (c) {
+                case '"': {
+                    buffer += "\\\"";
+                } break;
+
+                case '\\': {
+                    buffer += "\\\\";
+                } break;
+
+                case '\n': {
+                    buffer += "\\n";
+                } break;
+
+                case '\r': {
+                    buffer += "\\r";
+                } break;
+
+                case '\t': {
+                    buffer += "\\t";
+                } break;
+
+                default: {
+                    if ((unsigned char)c < 0x20) {
+                        buffer += StringExtensions::sprintf("\\u%04x", (unsigned int)c);
+                    } else {
+                        buffer += c;
+                    }
+                } break;
+            }
+        }
+        buffer += '"';
+    }
+
+    /**
+     * This function appends the given value to the given buffer,
+     * as a field of a line of comma-separated values.
+     *
+     * @param[in,out] buffer
+     *     This is the buffer to which to append the value.
+     *
+     * @param[in] value
+     *     This is the value to append.
+     */
+    void AppendCsvField(
+        std::string& buffer,
+        const std::string& value
+    ) {
+        if (value.find_first_of(",\"\r\n") == std::string::npos) {
+            buffer += value;
+            return;
+        }
+        buffer += '"';
+        for (const auto c: value) {
+            if (c == '"') {
+                buffer += '"';
+            }
+            buffer += c;
+        }
+        buffer += '"';
+    }
+
+    /**
+     * This function appends the given value to the given buffer,
+     * as a field of a line of tab-separated values.  Any tabs or line
+     * breaks in the value are replaced by spaces.
+     *
+     * @param[in,out] buffer
+     *     This is the buffer to which to append the value.
+     *
+     * @param[in] value
+     *     This is the value to append.
+     */
+    void AppendTsvField(
+        std::string& buffer,
+        const std::string& value
+    ) {
+        for (const auto c: value) {
+            if (
+                (c == '\t')
+                || (c == '\r')
+                || (c == '\n')
+            ) {
+                buffer += ' ';
+            } else {
+                buffer += c;
+            }
+        }
+    }
+
+}
+
+namespace Twarlock {
+
+    /**
+     * This contains the private properties of a Output class instance.
+     */
+    struct Output::Impl {
+        // Properties
+
+        /**
+         * This holds results not yet written out.
+         */
+        std::string buffer;
+
+        /**
+         * These are the names of the fields of the records written.
+         */
+        std::vector< std::string > fields;
+
+        /**
+         * This is the file to which results are written.
+         */
+        FILE* file = stdout;
+
+        /**
+         * This indicates whether or not the file was opened by the output,
+         * and so should be closed when the output is destroyed.
+         */
+        bool ownsFile = false;
+
+        /**
+         * This indicates whether or not results are being added to
+         * the end of an existing file.
+         */
+        bool appending = false;
+
+        /**
+         * This indicates whether or not results are being collected
+         * to be written later as a group, rather than written out.
+         */
+        bool collecting = false;
+
+        /**
+         * These are the names and values of the fields added to the
+         * front of every record, in order.
+         */
+        std::vector< std::pair< std::string, std::string > > groupFields;
+
+        /**
+         * If results are being collected and more of them were collected
+         * than fit in the buffer, this is the temporary file to which
+         * the earlier ones were moved, so that they aren't all held
+         * in memory.
+         */
+        FILE* spillFile = NULL;
+
+        /**
+         * This is the number of bytes of results moved to the
+         * temporary file.
+         */
+        size_t spilledLength = 0;
+
+        /**
+         * This indicates whether or not the temporary file couldn't be
+         * made or written, in which case results being collected are
+         * kept in memory instead.
+         */
+        bool spillFailed = false;
+
+        /**
+         * This indicates whether or not any results could not be
+         * written out, such as when the disk is full.
+         */
+        bool failed = false;
+
+        Format format = Format::Human;
+
+        // Lifecycle
+
+        ~Impl() {
+            Flush();
+            if (ownsFile) {
+                (void)fclose(file);
+            }
+            if (spillFile != NULL) {
+                (void)fclose(spillFile);
+            }
+        }
+        Impl(const Impl&) = delete;
+        Impl(Impl&&) = delete;
+        Impl& operator=(const Impl&) = delete;
+        Impl& operator=(Impl&&) = delete;
+
+        // Methods
+
+        Impl() = default;
+
+        void Flush() {
+            if (
+                buffer.empty()
+                || collecting
+            ) {
+                return;
+            }
+            if (
+                (fwrite(buffer.data(), 1, buffer.length(), file) != buffer.length())
+                || (fflush(file) != 0)
+            ) {
+                failed = true;
+            }
+            buffer.clear();
+        }
+
+        /**
+         * This method moves the results being collected from the buffer
+         * to the temporary file, making the file first if necessary.
+         */
+        void Spill() {
+            if (spillFailed) {
+                return;
+            }
+            if (spillFile == NULL) {
+                spillFile = tmpfile();
+                if (spillFile == NULL) {
+                    spillFailed = true;
+                    return;
+                }
+            }
+            if (fwrite(buffer.data(), 1, buffer.length(), spillFile) != buffer.length()) {
+                spillFailed = true;
+                return;
+            }
+            spilledLength += buffer.length();
+            buffer.clear();
+        }
+
+        void FlushIfFull() {
+            if (buffer.length() < outputBufferSize) {
+                return;
+            }
+            if (collecting) {
+                Spill();
+            } else {
+                Flush();
+            }
+        }
+    };
+
+    Output::~Output() noexcept = default;
+    Output::Output(Output&&) noexcept = default;
+    Output& Output::operator=(Output&&) noexcept = default;
+
+    Output::Output()
+        : impl_(new Impl())
+    {
+        impl_->buffer.reserve(outputBufferSize);
+    }
+
+    bool Output::Open(
+        const Environment& environment,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        bool append
+    ) {
+        const auto& filePath = environment.outputFilePath;
+        const auto& formatName = environment.outputFormat;
+        if (
+            formatName.empty()
+            || (formatName == "human")
+        ) {
+            impl_->format = Format::Human;
+        } else if (formatName == "ndjson") {
+            impl_->format = Format::Ndjson;
+        } else if (formatName == "csv") {
+            impl_->format = Format::Csv;
+        } else if (formatName == "tsv") {
+            impl_->format = Format::Tsv;
+        } else {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unknown output format '%s'",
+                formatName.c_str()
+            );
+            return false;
+        }
+        if (!filePath.empty()) {
+            const auto file = fopen(filePath.c_str(), (append ? "ab" : "wb"));
+            if (file == NULL) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "Unable to open output file '%s'",
+                    filePath.c_str()
+                );
+                return false;
+            }
+            impl_->Flush();
+            if (impl_->ownsFile) {
+                (void)fclose(impl_->file);
+            }
+            impl_->file = file;
+            impl_->ownsFile = true;
+            impl_->appending = append;
+        } else {
+            impl_->Flush();
+            impl_->file = environment.outputStream;
+        }
+        for (const auto& groupField: environment.outputGroupFields) {
+            SetGroupField(groupField.first, groupField.second);
+        }
+        return true;
+    }
+
+    void Output::OpenGroup(const Output& output) {
+        impl_->format = output.impl_->format;
+        impl_->groupFields = output.impl_->groupFields;
+        impl_->appending = true;
+        impl_->collecting = true;
+    }
+
+    void Output::WriteGroup(Output& group) {
+        auto& groupImpl = *group.impl_;
+        if (groupImpl.spillFile != NULL) {
+            rewind(groupImpl.spillFile);
+            std::vector< char > chunk(outputBufferSize);
+            while (groupImpl.spilledLength > 0) {
+                const auto amount = fread(
+                    chunk.data(),
+                    1,
+                    std::min(chunk.size(), groupImpl.spilledLength),
+                    groupImpl.spillFile
+                );
+                if (amount == 0) {
+                    impl_->failed = true;
+                    break;
+                }
+                impl_->buffer.append(chunk.data(), amount);
+                groupImpl.spilledLength -= amount;
+                impl_->FlushIfFull();
+            }
+            (void)fclose(groupImpl.spillFile);
+            groupImpl.spillFile = NULL;
+            groupImpl.spilledLength = 0;
+        }
+        impl_->buffer += groupImpl.buffer;
+        groupImpl.buffer.clear();
+        impl_->Flush();
+    }
+
+    auto Output::GetFormat() const -> Format {
+        return impl_->format;
+    }
+
+    void Output::SetFields(std::initializer_list< std::string > fields) {
+        impl_->fields.clear();
+        for (const auto& groupField: impl_->groupFields) {
+            impl_->fields.push_back(groupField.first);
+        }
+        impl_->fields.insert(impl_->fields.end(), fields);
+        if (
+            impl_->appending
+            || (
+                (impl_->format != Format::Csv)
+                && (impl_->format != Format::Tsv)
+            )
+        ) {
+            return;
+        }
+        bool first = true;
+        for (const auto& field: impl_->fields) {
+            if (!first) {
+                impl_->buffer += ((impl_->format == Format::Csv) ? ',' : '\t');
+            }
+            first = false;
+            if (impl_->format == Format::Csv) {
+                AppendCsvField(impl_->buffer, field);
+            } else {
+                AppendTsvField(impl_->buffer, field);
+            }
+        }
+        impl_->buffer += '\n';
+    }
+
+    void Output::SetGroupField(
+        const std::string& field,
+        const std::string& value
+    ) {
+        if (impl_->format == Format::Human) {
+            return;
+        }
+        for (auto& groupField: impl_->groupFields) {
+            if (groupField.first == field) {
+                groupField.second = value;
+                return;
+            }
+        }
+        impl_->groupFields.emplace_back(field, value);
+    }
+
+    void Output::WriteRecord(
+        const char* humanFormat,
+        std::initializer_list< std::string > values
+    ) {
+        auto& buffer = impl_->buffer;
+        switch (impl_->format) {
+            case Format::Human: {
+                auto value = values.begin();
+                for (const char* c = humanFormat; *c != '\0'; ++c) {
+                    if (
+                        (c[0] == '%')
+                        && (c[1] == 's')
+                        && (value != values.end())
+                    ) {
+                        buffer += *value++;
+                        ++c;
+                    } else {
+                        buffer += *c;
+                    }
+                }
+                buffer += '\n';
+            } break;
+
+            case Format::Ndjson: {
+                buffer += '{';
+                size_t i = 0;
+                for (const auto& groupField: impl_->groupFields) {
+                    if (i > 0) {
+                        buffer += ',';
+                    }
+                    AppendJsonString(buffer, groupField.first);
+                    buffer += ':';
+                    AppendJsonString(buffer, groupField.second);
+                    ++i;
+                }
+                for (const auto& value: values) {
+                    if (i >= impl_->fields.size()) {
+                        break;
+                    }
+                    if (i > 0) {
+                        buffer += ',';
+                    }
+                    AppendJsonString(buffer, impl_->fields[i]);
+                    buffer += ':';
+                    AppendJsonString(buffer, value);
+                    ++i;
+                }
+                buffer += "}\n";
+            } break;
+
+            case Format::Csv:
+            case Format::Tsv: {
+                bool first = true;
+                for (const auto& groupField: impl_->groupFields) {
+                    if (!first) {
+                        buffer += ((impl_->format == Format::Csv) ? ',' : '\t');
+                    }
+                    first = false;
+                    if (impl_->format == Format::Csv) {
+                        AppendCsvField(buffer, groupField.second);
+                    } else {
+                        AppendTsvField(buffer, groupField.second);
+                    }
+                }
+                for (const auto& value: values) {
+                    if (!first) {
+                        buffer += ((impl_->format == Format::Csv) ? ',' : '\t');
+                    }
+                    first = false;
+                    if (impl_->format == Format::Csv) {
+                        AppendCsvField(buffer, value);
+                    } else {
+                        AppendTsvField(buffer, value);
+                    }
+                }
+                buffer += '\n';
+            } break;
+
+            default: {
+            } break;
+        }
+        impl_->FlushIfFull();
+    }
+
+    void Output::WriteText(const char* format, ...) {
+        if (impl_->format != Format::Human) {
+            return;
+        }
+        va_list args;
+        va_start(args, format);
+        char stackBuffer[256];
+        va_list argsCopy;
+        va_copy(argsCopy, args);
+        const auto length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, argsCopy);
+        va_end(argsCopy);
+        if (length >= 0) {
+            if ((size_t)length < sizeof(stackBuffer)) {
+                impl_->buffer.append(stackBuffer, (size_t)length);
+            } else {
+                std::vector< char > heapBuffer((size_t)length + 1);
+                (void)vsnprintf(heapBuffer.data(), heapBuffer.size(), format, args);
+                impl_->buffer.append(heapBuffer.data(), (size_t)length);
+            }
+        }
+        va_end(args);
+        impl_->FlushIfFull();
+    }
+
+    bool Output::Flush(const SystemAbstractions::DiagnosticsSender& diagnosticsSender) {
+        impl_->Flush();
+        if (impl_->failed) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to write output"
+            );
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+/**
+ * @file Output.hpp
+ *
+ * This module declares the Twarlock::Output class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Environment.hpp"
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <vector>
+
+namespace Twarlock {
+
+    /**
+     * This is used by commands which list things, such as followers
+     * or bans, to write their results.  Results are written either
+     * as human-readable text, or as records in a machine-readable
+     * format, and are buffered so that they're written in large
+     * chunks, rather than one line at a time.
+     */
+    class Output {
+        // Types
+    public:
+        /**
+         * These are the formats in which results may be written.
+         */
+        enum class Format {
+            /**
+             * Results are written as text for people to read, along
+             * with any headings and summaries.
+             */
+            Human,
+
+            /**
+             * Each record is written as a JSON object on its own line.
+             */
+            Ndjson,
+
+            /**
+             * Records are written as comma-separated values, with a
+             * header line giving the field names.
+             */
+            Csv,
+
+            /**
+             * Records are written as tab-separated values, with a
+             * header line giving the field names.
+             */
+            Tsv,
+        };
+
+        // Lifecycle Methods
+    public:
+        ~Output() noexcept;
+        Output(const Output&) = delete;
+        Output(Output&&) noexcept;
+        Output& operator=(const Output&) = delete;
+        Output& operator=(Output&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.
+         */
+        Output();
+
+        /**
+         * This method sets up where and how results are written.
+         *
+         * @param[in] environment
+         *     This holds the command-line options giving the path of the
+         *     file to which to write results, if any, and the name of
+         *     the format in which to write them: "human", "ndjson", "csv"
+         *     or "tsv".  If no file is given, results are written to the
+         *     environment's output stream.  If no format is given,
+         *     "human" is used.  Any group fields it holds are added
+         *     as if given to SetGroupField.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @param[in] append
+         *     This indicates whether or not to add results to the end
+         *     of the file, rather than replacing it.  The header line
+         *     of the CSV and TSV formats is not written again in this case.
+         *
+         * @return
+         *     An indication of whether or not the output was set up
+         *     is returned.
+         */
+        bool Open(
+            const Environment& environment,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+            bool append = false
+        );
+
+        /**
+         * This method sets up the output to collect results, rather than
+         * writing them out, so that they can be written later as a group
+         * to the given output using its WriteGroup method.  Results are
+         * collected in the same format and with the same group fields
+         * as the given output, without a header line.  Once more results are collected than fit in
+         * the buffer, they're moved to a temporary file, so that large
+         * groups aren't held in memory.
+         *
+         * @param[in] output
+         *     This is the output to which the results will be written.
+         */
+        void OpenGroup(const Output& output);
+
+        /**
+         * This method writes out all the results collected so far
+         * by the given group.
+         *
+         * @param[in,out] group
+         *     This is the output which collected the results,
+         *     set up using its OpenGroup method.
+         */
+        void WriteGroup(Output& group);
+
+        /**
+         * This method returns the format in which results are written.
+         *
+         * @return
+         *     The format in which results are written is returned.
+         */
+        Format GetFormat() const;
+
+        /**
+         * This method sets the names of the fields of the records
+         * to be written.  For the CSV and TSV formats, this writes
+         * the header line.
+         *
+         * @param[in] fields
+         *     These are the names of the fields of the records.
+         */
+        void SetFields(std::initializer_list< std::string > fields);
+
+        /**
+         * This method adds a field to the front of every record written
+         * afterwards, in formats other than the human-readable format,
+         * to tell apart records of different groups, such as channels.
+         * If the field was already added, its value is changed instead.
+         * It should be called before SetFields.
+         *
+         * @param[in] field
+         *     This is the name of the field to add.
+         *
+         * @param[in] value
+         *     This is the value of the field in every record.
+         */
+        void SetGroupField(
+            const std::string& field,
+            const std::string& value
+        );
+
+        /**
+         * This method writes one record.
+         *
+         * @param[in] humanFormat
+         *     This is the text to write in the human-readable format,
+         *     where each "%s" is replaced by the next field value.
+         *
+         * @param[in] values
+         *     These are the values of the fields of the record, in the
+         *     same order as the field names given to SetFields.
+         */
+        void WriteRecord(
+            const char* humanFormat,
+            std::initializer_list< std::string > values
+        );
+
+        /**
+         * This method writes formatted text, such as a heading or
+         * summary, only if results are written in the human-readable
+         * format.
+         *
+         * @param[in] format
+         *     This is the format string, as used by printf.
+         */
+        void WriteText(const char* format, ...);
+
+        /**
+         * This method writes out any buffered results.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not all results so far have
+         *     been written out is returned.  Once any results fail to be
+         *     written, such as when the disk is full, false is returned
+         *     from then on, so callers shouldn't record progress past
+         *     results which may not have been written.
+         */
+        bool Flush(const SystemAbstractions::DiagnosticsSender& diagnosticsSender);
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
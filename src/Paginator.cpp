@@ -0,0 +1,214 @@
+/**
+ * @file Paginator.cpp
+ *
+ * This module contains the implementation of the Twarlock::Paginator class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Paginator.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <StringExtensions/StringExtensions.hpp>
+
+namespace Twarlock {
+
+    /**
+     * This contains the private properties of a Paginator class instance.
+     */
+    struct Paginator::Impl {
+        // Properties
+
+        Twitch::Api api;
+
+        /**
+         * This identifies the paginator to Twitch, so that its pages
+         * don't wait for the results of anyone else's API calls.
+         */
+        size_t caller = 0;
+
+        /**
+         * This is the cursor to use to request the next page, or an empty
+         * string if the next page to request is the first one.
+         */
+        std::string cursor;
+
+        /**
+         * This indicates whether or not there are no more pages
+         * to request.
+         */
+        bool done = false;
+
+        /**
+         * This indicates whether or not an API call made to download
+         * a page failed.
+         */
+        bool failed = false;
+
+        /**
+         * These are the names of the fields to extract from each element
+         * of each page.
+         */
+        std::vector< std::string > fields;
+
+        std::mutex mutex;
+
+        /**
+         * This holds the bodies of the pages which have been downloaded
+         * but not yet decoded and returned by NextPage.
+         */
+        std::deque< std::string > bodies;
+
+        /**
+         * This is used to wake up the thread waiting for the next page.
+         */
+        std::condition_variable pagesChanged;
+
+        Twitch::Priority priority;
+
+        /**
+         * This indicates whether or not a page is being downloaded.
+         */
+        bool requestInProgress = false;
+
+        std::string resource;
+        std::weak_ptr< Impl > selfWeak;
+        Twitch* twitch;
+
+        // Methods
+
+        /**
+         * This method requests the next page, if there is one, unless
+         * a page is already being downloaded, or a page has been
+         * downloaded whose cursor isn't known yet because it hasn't
+         * been decoded.
+         *
+         * @param[in,out] lock
+         *     This is the lock held on the mutex of the object,
+         *     which is released while the request is posted.
+         */
+        void RequestNextPage(std::unique_lock< std::mutex >& lock) {
+            if (
+                done
+                || requestInProgress
+                || !bodies.empty()
+            ) {
+                return;
+            }
+            requestInProgress = true;
+            auto uri = resource;
+            if (!cursor.empty()) {
+                uri += StringExtensions::sprintf(
+                    "%cafter=%s",
+                    ((resource.find('?') == std::string::npos) ? '?' : '&'),
+                    cursor.c_str()
+                );
+            }
+            auto selfWeakCopy(selfWeak);
+            lock.unlock();
+            twitch->PostApiCallForBody(
+                api,
+                uri,
+                [selfWeakCopy](const std::string& body){
+                    auto self = selfWeakCopy.lock();
+                    if (self == nullptr) {
+                        return;
+                    }
+                    // The page is decoded later, by NextPage, so that
+                    // the thread delivering responses for every
+                    // caller isn't held up here.
+                    std::lock_guard< std::mutex > lock(self->mutex);
+                    self->requestInProgress = false;
+                    self->bodies.push_back(body);
+                    self->pagesChanged.notify_all();
+                },
+                [selfWeakCopy](unsigned int statusCode){
+                    auto self = selfWeakCopy.lock();
+                    if (self == nullptr) {
+                        return;
+                    }
+                    std::lock_guard< std::mutex > lock(self->mutex);
+                    self->requestInProgress = false;
+                    self->done = true;
+                    self->failed = true;
+                    self->pagesChanged.notify_all();
+                },
+                priority,
+                caller
+            );
+            lock.lock();
+        }
+    };
+
+    Paginator::~Paginator() noexcept = default;
+    Paginator::Paginator(Paginator&&) noexcept = default;
+    Paginator& Paginator::operator=(Paginator&&) noexcept = default;
+
+    Paginator::Paginator(
+        Twitch& twitch,
+        Twitch::Api api,
+        const std::string& resource,
+        const std::vector< std::string >& fields,
+        Twitch::Priority priority,
+        const std::string& cursor
+    )
+        : impl_(new Impl())
+    {
+        impl_->selfWeak = impl_;
+        impl_->twitch = &twitch;
+        impl_->api = api;
+        impl_->caller = twitch.NewCaller();
+        impl_->resource = resource;
+        impl_->fields = fields;
+        impl_->priority = priority;
+        impl_->cursor = cursor;
+        std::unique_lock< std::mutex > lock(impl_->mutex);
+        impl_->RequestNextPage(lock);
+    }
+
+    bool Paginator::NextPage(ListPage& page) {
+        std::unique_lock< std::mutex > lock(impl_->mutex);
+        impl_->pagesChanged.wait(
+            lock,
+            [this]{
+                return (
+                    !impl_->bodies.empty()
+                    || !impl_->requestInProgress
+                );
+            }
+        );
+        if (impl_->bodies.empty()) {
+            return false;
+        }
+        const auto body = std::move(impl_->bodies.front());
+        impl_->bodies.pop_front();
+        lock.unlock();
+        page.fields = impl_->fields;
+        const auto decoded = page.Decode(body);
+        lock.lock();
+        if (!decoded) {
+            impl_->done = true;
+            impl_->failed = true;
+            return false;
+        }
+        impl_->cursor = page.cursor;
+        if (impl_->cursor.empty()) {
+            impl_->done = true;
+        }
+        impl_->RequestNextPage(lock);
+        return true;
+    }
+
+    void Paginator::Stop() {
+        std::lock_guard< std::mutex > lock(impl_->mutex);
+        impl_->done = true;
+    }
+
+    bool Paginator::HasFailed() const {
+        std::lock_guard< std::mutex > lock(impl_->mutex);
+        return impl_->failed;
+    }
+
+}
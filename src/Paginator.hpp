@@ -0,0 +1,122 @@
+#pragma once
+
+/**
+ * @file Paginator.hpp
+ *
+ * This module declares the Twarlock::Paginator class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "ListPage.hpp"
+#include "Twitch.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Twarlock {
+
+    /**
+     * This is used to download every page of a paginated Twitch API
+     * resource.  As soon as a page is returned, its cursor is used to
+     * request the next page, so that the next page is downloaded while
+     * the current one is being processed.
+     *
+     * Only the requested fields of each element of each page are
+     * extracted, without decoding the rest.  Pages are decoded by
+     * NextPage, on the thread processing them, rather than on the
+     * thread which delivers the responses of every API call.
+     */
+    class Paginator {
+        // Lifecycle Methods
+    public:
+        ~Paginator() noexcept;
+        Paginator(const Paginator&) = delete;
+        Paginator(Paginator&&) noexcept;
+        Paginator& operator=(const Paginator&) = delete;
+        Paginator& operator=(Paginator&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.  It requests the first
+         * page of the resource.
+         *
+         * @param[in] twitch
+         *     This is used to access Twitch APIs.
+         *
+         * @param[in] api
+         *     This is the API providing the resource.
+         *
+         * @param[in] resource
+         *     This is the resource to download.  The cursor of each page
+         *     after the first is added to it using the "after" parameter.
+         *
+         * @param[in] fields
+         *     These are the names of the fields to extract from each
+         *     element of each page, as given to VisitListEntries.
+         *
+         * @param[in] priority
+         *     This is the priority of the API calls made to download
+         *     the pages.
+         *
+         * @param[in] cursor
+         *     This is the cursor of the page from which to start,
+         *     or an empty string to start from the first page.
+         */
+        Paginator(
+            Twitch& twitch,
+            Twitch::Api api,
+            const std::string& resource,
+            const std::vector< std::string >& fields,
+            Twitch::Priority priority = Twitch::Priority::Bulk,
+            const std::string& cursor = ""
+        );
+
+        /**
+         * This method waits for the next page of the resource
+         * to be downloaded, decodes it, and returns it.
+         *
+         * @param[out] page
+         *     This is where to store the next page.
+         *
+         * @return
+         *     An indication of whether or not there was another page
+         *     is returned.  This is false once every page has been
+         *     returned, or if an API call to download a page failed.
+         */
+        bool NextPage(ListPage& page);
+
+        /**
+         * This method stops downloading pages after any page being
+         * downloaded now.
+         */
+        void Stop();
+
+        /**
+         * This method returns an indication of whether or not an API
+         * call made to download a page failed.
+         *
+         * @return
+         *     An indication of whether or not an API call made to
+         *     download a page failed is returned.
+         */
+        bool HasFailed() const;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::shared_ptr< Impl > impl_;
+    };
+
+}
@@ -0,0 +1,130 @@
+/**
+ * @file RateLimiter.cpp
+ *
+ * This module contains the implementation of the Twarlock::RateLimiter class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "RateLimiter.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+
+namespace {
+
+    /**
+     * This is the period of time, in seconds, over which Twitch refills
+     * an empty rate limit bucket if no reset time is given.
+     */
+    constexpr double defaultRateLimitWindow = 60.0;
+
+    /**
+     * This function extracts a numeric value from the header with the
+     * given name.
+     *
+     * @param[in] headers
+     *     These are the headers from which to extract the value.
+     *
+     * @param[in] name
+     *     This is the name of the header holding the value.
+     *
+     * @param[out] value
+     *     This is where to store the extracted value.
+     *
+     * @return
+     *     An indication of whether or not the value was extracted
+     *     is returned.
+     */
+    bool GetHeaderNumber(
+        const MessageHeaders::MessageHeaders& headers,
+        const std::string& name,
+        double& value
+    ) {
+        if (!headers.HasHeader(name)) {
+            return false;
+        }
+        const std::string headerValue = headers.GetHeaderValue(name);
+        return (sscanf(headerValue.c_str(), "%lf", &value) == 1);
+    }
+
+}
+
+namespace Twarlock {
+
+    void RateLimiter::Configure(
+        double limit,
+        double window,
+        double now
+    ) {
+        capacity_ = std::max(limit, 1.0);
+        tokens_ = capacity_;
+        refillRate_ = capacity_ / std::max(window, 1.0);
+        lastRefillTime_ = now;
+    }
+
+    bool RateLimiter::Acquire(double now) {
+        Refill(now);
+        if (tokens_ < 1.0) {
+            return false;
+        }
+        tokens_ -= 1.0;
+        return true;
+    }
+
+    double RateLimiter::GetNextTokenTime(double now) {
+        Refill(now);
+        if (tokens_ >= 1.0) {
+            return now;
+        }
+        return now + (1.0 - tokens_) / refillRate_;
+    }
+
+    double RateLimiter::GetAvailableTokens(double now) {
+        Refill(now);
+        return tokens_;
+    }
+
+    void RateLimiter::Update(
+        const MessageHeaders::MessageHeaders& headers,
+        size_t outstanding,
+        double now
+    ) {
+        double limit, remaining;
+        if (
+            !GetHeaderNumber(headers, "Ratelimit-Limit", limit)
+            || !GetHeaderNumber(headers, "Ratelimit-Remaining", remaining)
+            || (limit < 1.0)
+        ) {
+            return;
+        }
+        capacity_ = limit;
+        tokens_ = std::min(
+            std::max(remaining - (double)outstanding, 0.0),
+            capacity_
+        );
+        lastRefillTime_ = now;
+        double reset;
+        if (
+            GetHeaderNumber(headers, "Ratelimit-Reset", reset)
+            && (reset > now)
+            && (remaining < limit)
+        ) {
+            refillRate_ = (limit - remaining) / (reset - now);
+        } else {
+            refillRate_ = limit / defaultRateLimitWindow;
+        }
+    }
+
+    void RateLimiter::Refill(double now) {
+        if (now > lastRefillTime_) {
+            tokens_ = std::min(
+                tokens_ + (now - lastRefillTime_) * refillRate_,
+                capacity_
+            );
+            lastRefillTime_ = now;
+        }
+    }
+
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * @file RateLimiter.hpp
+ *
+ * This module declares the Twarlock::RateLimiter class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <MessageHeaders/MessageHeaders.hpp>
+#include <stddef.h>
+
+namespace Twarlock {
+
+    /**
+     * This implements a token bucket used to pace requests made to
+     * Twitch APIs.  The bucket is kept in sync with the rate limit
+     * information Twitch returns in the "Ratelimit-*" headers of
+     * its responses, so that requests may be made in bursts while
+     * budget is available, slowing down only as the bucket empties.
+     */
+    class RateLimiter {
+        // Lifecycle Methods
+    public:
+        ~RateLimiter() noexcept = default;
+        RateLimiter(const RateLimiter&) = default;
+        RateLimiter(RateLimiter&&) noexcept = default;
+        RateLimiter& operator=(const RateLimiter&) = default;
+        RateLimiter& operator=(RateLimiter&&) noexcept = default;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.
+         */
+        RateLimiter() = default;
+
+        /**
+         * This method resets the bucket to be full, with the given
+         * capacity, refilling completely over the given window of time.
+         *
+         * @param[in] limit
+         *     This is the capacity of the bucket.
+         *
+         * @param[in] window
+         *     This is the time, in seconds, it takes an empty bucket
+         *     to refill completely.
+         *
+         * @param[in] now
+         *     This is the current time.
+         */
+        void Configure(
+            double limit,
+            double window,
+            double now
+        );
+
+        /**
+         * This method attempts to take a token from the bucket,
+         * in order to make one request.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     An indication of whether or not a token was taken
+         *     is returned.
+         */
+        bool Acquire(double now);
+
+        /**
+         * This method returns the time at which a token will next
+         * be available in the bucket.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The time at which a token will next be available
+         *     is returned.  This is the given current time if a token
+         *     is available now.
+         */
+        double GetNextTokenTime(double now);
+
+        /**
+         * This method returns the number of tokens in the bucket,
+         * which may include a fraction of a token.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The number of tokens in the bucket is returned.
+         */
+        double GetAvailableTokens(double now);
+
+        /**
+         * This method brings the bucket up to date with the rate limit
+         * information returned by Twitch in the headers of a response.
+         * Responses which don't carry rate limit headers are ignored.
+         *
+         * @param[in] headers
+         *     These are the headers of the response.
+         *
+         * @param[in] outstanding
+         *     This is the number of requests still in progress, for which
+         *     tokens were already taken but which Twitch may not yet have
+         *     counted against the remaining budget.
+         *
+         * @param[in] now
+         *     This is the current time.
+         */
+        void Update(
+            const MessageHeaders::MessageHeaders& headers,
+            size_t outstanding,
+            double now
+        );
+
+        // Private Methods
+    private:
+        /**
+         * This method adds to the bucket the tokens which have refilled
+         * since the last time it was refilled.
+         *
+         * @param[in] now
+         *     This is the current time.
+         */
+        void Refill(double now);
+
+        // Private properties
+    private:
+        /**
+         * This is the maximum number of tokens the bucket can hold.
+         */
+        double capacity_ = 1.0;
+
+        /**
+         * This is the number of tokens currently in the bucket.
+         */
+        double tokens_ = 1.0;
+
+        /**
+         * This is the number of tokens added to the bucket each second.
+         */
+        double refillRate_ = 1.0;
+
+        /**
+         * This is the time at which the bucket was last refilled.
+         */
+        double lastRefillTime_ = 0.0;
+    };
+
+}
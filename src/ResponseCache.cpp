@@ -0,0 +1,333 @@
+/**
+ * @file ResponseCache.cpp
+ *
+ * This module contains the implementation of the Twarlock::ResponseCache class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "ResponseCache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <map>
+#include <stdio.h>
+#include <StringExtensions/StringExtensions.hpp>
+#include <unordered_map>
+
+namespace {
+
+    /**
+     * This is the maximum number of entries kept in memory,
+     * unless configured otherwise.
+     */
+    constexpr size_t defaultMaxEntries = 1000;
+
+}
+
+namespace Twarlock {
+
+    /**
+     * This contains the private properties of a ResponseCache class instance.
+     */
+    struct ResponseCache::Impl {
+        /**
+         * This is the path of the directory in which to store entries,
+         * or an empty string if entries are only kept in memory.
+         */
+        std::string directory;
+
+        /**
+         * This indicates whether or not the cache has been configured
+         * for use.
+         */
+        bool enabled = false;
+
+        /**
+         * This holds the keys of the entries of the cache which are
+         * in memory, most recently used first.
+         */
+        std::list< std::string > recentlyUsed;
+
+        /**
+         * This holds the entries of the cache which are in memory,
+         * along with where their keys are in the recentlyUsed list.
+         *
+         * The keys are the keys of the entries.
+         */
+        std::unordered_map<
+            std::string,
+            std::pair< Entry, std::list< std::string >::iterator >
+        > entries;
+
+        /**
+         * This is the maximum number of entries to keep in memory.
+         * When more are stored, the least recently used are dropped.
+         */
+        size_t maxEntries = defaultMaxEntries;
+
+        /**
+         * This holds the number of seconds for which responses may be
+         * used without revalidating them.
+         *
+         * The keys are resource prefixes.
+         */
+        std::map< std::string, double > maxAges;
+
+        /**
+         * This method keeps the given entry in memory, as the most
+         * recently used one, dropping the least recently used entries
+         * if there are too many.
+         *
+         * @param[in] key
+         *     This is the key of the entry.
+         *
+         * @param[in] entry
+         *     This is the entry to keep.
+         */
+        void Keep(
+            const std::string& key,
+            const Entry& entry
+        ) {
+            auto entriesEntry = entries.find(key);
+            if (entriesEntry == entries.end()) {
+                recentlyUsed.push_front(key);
+                (void)entries.insert({key, {entry, recentlyUsed.begin()}});
+            } else {
+                entriesEntry->second.first = entry;
+                recentlyUsed.splice(
+                    recentlyUsed.begin(),
+                    recentlyUsed,
+                    entriesEntry->second.second
+                );
+            }
+            while (entries.size() > maxEntries) {
+                (void)entries.erase(recentlyUsed.back());
+                recentlyUsed.pop_back();
+            }
+        }
+
+        /**
+         * This method returns the path of the file used to store the
+         * entry with the given key.
+         *
+         * @param[in] key
+         *     This is the key of the entry.
+         *
+         * @return
+         *     The path of the file used to store the entry with the
+         *     given key is returned.
+         */
+        std::string GetEntryPath(const std::string& key) const {
+            return StringExtensions::sprintf(
+                "%s/%016zx.cache",
+                directory.c_str(),
+                std::hash< std::string >()(key)
+            );
+        }
+
+        /**
+         * This method loads the entry with the given key from the
+         * directory.
+         *
+         * Entry files hold the key, the time, the entity tag, and the
+         * modification time, one per line, followed by the body.
+         *
+         * @param[in] key
+         *     This is the key of the entry.
+         *
+         * @param[out] entry
+         *     This is where to store the entry, if loaded.
+         *
+         * @return
+         *     An indication of whether or not the entry was loaded
+         *     is returned.
+         */
+        bool Load(
+            const std::string& key,
+            Entry& entry
+        ) const {
+            const auto file = fopen(GetEntryPath(key).c_str(), "rb");
+            if (file == NULL) {
+                return false;
+            }
+            std::string contents;
+            if (
+                (fseek(file, 0, SEEK_END) == 0)
+                && (ftell(file) > 0)
+            ) {
+                contents.reserve((size_t)ftell(file));
+            }
+            rewind(file);
+            char buffer[65536];
+            size_t amountRead;
+            while ((amountRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                (void)contents.append(buffer, amountRead);
+            }
+            (void)fclose(file);
+            std::string lines[4];
+            size_t pos = 0;
+            for (auto& line: lines) {
+                const auto lineEnd = contents.find('\n', pos);
+                if (lineEnd == std::string::npos) {
+                    return false;
+                }
+                line = contents.substr(pos, lineEnd - pos);
+                pos = lineEnd + 1;
+            }
+            if (
+                (lines[0] != key)
+                || (sscanf(lines[1].c_str(), "%lf", &entry.time) != 1)
+            ) {
+                return false;
+            }
+            entry.etag = std::move(lines[2]);
+            entry.lastModified = std::move(lines[3]);
+            contents.erase(0, pos);
+            entry.body = std::make_shared< const std::string >(std::move(contents));
+            return true;
+        }
+
+        /**
+         * This method saves the given entry in the directory.
+         * It's written to a temporary file first, which then replaces
+         * any previous version of the entry, so that no other instance
+         * of the program sees a partially-written entry.
+         *
+         * @param[in] key
+         *     This is the key of the entry.
+         *
+         * @param[in] entry
+         *     This is the entry to save.
+         */
+        void Save(
+            const std::string& key,
+            const Entry& entry
+        ) const {
+            static const std::string noBody;
+            const auto& body = ((entry.body == nullptr) ? noBody : *entry.body);
+            const auto path = GetEntryPath(key);
+            const auto tempPath = path + ".tmp";
+            const auto file = fopen(tempPath.c_str(), "wb");
+            if (file == NULL) {
+                return;
+            }
+            bool success = (
+                (
+                    fprintf(
+                        file,
+                        "%s\n%.0lf\n%s\n%s\n",
+                        key.c_str(),
+                        entry.time,
+                        entry.etag.c_str(),
+                        entry.lastModified.c_str()
+                    ) > 0
+                )
+                && (fwrite(body.data(), 1, body.length(), file) == body.length())
+            );
+            if (fclose(file) != 0) {
+                success = false;
+            }
+            if (success) {
+#ifdef _WIN32
+                (void)remove(path.c_str());
+#endif /* _WIN32 */
+                success = (rename(tempPath.c_str(), path.c_str()) == 0);
+            }
+            if (!success) {
+                (void)remove(tempPath.c_str());
+            }
+        }
+    };
+
+    ResponseCache::~ResponseCache() noexcept = default;
+    ResponseCache::ResponseCache(ResponseCache&&) noexcept = default;
+    ResponseCache& ResponseCache::operator=(ResponseCache&&) noexcept = default;
+
+    ResponseCache::ResponseCache()
+        : impl_(new Impl())
+    {
+    }
+
+    void ResponseCache::Configure(const Json::Value& configuration) {
+        impl_->enabled = (configuration.GetType() == Json::Value::Type::Object);
+        impl_->directory.clear();
+        impl_->maxAges.clear();
+        impl_->entries.clear();
+        impl_->recentlyUsed.clear();
+        impl_->maxEntries = defaultMaxEntries;
+        if (!impl_->enabled) {
+            return;
+        }
+        if (configuration.Has("directory")) {
+            impl_->directory = (std::string)configuration["directory"];
+        }
+        if (configuration.Has("maxEntries")) {
+            const int maxEntries = configuration["maxEntries"];
+            impl_->maxEntries = (size_t)std::max(maxEntries, 1);
+        }
+        if (configuration.Has("maxAge")) {
+            const auto& maxAges = configuration["maxAge"];
+            for (const auto& resource: maxAges.GetKeys()) {
+                impl_->maxAges[resource] = (double)maxAges[resource];
+            }
+        }
+    }
+
+    bool ResponseCache::IsEnabled() const {
+        return impl_->enabled;
+    }
+
+    double ResponseCache::GetMaxAge(const std::string& resource) const {
+        const auto path = resource.substr(0, resource.find('?'));
+        double maxAge = 0.0;
+        size_t longestPrefixLength = 0;
+        for (const auto& maxAgesEntry: impl_->maxAges) {
+            const auto& prefix = maxAgesEntry.first;
+            if (
+                (prefix.length() >= longestPrefixLength)
+                && (path.compare(0, prefix.length(), prefix) == 0)
+            ) {
+                longestPrefixLength = prefix.length();
+                maxAge = maxAgesEntry.second;
+            }
+        }
+        return maxAge;
+    }
+
+    bool ResponseCache::Find(
+        const std::string& key,
+        Entry& entry
+    ) {
+        const auto entriesEntry = impl_->entries.find(key);
+        if (entriesEntry != impl_->entries.end()) {
+            entry = entriesEntry->second.first;
+            impl_->recentlyUsed.splice(
+                impl_->recentlyUsed.begin(),
+                impl_->recentlyUsed,
+                entriesEntry->second.second
+            );
+            return true;
+        }
+        if (
+            impl_->directory.empty()
+            || !impl_->Load(key, entry)
+        ) {
+            return false;
+        }
+        impl_->Keep(key, entry);
+        return true;
+    }
+
+    void ResponseCache::Store(
+        const std::string& key,
+        const Entry& entry
+    ) {
+        impl_->Keep(key, entry);
+        if (!impl_->directory.empty()) {
+            impl_->Save(key, entry);
+        }
+    }
+
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+/**
+ * @file ResponseCache.hpp
+ *
+ * This module declares the Twarlock::ResponseCache class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <Json/Value.hpp>
+#include <memory>
+#include <string>
+
+namespace Twarlock {
+
+    /**
+     * This holds onto the bodies of responses to Twitch API calls,
+     * along with the validators (entity tags and modification times)
+     * needed to revalidate them, so that the same resources don't
+     * have to be downloaded again and again.
+     *
+     * Entries are kept in memory, up to a limit beyond which the least
+     * recently used are dropped, and optionally also in files
+     * in a directory, so that they outlive the program.
+     */
+    class ResponseCache {
+        // Types
+    public:
+        /**
+         * This holds what is known about one cached response.
+         */
+        struct Entry {
+            /**
+             * This is the body of the response.  It's shared, rather than
+             * copied, between the cache, copies of the entry, and the
+             * callers given the response.
+             */
+            std::shared_ptr< const std::string > body;
+
+            /**
+             * This is the entity tag of the response, if any.
+             */
+            std::string etag;
+
+            /**
+             * This is the time at which the response was last modified,
+             * as given by the server, if any.
+             */
+            std::string lastModified;
+
+            /**
+             * This is the time at which the response was received
+             * or last revalidated.
+             */
+            double time = 0.0;
+        };
+
+        // Lifecycle Methods
+    public:
+        ~ResponseCache() noexcept;
+        ResponseCache(const ResponseCache&) = delete;
+        ResponseCache(ResponseCache&&) noexcept;
+        ResponseCache& operator=(const ResponseCache&) = delete;
+        ResponseCache& operator=(ResponseCache&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.
+         */
+        ResponseCache();
+
+        /**
+         * This method sets up the cache according to the given
+         * configuration, which is an object with these optional items:
+         * - "directory": path of directory in which to store entries
+         *   so that they outlive the program
+         * - "maxEntries": maximum number of entries to keep in memory
+         *   (default: 1000)
+         * - "maxAge": object whose keys are resource prefixes (such as
+         *   "users" or "moderation/banned") and whose values are the
+         *   number of seconds responses for matching resources may be
+         *   used without revalidating them
+         *
+         * @param[in] configuration
+         *     This holds the configuration of the cache.
+         */
+        void Configure(const Json::Value& configuration);
+
+        /**
+         * This method returns an indication of whether or not
+         * the cache has been configured for use.
+         *
+         * @return
+         *     An indication of whether or not the cache has been
+         *     configured for use is returned.
+         */
+        bool IsEnabled() const;
+
+        /**
+         * This method returns the number of seconds for which responses
+         * for the given resource may be used without revalidating them.
+         *
+         * @param[in] resource
+         *     This is the resource requested.
+         *
+         * @return
+         *     The number of seconds for which responses for the given
+         *     resource may be used without revalidating them is returned.
+         */
+        double GetMaxAge(const std::string& resource) const;
+
+        /**
+         * This method looks up the cached response with the given key.
+         *
+         * @param[in] key
+         *     This uniquely identifies the request whose response
+         *     is being looked up.
+         *
+         * @param[out] entry
+         *     This is where to store the cached response, if found.
+         *
+         * @return
+         *     An indication of whether or not a cached response was found
+         *     is returned.
+         */
+        bool Find(
+            const std::string& key,
+            Entry& entry
+        );
+
+        /**
+         * This method stores the given response in the cache.
+         *
+         * @param[in] key
+         *     This uniquely identifies the request whose response
+         *     is being stored.
+         *
+         * @param[in] entry
+         *     This is the response to store.
+         */
+        void Store(
+            const std::string& key,
+            const Entry& entry
+        );
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
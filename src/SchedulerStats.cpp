@@ -0,0 +1,135 @@
+/**
+ * @file SchedulerStats.cpp
+ *
+ * This module contains the implementation of the
+ * Twarlock::SchedulerStats class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "SchedulerStats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+namespace {
+
+    /**
+     * This is the number of buckets in each metric's histogram.
+     */
+    constexpr size_t numBuckets = 32;
+
+    /**
+     * This publishes a summary of the given metric.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish the summary.
+     *
+     * @param[in] name
+     *     This is the name of the metric.
+     *
+     * @param[in] metric
+     *     This is the metric to summarize.
+     */
+    void ReportMetric(
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        const char* name,
+        const Twarlock::SchedulerStats::Metric& metric
+    ) {
+        if (metric.count == 0) {
+            return;
+        }
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            2,
+            "Scheduler %s: %zu calls, mean %.1lf us, p50 <= %.1lf us, p99 <= %.1lf us, max %.1lf us",
+            name,
+            metric.count,
+            metric.total / (double)metric.count * 1e6,
+            metric.GetPercentile(0.5) * 1e6,
+            metric.GetPercentile(0.99) * 1e6,
+            metric.max * 1e6
+        );
+    }
+
+}
+
+namespace Twarlock {
+
+    void SchedulerStats::Metric::Add(double duration) {
+        ++count;
+        total += duration;
+        max = std::max(max, duration);
+        const auto microseconds = duration * 1e6;
+        size_t bucket = 0;
+        if (microseconds > 1.0) {
+            bucket = std::min(
+                (size_t)ceil(log2(microseconds)),
+                numBuckets - 1
+            );
+        }
+        ++buckets[bucket];
+    }
+
+    double SchedulerStats::Metric::GetPercentile(double fraction) const {
+        const auto target = (size_t)ceil(fraction * (double)count);
+        size_t seen = 0;
+        for (size_t i = 0; i < numBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= target) {
+                return std::min(ldexp(1.0, (int)i) / 1e6, max);
+            }
+        }
+        return max;
+    }
+
+    double SchedulerStats::Now() {
+        return std::chrono::duration< double >(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    void SchedulerStats::RecordPost(
+        double duration,
+        size_t numQueued
+    ) {
+        if (post_.count == 0) {
+            firstPostTime_ = Now() - duration;
+        }
+        post_.Add(duration);
+        maxQueued_ = std::max(maxQueued_, numQueued);
+    }
+
+    void SchedulerStats::RecordDispatch(double duration) {
+        dispatch_.Add(duration);
+    }
+
+    void SchedulerStats::RecordCallback(
+        double duration,
+        double now
+    ) {
+        callback_.Add(duration);
+        lastCallbackTime_ = now;
+    }
+
+    void SchedulerStats::Report(const SystemAbstractions::DiagnosticsSender& diagnosticsSender) const {
+        ReportMetric(diagnosticsSender, "post", post_);
+        ReportMetric(diagnosticsSender, "dispatch", dispatch_);
+        ReportMetric(diagnosticsSender, "callback", callback_);
+        const auto elapsed = lastCallbackTime_ - firstPostTime_;
+        if (
+            (callback_.count > 0)
+            && (elapsed > 0.0)
+        ) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                2,
+                "Scheduler throughput: %zu calls in %.3lf seconds (%.1lf calls/second), at most %zu queued",
+                callback_.count,
+                elapsed,
+                (double)callback_.count / elapsed,
+                maxQueued_
+            );
+        }
+    }
+
+}
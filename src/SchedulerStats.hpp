@@ -0,0 +1,181 @@
+#pragma once
+
+/**
+ * @file SchedulerStats.hpp
+ *
+ * This module declares the Twarlock::SchedulerStats class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <stddef.h>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+
+namespace Twarlock {
+
+    /**
+     * This measures how well the Twitch API call scheduler is doing:
+     * how long it takes to post an API call, how long calls wait before
+     * being started, how long it takes to deliver their results, and how
+     * many calls are completed per second.  It's used to judge changes
+     * to the scheduler, such as to concurrency, priorities, or rate
+     * limiting, by the numbers.
+     */
+    class SchedulerStats {
+        // Types
+    public:
+        /**
+         * This holds the measurements of one kind of duration.
+         */
+        struct Metric {
+            /**
+             * This is the number of durations measured.
+             */
+            size_t count = 0;
+
+            /**
+             * This is the sum of all durations measured, in seconds.
+             */
+            double total = 0.0;
+
+            /**
+             * This is the longest duration measured, in seconds.
+             */
+            double max = 0.0;
+
+            /**
+             * These count the durations measured, by powers of two
+             * microseconds.  The first bucket counts durations of up to
+             * one microsecond, the next up to two, then four, and so on.
+             * The last bucket counts everything longer.
+             */
+            size_t buckets[32] = {0};
+
+            /**
+             * This method adds the given duration to the measurements.
+             *
+             * @param[in] duration
+             *     This is the duration to add, in seconds.
+             */
+            void Add(double duration);
+
+            /**
+             * This method estimates the duration which the given fraction
+             * of measured durations did not exceed.
+             *
+             * @param[in] fraction
+             *     This is the fraction of durations, such as 0.99 for the
+             *     99th percentile.
+             *
+             * @return
+             *     The estimated duration, in seconds, is returned.
+             */
+            double GetPercentile(double fraction) const;
+        };
+
+        // Lifecycle Methods
+    public:
+        ~SchedulerStats() noexcept = default;
+        SchedulerStats(const SchedulerStats&) = default;
+        SchedulerStats(SchedulerStats&&) noexcept = default;
+        SchedulerStats& operator=(const SchedulerStats&) = default;
+        SchedulerStats& operator=(SchedulerStats&&) noexcept = default;
+
+        // Public Methods
+    public:
+        SchedulerStats() = default;
+
+        /**
+         * This method returns the current time, for use in measuring
+         * durations.  It's a steady clock with sub-microsecond resolution
+         * on most platforms, unrelated to the time of day.
+         *
+         * @return
+         *     The current time, in seconds, is returned.
+         */
+        static double Now();
+
+        /**
+         * This method records the time taken to post one API call,
+         * including any time spent waiting for the scheduler's lock.
+         *
+         * @param[in] duration
+         *     This is the time taken, in seconds.
+         *
+         * @param[in] numQueued
+         *     This is the number of API calls waiting to be started,
+         *     including the one just posted.
+         */
+        void RecordPost(
+            double duration,
+            size_t numQueued
+        );
+
+        /**
+         * This method records how long one API call waited, from when it
+         * was posted until it was started.
+         *
+         * @param[in] duration
+         *     This is the time waited, in seconds.
+         */
+        void RecordDispatch(double duration);
+
+        /**
+         * This method records the time taken to deliver the result of one
+         * API call, including the time spent in the caller's callback.
+         *
+         * @param[in] duration
+         *     This is the time taken, in seconds.
+         *
+         * @param[in] now
+         *     This is the time at which the result was delivered.
+         */
+        void RecordCallback(
+            double duration,
+            double now
+        );
+
+        /**
+         * This method publishes a summary of the measurements.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish the summary.
+         */
+        void Report(const SystemAbstractions::DiagnosticsSender& diagnosticsSender) const;
+
+        // Private properties
+    private:
+        /**
+         * These are the times taken to post API calls.
+         */
+        Metric post_;
+
+        /**
+         * These are the times API calls waited to be started.
+         */
+        Metric dispatch_;
+
+        /**
+         * These are the times taken to deliver the results of API calls.
+         */
+        Metric callback_;
+
+        /**
+         * This is the largest number of API calls seen waiting
+         * to be started at once.
+         */
+        size_t maxQueued_ = 0;
+
+        /**
+         * This is the time at which the first API call was posted.
+         */
+        double firstPostTime_ = 0.0;
+
+        /**
+         * This is the time at which the result of the last API call
+         * was delivered.
+         */
+        double lastCallbackTime_ = 0.0;
+    };
+
+}
@@ -0,0 +1,545 @@
+/**
+ * @file Serve.cpp
+ *
+ * This module defines the Twarlock::Serve command.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Commands.hpp"
+#include "Environment.hpp"
+#include "Server.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <StringExtensions/StringExtensions.hpp>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif /* not _WIN32 */
+
+using namespace Twarlock;
+
+namespace {
+
+#ifndef _WIN32
+    /**
+     * This is the number of milliseconds to wait for something to happen
+     * before checking whether or not the program has been interrupted.
+     */
+    constexpr int shutDownCheckIntervalMilliseconds = 100;
+
+    /**
+     * This is the maximum number of bytes of results to read at a time
+     * from a command, to send back to the client.
+     */
+    constexpr size_t outputChunkSize = 65536;
+
+    /**
+     * This is the largest request, in bytes, accepted from a client.
+     */
+    constexpr size_t maxRequestLength = 1024 * 1024;
+
+    /**
+     * This is the number of milliseconds a client has, after connecting,
+     * to send its request before it's disconnected.
+     */
+    constexpr int requestTimeoutMilliseconds = 10000;
+
+    /**
+     * This holds the connections to clients being served.
+     */
+    struct Connections {
+        std::mutex mutex;
+
+        /**
+         * These are the threads serving the connections.
+         * The keys are unique identifiers of the connections.
+         */
+        std::map< int, std::thread > threads;
+
+        /**
+         * These are the unique identifiers of the connections
+         * which have been closed, whose threads can be joined.
+         */
+        std::vector< int > closed;
+
+        /**
+         * This is used to make a unique identifier for each connection.
+         */
+        int nextId = 1;
+
+        /**
+         * This method joins the threads of the connections
+         * which have been closed.
+         *
+         * @param[in,out] lock
+         *     This is the object holding the mutex.
+         */
+        void JoinClosed(std::unique_lock< std::mutex >& lock) {
+            auto closedCopy = std::move(closed);
+            closed.clear();
+            for (const auto id: closedCopy) {
+                const auto threadsEntry = threads.find(id);
+                if (threadsEntry == threads.end()) {
+                    continue;
+                }
+                auto thread = std::move(threadsEntry->second);
+                (void)threads.erase(threadsEntry);
+                lock.unlock();
+                thread.join();
+                lock.lock();
+            }
+        }
+    };
+
+    /**
+     * This function removes whatever is left at the given path by
+     * a server which is no longer running, so that a new socket can
+     * be bound there.  Nothing is removed unless it's a socket
+     * on which nothing is listening.
+     *
+     * @param[in] socketPath
+     *     This is the path at which the server will listen.
+     *
+     * @param[in] address
+     *     This is the address of the socket at the path.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @return
+     *     An indication of whether or not the path is free to bind
+     *     is returned.
+     */
+    bool RemoveStaleSocket(
+        const std::string& socketPath,
+        const struct sockaddr_un& address,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        struct stat status;
+        if (lstat(socketPath.c_str(), &status) != 0) {
+            return true;
+        }
+        if (!S_ISSOCK(status.st_mode)) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "'%s' already exists and is not a socket",
+                socketPath.c_str()
+            );
+            return false;
+        }
+        const auto probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to create socket: %s",
+                strerror(errno)
+            );
+            return false;
+        }
+        const auto connectResult = connect(probe, (const struct sockaddr*)&address, sizeof(address));
+        const auto connectError = errno;
+        (void)close(probe);
+        if (connectResult == 0) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Another server is already listening on '%s'",
+                socketPath.c_str()
+            );
+            return false;
+        }
+        if (connectError != ECONNREFUSED) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to check socket '%s': %s",
+                socketPath.c_str(),
+                strerror(connectError)
+            );
+            return false;
+        }
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            1,
+            "Removing stale socket '%s'",
+            socketPath.c_str()
+        );
+        (void)unlink(socketPath.c_str());
+        return true;
+    }
+
+    /**
+     * This function executes the command requested by a client, sending
+     * back to the client the results and diagnostic messages published.
+     *
+     * The results are written to a pipe, from which they're read and
+     * sent to the client in chunks.  While the command is running,
+     * the connection is watched, so that the command can be told to
+     * stop if the client closes its end of the connection.
+     *
+     * @param[in] sock
+     *     This is the socket connected to the client.
+     *
+     * @param[in] serverEnvironment
+     *     This holds the configuration of the server.
+     *
+     * @param[in] commands
+     *     These are the commands which the server can execute.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages
+     *     about the connection itself.
+     *
+     * @param[in,out] twitch
+     *     This is used to access Twitch APIs.
+     *
+     * @param[in] shutDown
+     *     This is set if the server is interrupted.
+     */
+    void ServeConnection(
+        int sock,
+        const Environment& serverEnvironment,
+        const Commands::Table& commands,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown
+    ) {
+        // Wait for the request without blocking, so that the server can
+        // still be shut down while a client which connected is idle.
+        bool requestArrived = false;
+        for (
+            int waited = 0;
+            (
+                !shutDown
+                && (waited < requestTimeoutMilliseconds)
+            );
+            waited += shutDownCheckIntervalMilliseconds
+        ) {
+            struct pollfd pollSocket;
+            pollSocket.fd = sock;
+            pollSocket.events = POLLIN;
+            pollSocket.revents = 0;
+            const auto pollResult = poll(&pollSocket, 1, shutDownCheckIntervalMilliseconds);
+            if (pollResult > 0) {
+                requestArrived = true;
+                break;
+            }
+            if (
+                (pollResult < 0)
+                && (errno != EINTR)
+            ) {
+                break;
+            }
+        }
+        if (!requestArrived) {
+            if (!shutDown) {
+                diagnosticsSender.SendDiagnosticInformationString(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "Client did not send a request"
+                );
+            }
+            return;
+        }
+
+        // Once the request starts arriving, the rest of it should follow
+        // promptly; don't let a client stall the server part way through.
+        struct timeval receiveTimeout;
+        receiveTimeout.tv_sec = requestTimeoutMilliseconds / 1000;
+        receiveTimeout.tv_usec = (requestTimeoutMilliseconds % 1000) * 1000;
+        (void)setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &receiveTimeout, sizeof(receiveTimeout));
+        ServerMessageType type;
+        std::string data;
+        if (
+            !ReceiveServerMessage(sock, type, data, maxRequestLength)
+            || (type != ServerMessageType::Request)
+        ) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                "Client did not send a request"
+            );
+            return;
+        }
+        auto environment = serverEnvironment;
+        DecodeServerRequest(Json::Value::FromEncoding(data), environment);
+        std::mutex sendMutex;
+        const auto sendMessage = [&](
+            ServerMessageType messageType,
+            const std::string& messageData
+        ){
+            std::lock_guard< std::mutex > lock(sendMutex);
+            (void)SendServerMessage(sock, messageType, messageData);
+        };
+        SystemAbstractions::DiagnosticsSender commandDiagnosticsSender("Twarlock");
+        (void)commandDiagnosticsSender.SubscribeToDiagnostics(
+            [&](
+                std::string senderName,
+                size_t level,
+                std::string message
+            ){
+                sendMessage(
+                    ServerMessageType::Diagnostic,
+                    StringExtensions::sprintf("%zu %s", level, message.c_str())
+                );
+            }
+        );
+        const auto command = commands.find(environment.command);
+        if (
+            (command == commands.end())
+            || (environment.command == "serve")
+        ) {
+            commandDiagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "No such command '%s'",
+                environment.command.c_str()
+            );
+            sendMessage(ServerMessageType::Exit, "1");
+            return;
+        }
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            1,
+            "Executing '%s' for client",
+            environment.command.c_str()
+        );
+        int outputPipe[2];
+        if (pipe(outputPipe) != 0) {
+            commandDiagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to create pipe: %s",
+                strerror(errno)
+            );
+            sendMessage(ServerMessageType::Exit, "1");
+            return;
+        }
+        environment.outputStream = fdopen(outputPipe[1], "wb");
+        (void)setbuf(environment.outputStream, NULL);
+        // This is set by the relay thread, while the command reads it,
+        // so it must be safe to share between threads.
+        std::atomic< bool > commandShutDown(false);
+        std::thread relay(
+            [&]{
+                std::vector< char > buffer(outputChunkSize);
+                struct pollfd pollFds[2];
+                pollFds[0].fd = outputPipe[0];
+                pollFds[0].events = POLLIN;
+                pollFds[1].fd = sock;
+                pollFds[1].events = POLLIN;
+                bool watchClient = true;
+                for (;;) {
+                    if (shutDown) {
+                        commandShutDown = true;
+                    }
+                    pollFds[0].revents = 0;
+                    pollFds[1].revents = 0;
+                    const auto pollResult = poll(
+                        pollFds,
+                        (watchClient ? 2 : 1),
+                        shutDownCheckIntervalMilliseconds
+                    );
+                    if (pollResult < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        break;
+                    }
+                    if (
+                        watchClient
+                        && (pollFds[1].revents != 0)
+                    ) {
+                        // The client sends nothing after its request,
+                        // so anything here means it closed its end of
+                        // the connection.
+                        commandShutDown = true;
+                        watchClient = false;
+                    }
+                    if (pollFds[0].revents != 0) {
+                        const auto amountRead = read(outputPipe[0], buffer.data(), buffer.size());
+                        if (amountRead < 0) {
+                            if (errno == EINTR) {
+                                continue;
+                            }
+                            break;
+                        }
+                        if (amountRead == 0) {
+                            break;
+                        }
+                        sendMessage(
+                            ServerMessageType::Output,
+                            std::string(buffer.data(), (size_t)amountRead)
+                        );
+                    }
+                }
+            }
+        );
+        const auto success = command->second.execute(
+            environment,
+            commandDiagnosticsSender,
+            twitch,
+            commandShutDown
+        );
+        (void)fclose(environment.outputStream);
+        relay.join();
+        (void)close(outputPipe[0]);
+        sendMessage(ServerMessageType::Exit, (success ? "0" : "1"));
+    }
+#endif /* not _WIN32 */
+
+    bool Serve(
+        Environment& environment,
+        SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        Twitch& twitch,
+        const std::atomic< bool >& shutDown
+    ) {
+#ifdef _WIN32
+        diagnosticsSender.SendDiagnosticInformationString(
+            SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+            "Serving commands is not supported on this platform"
+        );
+        return false;
+#else /* not _WIN32 */
+        if (environment.args.empty()) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "socket path expected"
+            );
+            return false;
+        }
+        const auto& socketPath = environment.args[0];
+        struct sockaddr_un address;
+        if (socketPath.length() >= sizeof(address.sun_path)) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Socket path '%s' is too long",
+                socketPath.c_str()
+            );
+            return false;
+        }
+        (void)memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        (void)strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+        // Clients which go away before their results are sent
+        // shouldn't take the server down with them.
+        (void)signal(SIGPIPE, SIG_IGN);
+
+        const auto listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to create socket: %s",
+                strerror(errno)
+            );
+            return false;
+        }
+        if (!RemoveStaleSocket(socketPath, address, diagnosticsSender)) {
+            (void)close(listener);
+            return false;
+        }
+        if (
+            (bind(listener, (const struct sockaddr*)&address, sizeof(address)) != 0)
+            || (listen(listener, SOMAXCONN) != 0)
+        ) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to listen on '%s': %s",
+                socketPath.c_str(),
+                strerror(errno)
+            );
+            (void)close(listener);
+            return false;
+        }
+        diagnosticsSender.SendDiagnosticInformationFormatted(
+            3,
+            "Serving commands on '%s'",
+            socketPath.c_str()
+        );
+        const auto commands = Commands::Build();
+        Connections connections;
+        while (!shutDown) {
+            struct pollfd pollListener;
+            pollListener.fd = listener;
+            pollListener.events = POLLIN;
+            pollListener.revents = 0;
+            const auto pollResult = poll(&pollListener, 1, shutDownCheckIntervalMilliseconds);
+            std::unique_lock< std::mutex > lock(connections.mutex);
+            connections.JoinClosed(lock);
+            if (pollResult <= 0) {
+                continue;
+            }
+            const auto sock = accept(listener, NULL, NULL);
+            if (sock < 0) {
+                continue;
+            }
+            const auto id = connections.nextId++;
+            connections.threads[id] = std::thread(
+                [
+                    sock,
+                    id,
+                    &environment,
+                    &commands,
+                    &diagnosticsSender,
+                    &twitch,
+                    &shutDown,
+                    &connections
+                ]{
+                    ServeConnection(
+                        sock,
+                        environment,
+                        commands,
+                        diagnosticsSender,
+                        twitch,
+                        shutDown
+                    );
+                    (void)close(sock);
+                    std::lock_guard< std::mutex > lock(connections.mutex);
+                    connections.closed.push_back(id);
+                }
+            );
+        }
+        (void)close(listener);
+        (void)unlink(socketPath.c_str());
+        std::unique_lock< std::mutex > lock(connections.mutex);
+        while (!connections.threads.empty()) {
+            auto thread = std::move(connections.threads.begin()->second);
+            (void)connections.threads.erase(connections.threads.begin());
+            lock.unlock();
+            thread.join();
+            lock.lock();
+        }
+        return true;
+#endif /* _WIN32 or not _WIN32 */
+    };
+
+    struct RegisterInfo {
+        RegisterInfo() {
+            Command command;
+            command.cmdSummary = "Serve commands to other Twarlock instances";
+            command.cmdDetails = (
+                "Keep running, executing commands sent by other instances of"
+                " Twarlock given the --server option, and sending back their"
+                " results.  All commands share the same connections to Twitch,"
+                " caches and rate limit, so the cost of starting up is paid"
+                " only once."
+            );
+            command.argSummary = "<SOCKET>";
+            command.argDetails = {
+                {"SOCKET", "Path of the local socket on which to listen for commands"},
+            };
+            command.execute = Serve;
+            Commands::Add("serve", std::move(command));
+        }
+    } registerInfo;
+
+}
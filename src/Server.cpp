@@ -0,0 +1,366 @@
+/**
+ * @file Server.cpp
+ *
+ * This module contains the implementation of the functions used
+ * to exchange messages with a Twarlock server.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Server.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <SystemAbstractions/File.hpp>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif /* not _WIN32 */
+
+namespace {
+
+    /**
+     * This is the number of bytes in the header of each message,
+     * which holds the type of the message and the length of its data.
+     */
+    constexpr size_t messageHeaderSize = 5;
+
+    /**
+     * This is the number of milliseconds to wait for a message from
+     * the server before checking whether or not the program has been
+     * interrupted.
+     */
+    constexpr int shutDownCheckIntervalMilliseconds = 100;
+
+    /**
+     * This is the largest amount of data to accept in any one message
+     * from the server.  The server sends results in much smaller chunks,
+     * so this only guards against a corrupt or hostile peer.
+     */
+    constexpr size_t maxResultMessageLength = 64 * 1024 * 1024;
+
+    /**
+     * This function returns the given path, made relative to the given
+     * working directory if it's not already an absolute path.
+     *
+     * @param[in] path
+     *     This is the path to resolve.
+     *
+     * @param[in] workingDirectory
+     *     This is the directory to which relative paths are relative.
+     *
+     * @return
+     *     The resolved path is returned.
+     */
+    std::string ResolvePath(
+        const std::string& path,
+        const std::string& workingDirectory
+    ) {
+        if (
+            path.empty()
+            || (path[0] == '/')
+            || workingDirectory.empty()
+        ) {
+            return path;
+        }
+        return workingDirectory + "/" + path;
+    }
+
+#ifndef _WIN32
+    /**
+     * This function sends all the given bytes through the given socket.
+     *
+     * @param[in] socket
+     *     This is the socket through which to send the bytes.
+     *
+     * @param[in] data
+     *     This points to the bytes to send.
+     *
+     * @param[in] length
+     *     This is the number of bytes to send.
+     *
+     * @return
+     *     An indication of whether or not all the bytes were sent
+     *     is returned.
+     */
+    bool SendAll(
+        int socket,
+        const char* data,
+        size_t length
+    ) {
+        while (length > 0) {
+            const auto amountSent = send(socket, data, length, 0);
+            if (amountSent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += amountSent;
+            length -= (size_t)amountSent;
+        }
+        return true;
+    }
+
+    /**
+     * This function receives exactly the given number of bytes
+     * through the given socket.
+     *
+     * @param[in] socket
+     *     This is the socket through which to receive the bytes.
+     *
+     * @param[out] data
+     *     This is where to store the bytes received.
+     *
+     * @param[in] length
+     *     This is the number of bytes to receive.
+     *
+     * @return
+     *     An indication of whether or not all the bytes were received
+     *     is returned.
+     */
+    bool ReceiveAll(
+        int socket,
+        char* data,
+        size_t length
+    ) {
+        while (length > 0) {
+            const auto amountReceived = recv(socket, data, length, 0);
+            if (amountReceived < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            if (amountReceived == 0) {
+                return false;
+            }
+            data += amountReceived;
+            length -= (size_t)amountReceived;
+        }
+        return true;
+    }
+#endif /* not _WIN32 */
+
+}
+
+namespace Twarlock {
+
+    bool SendServerMessage(
+        int socket,
+        ServerMessageType type,
+        const std::string& data
+    ) {
+#ifdef _WIN32
+        return false;
+#else /* not _WIN32 */
+        const auto length = (uint32_t)data.length();
+        const char header[messageHeaderSize] = {
+            (char)type,
+            (char)(length >> 24),
+            (char)(length >> 16),
+            (char)(length >> 8),
+            (char)length,
+        };
+        return (
+            SendAll(socket, header, messageHeaderSize)
+            && SendAll(socket, data.data(), data.length())
+        );
+#endif /* _WIN32 or not _WIN32 */
+    }
+
+    bool ReceiveServerMessage(
+        int socket,
+        ServerMessageType& type,
+        std::string& data,
+        size_t maxLength
+    ) {
+#ifdef _WIN32
+        return false;
+#else /* not _WIN32 */
+        unsigned char header[messageHeaderSize];
+        if (!ReceiveAll(socket, (char*)header, messageHeaderSize)) {
+            return false;
+        }
+        type = (ServerMessageType)header[0];
+        const auto length = (
+            ((uint32_t)header[1] << 24)
+            | ((uint32_t)header[2] << 16)
+            | ((uint32_t)header[3] << 8)
+            | (uint32_t)header[4]
+        );
+        if (length > maxLength) {
+            return false;
+        }
+        data.resize(length);
+        return (
+            (length == 0)
+            || ReceiveAll(socket, &data[0], length)
+        );
+#endif /* _WIN32 or not _WIN32 */
+    }
+
+    Json::Value EncodeServerRequest(const Environment& environment) {
+        auto request = Json::Object();
+        request.Set("command", environment.command);
+        auto args = Json::Array();
+        for (const auto& arg: environment.args) {
+            args.Add(arg);
+        }
+        request.Set("args", args);
+        request.Set("outputFilePath", environment.outputFilePath);
+        request.Set("outputFormat", environment.outputFormat);
+        request.Set("snapshotFilePath", environment.snapshotFilePath);
+        request.Set("follow", environment.follow);
+        request.Set("resume", environment.resume);
+        request.Set("workingDirectory", SystemAbstractions::File::GetWorkingDirectory());
+        return request;
+    }
+
+    void DecodeServerRequest(
+        const Json::Value& request,
+        Environment& environment
+    ) {
+        const std::string workingDirectory = request["workingDirectory"];
+        environment.command = (std::string)request["command"];
+        const auto& args = request["args"];
+        environment.args.clear();
+        for (size_t i = 0; i < args.GetSize(); ++i) {
+            environment.args.push_back(args[i]);
+        }
+        environment.outputFilePath = ResolvePath(request["outputFilePath"], workingDirectory);
+        environment.outputFormat = (std::string)request["outputFormat"];
+        environment.snapshotFilePath = ResolvePath(request["snapshotFilePath"], workingDirectory);
+        environment.follow = request["follow"];
+        environment.resume = request["resume"];
+        environment.mode = Environment::Mode::Execute;
+    }
+
+    bool ExecuteOnServer(
+        const std::string& socketPath,
+        const Environment& environment,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        const std::atomic< bool >& shutDown
+    ) {
+#ifdef _WIN32
+        diagnosticsSender.SendDiagnosticInformationString(
+            SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+            "Connecting to a server is not supported on this platform"
+        );
+        return false;
+#else /* not _WIN32 */
+        struct sockaddr_un address;
+        if (socketPath.length() >= sizeof(address.sun_path)) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Server socket path '%s' is too long",
+                socketPath.c_str()
+            );
+            return false;
+        }
+        (void)memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        (void)strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        const auto sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock < 0) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to create socket: %s",
+                strerror(errno)
+            );
+            return false;
+        }
+        if (connect(sock, (const struct sockaddr*)&address, sizeof(address)) != 0) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to connect to server at '%s': %s",
+                socketPath.c_str(),
+                strerror(errno)
+            );
+            (void)close(sock);
+            return false;
+        }
+        if (
+            !SendServerMessage(
+                sock,
+                ServerMessageType::Request,
+                EncodeServerRequest(environment).ToEncoding()
+            )
+        ) {
+            diagnosticsSender.SendDiagnosticInformationString(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to send request to server"
+            );
+            (void)close(sock);
+            return false;
+        }
+        bool interrupted = false;
+        for (;;) {
+            if (
+                shutDown
+                && !interrupted
+            ) {
+                // Closing our end of the connection tells the server
+                // to stop the command.
+                interrupted = true;
+                (void)shutdown(sock, SHUT_WR);
+            }
+            struct pollfd pollSocket;
+            pollSocket.fd = sock;
+            pollSocket.events = POLLIN;
+            pollSocket.revents = 0;
+            const auto pollResult = poll(&pollSocket, 1, shutDownCheckIntervalMilliseconds);
+            if (pollResult == 0) {
+                continue;
+            }
+            if (pollResult < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            ServerMessageType type;
+            std::string data;
+            if (!ReceiveServerMessage(sock, type, data, maxResultMessageLength)) {
+                break;
+            }
+            switch (type) {
+                case ServerMessageType::Output: {
+                    (void)fwrite(data.data(), 1, data.length(), stdout);
+                } break;
+
+                case ServerMessageType::Diagnostic: {
+                    size_t level = 0;
+                    int messageOffset = 0;
+                    if (sscanf(data.c_str(), "%zu %n", &level, &messageOffset) == 1) {
+                        diagnosticsSender.SendDiagnosticInformationString(
+                            level,
+                            data.substr((size_t)messageOffset)
+                        );
+                    }
+                } break;
+
+                case ServerMessageType::Exit: {
+                    (void)close(sock);
+                    return (data == "0");
+                } break;
+
+                default: {
+                } break;
+            }
+        }
+        (void)close(sock);
+        diagnosticsSender.SendDiagnosticInformationString(
+            SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+            "Connection to server lost"
+        );
+        return false;
+#endif /* _WIN32 or not _WIN32 */
+    }
+
+}
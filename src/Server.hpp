@@ -0,0 +1,162 @@
+#pragma once
+
+/**
+ * @file Server.hpp
+ *
+ * This module declares the functions used to exchange messages with
+ * a Twarlock server, which is started with the serve command and
+ * executes commands on behalf of other Twarlock instances.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Environment.hpp"
+
+#include <atomic>
+#include <Json/Value.hpp>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+
+namespace Twarlock {
+
+    /**
+     * These are the kinds of messages exchanged with a server.
+     */
+    enum class ServerMessageType : char {
+        /**
+         * This is sent by a client to request a command be executed.
+         * It holds the command, its arguments and options, as a JSON
+         * object made by EncodeServerRequest.
+         */
+        Request = 'r',
+
+        /**
+         * This is sent by the server, and holds results written
+         * by the command.
+         */
+        Output = 'o',
+
+        /**
+         * This is sent by the server, and holds the level of a diagnostic
+         * message published by the command, followed by a space and the
+         * message itself.
+         */
+        Diagnostic = 'd',
+
+        /**
+         * This is sent by the server once the command has completed,
+         * and holds "0" if the command succeeded, or "1" if it failed.
+         */
+        Exit = 'x',
+    };
+
+    /**
+     * This function sends a message through the given socket.
+     *
+     * @param[in] socket
+     *     This is the socket through which to send the message.
+     *
+     * @param[in] type
+     *     This is the kind of message to send.
+     *
+     * @param[in] data
+     *     This is the data to send in the message.
+     *
+     * @return
+     *     An indication of whether or not the message was sent is returned.
+     */
+    bool SendServerMessage(
+        int socket,
+        ServerMessageType type,
+        const std::string& data
+    );
+
+    /**
+     * This function waits for a message to be received through
+     * the given socket.
+     *
+     * @param[in] socket
+     *     This is the socket through which to receive the message.
+     *
+     * @param[out] type
+     *     This is where to store the kind of message received.
+     *
+     * @param[out] data
+     *     This is where to store the data received in the message.
+     *
+     * @param[in] maxLength
+     *     This is the largest amount of data to accept in the message.
+     *     Messages claiming to hold more than this are rejected without
+     *     reading their data.
+     *
+     * @return
+     *     An indication of whether or not a message was received
+     *     is returned.
+     */
+    bool ReceiveServerMessage(
+        int socket,
+        ServerMessageType& type,
+        std::string& data,
+        size_t maxLength
+    );
+
+    /**
+     * This function encodes the command to execute, along with its
+     * arguments and options, to send to a server.
+     *
+     * @param[in] environment
+     *     This holds the command, its arguments and options.
+     *
+     * @return
+     *     The encoded request is returned.
+     */
+    Json::Value EncodeServerRequest(const Environment& environment);
+
+    /**
+     * This function decodes a request received by a server,
+     * storing the command to execute, along with its arguments
+     * and options, in the given environment.  Relative paths
+     * are made relative to the working directory of the client.
+     *
+     * @param[in] request
+     *     This is the request to decode.
+     *
+     * @param[in,out] environment
+     *     This is where to store the command, its arguments and options.
+     */
+    void DecodeServerRequest(
+        const Json::Value& request,
+        Environment& environment
+    );
+
+    /**
+     * This function asks the server listening on the given socket
+     * to execute the command in the given environment, copying the
+     * results and diagnostic messages it sends back to the standard
+     * output and the given diagnostics sender.
+     *
+     * @param[in] socketPath
+     *     This is the path of the socket on which the server is listening.
+     *
+     * @param[in] environment
+     *     This holds the command to execute, its arguments and options.
+     *
+     * @param[in] diagnosticsSender
+     *     This is the object to use to publish any diagnostic messages.
+     *
+     * @param[in] shutDown
+     *     This is set if the program is interrupted, in which case
+     *     the server is told to stop the command.
+     *
+     * @return
+     *     An indication of whether or not the command succeeded
+     *     is returned.
+     */
+    bool ExecuteOnServer(
+        const std::string& socketPath,
+        const Environment& environment,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender,
+        const std::atomic< bool >& shutDown
+    );
+
+}
@@ -0,0 +1,405 @@
+/**
+ * @file Snapshot.cpp
+ *
+ * This module contains the implementation of the
+ * Twarlock::Snapshot structure.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "LoadFile.hpp"
+#include "Snapshot.hpp"
+
+#include <algorithm>
+#include <inttypes.h>
+#include <stdio.h>
+#include <StringExtensions/StringExtensions.hpp>
+#include <unordered_map>
+
+namespace {
+
+    /**
+     * These are the bytes at the start of every snapshot file.
+     */
+    constexpr char magic[4] = {'T', 'W', 'S', 'N'};
+
+    /**
+     * This is the version of the snapshot file format written by
+     * this program.
+     */
+    constexpr uintmax_t formatVersion = 2;
+
+    /**
+     * This is the oldest version of the snapshot file format which
+     * this program can still read.
+     */
+    constexpr uintmax_t oldestFormatVersion = 1;
+
+    /**
+     * This function appends the given unsigned integer to the given buffer,
+     * encoded in seven-bit groups, least significant first, with the
+     * high bit of each byte set if more bytes follow.
+     *
+     * @param[in,out] buffer
+     *     This is the buffer to which to append the value.
+     *
+     * @param[in] value
+     *     This is the value to append.
+     */
+    void AppendVarint(
+        std::string& buffer,
+        uintmax_t value
+    ) {
+        while (value >= 0x80) {
+            buffer += (char)((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        buffer += (char)value;
+    }
+
+    /**
+     * This function appends the given signed 64-bit integer to the
+     * given buffer, in little-endian byte order.
+     *
+     * @param[in,out] buffer
+     *     This is the buffer to which to append the value.
+     *
+     * @param[in] value
+     *     This is the value to append.
+     */
+    void AppendInt64(
+        std::string& buffer,
+        int64_t value
+    ) {
+        auto bits = (uint64_t)value;
+        for (size_t i = 0; i < 8; ++i) {
+            buffer += (char)(bits & 0xFF);
+            bits >>= 8;
+        }
+    }
+
+    /**
+     * This function appends the given string to the given buffer,
+     * preceded by its length.
+     *
+     * @param[in,out] buffer
+     *     This is the buffer to which to append the value.
+     *
+     * @param[in] value
+     *     This is the value to append.
+     */
+    void AppendString(
+        std::string& buffer,
+        const std::string& value
+    ) {
+        AppendVarint(buffer, value.length());
+        buffer += value;
+    }
+
+    /**
+     * This is used to decode the values in a snapshot file.
+     */
+    struct Reader {
+        /**
+         * This is the encoded snapshot.
+         */
+        const std::string& buffer;
+
+        /**
+         * This is the position of the next value to decode.
+         */
+        size_t pos = 0;
+
+        /**
+         * This indicates whether or not an attempt was made to decode
+         * past the end of the buffer, or a value was malformed.
+         */
+        bool failed = false;
+
+        explicit Reader(const std::string& buffer)
+            : buffer(buffer)
+        {
+        }
+
+        uintmax_t ReadVarint() {
+            uintmax_t value = 0;
+            for (unsigned int shift = 0; shift < 64; shift += 7) {
+                if (pos >= buffer.length()) {
+                    break;
+                }
+                const auto byte = (uint8_t)buffer[pos++];
+                value |= ((uintmax_t)(byte & 0x7F) << shift);
+                if ((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+            failed = true;
+            return 0;
+        }
+
+        int64_t ReadInt64() {
+            if (buffer.length() - pos < 8) {
+                failed = true;
+                pos = buffer.length();
+                return 0;
+            }
+            uint64_t bits = 0;
+            for (size_t i = 0; i < 8; ++i) {
+                bits |= ((uint64_t)(uint8_t)buffer[pos++] << (i * 8));
+            }
+            return (int64_t)bits;
+        }
+
+        std::string ReadString() {
+            const auto length = ReadVarint();
+            if (
+                failed
+                || (buffer.length() - pos < length)
+            ) {
+                failed = true;
+                pos = buffer.length();
+                return "";
+            }
+            const auto value = buffer.substr(pos, (size_t)length);
+            pos += (size_t)length;
+            return value;
+        }
+    };
+
+    /**
+     * This function returns the number of days from the UNIX epoch
+     * to the given date in the proleptic Gregorian calendar.
+     *
+     * @param[in] year
+     *     This is the year of the date.
+     *
+     * @param[in] month
+     *     This is the month of the date (1-12).
+     *
+     * @param[in] day
+     *     This is the day of the month of the date (1-31).
+     *
+     * @return
+     *     The number of days from the UNIX epoch to the given date
+     *     is returned.
+     */
+    int64_t DaysFromCivil(
+        int64_t year,
+        unsigned int month,
+        unsigned int day
+    ) {
+        year -= (month <= 2) ? 1 : 0;
+        const auto era = ((year >= 0) ? year : year - 399) / 400;
+        const auto yearOfEra = (unsigned int)(year - era * 400);
+        const auto dayOfYear = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+        const auto dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + (int64_t)dayOfEra - 719468;
+    }
+
+}
+
+namespace Twarlock {
+
+    bool Snapshot::Save(
+        const std::string& filePath,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        std::sort(
+            entries.begin(),
+            entries.end(),
+            [](const Entry& lhs, const Entry& rhs){
+                return lhs.userid < rhs.userid;
+            }
+        );
+        std::unordered_map< std::string, size_t > nameIndexes;
+        std::vector< const std::string* > names;
+        for (const auto& entry: entries) {
+            if (nameIndexes.insert({entry.name, names.size()}).second) {
+                names.push_back(&entry.name);
+            }
+        }
+        std::string buffer(magic, sizeof(magic));
+        AppendVarint(buffer, formatVersion);
+        AppendVarint(buffer, (uintmax_t)kind);
+        AppendString(buffer, channelName);
+        AppendVarint(buffer, (uintmax_t)channelId);
+        AppendInt64(buffer, time);
+        AppendInt64(buffer, fullSyncTime);
+        AppendVarint(buffer, names.size());
+        for (const auto name: names) {
+            AppendString(buffer, *name);
+        }
+        AppendVarint(buffer, entries.size());
+        uintmax_t lastUserid = 0;
+        for (const auto& entry: entries) {
+            AppendVarint(buffer, (uintmax_t)entry.userid - lastUserid);
+            lastUserid = (uintmax_t)entry.userid;
+            AppendVarint(buffer, nameIndexes[entry.name]);
+            AppendInt64(buffer, entry.time);
+        }
+        const auto tempPath = filePath + ".tmp";
+        const auto file = fopen(tempPath.c_str(), "wb");
+        if (file == NULL) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to open snapshot file '%s'",
+                tempPath.c_str()
+            );
+            return false;
+        }
+        const auto written = fwrite(buffer.data(), 1, buffer.length(), file);
+        const auto closed = (fclose(file) == 0);
+        bool success = (
+            (written == buffer.length())
+            && closed
+        );
+        if (success) {
+#ifdef _WIN32
+            (void)remove(filePath.c_str());
+#endif /* _WIN32 */
+            success = (rename(tempPath.c_str(), filePath.c_str()) == 0);
+        }
+        if (!success) {
+            (void)remove(tempPath.c_str());
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Unable to write snapshot file '%s'",
+                filePath.c_str()
+            );
+            return false;
+        }
+        return true;
+    }
+
+    bool Snapshot::Load(
+        const std::string& filePath,
+        const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+    ) {
+        std::string buffer;
+        if (
+            !LoadFile(
+                filePath,
+                "snapshot",
+                diagnosticsSender,
+                buffer
+            )
+        ) {
+            return false;
+        }
+        if (
+            (buffer.length() < sizeof(magic))
+            || (buffer.compare(0, sizeof(magic), magic, sizeof(magic)) != 0)
+        ) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "File '%s' is not a snapshot",
+                filePath.c_str()
+            );
+            return false;
+        }
+        Reader reader(buffer);
+        reader.pos = sizeof(magic);
+        const auto version = reader.ReadVarint();
+        if (
+            (version < oldestFormatVersion)
+            || (version > formatVersion)
+        ) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Snapshot '%s' has unsupported version %" PRIuMAX,
+                filePath.c_str(),
+                version
+            );
+            return false;
+        }
+        kind = (Kind)reader.ReadVarint();
+        channelName = reader.ReadString();
+        channelId = (intmax_t)reader.ReadVarint();
+        time = reader.ReadInt64();
+        if (version >= 2) {
+            fullSyncTime = reader.ReadInt64();
+        } else {
+            fullSyncTime = time;
+        }
+        const auto numNames = reader.ReadVarint();
+        std::vector< std::string > names;
+        for (uintmax_t i = 0; !reader.failed && (i < numNames); ++i) {
+            names.push_back(reader.ReadString());
+        }
+        const auto numEntries = reader.ReadVarint();
+        entries.clear();
+        if (!reader.failed) {
+            entries.reserve((size_t)std::min(numEntries, (uintmax_t)buffer.length()));
+        }
+        uintmax_t userid = 0;
+        for (uintmax_t i = 0; !reader.failed && (i < numEntries); ++i) {
+            Entry entry;
+            userid += reader.ReadVarint();
+            entry.userid = (intmax_t)userid;
+            const auto nameIndex = reader.ReadVarint();
+            if (nameIndex < names.size()) {
+                entry.name = names[(size_t)nameIndex];
+            } else {
+                reader.failed = true;
+            }
+            entry.time = reader.ReadInt64();
+            entries.push_back(std::move(entry));
+        }
+        if (reader.failed) {
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                "Snapshot '%s' is truncated or corrupt",
+                filePath.c_str()
+            );
+            entries.clear();
+            return false;
+        }
+        return true;
+    }
+
+    int64_t Snapshot::ParseTime(const std::string& timestamp) {
+        int year, month, day, hour, minute, second;
+        if (
+            sscanf(
+                timestamp.c_str(),
+                "%d-%d-%dT%d:%d:%d",
+                &year, &month, &day, &hour, &minute, &second
+            ) != 6
+        ) {
+            return 0;
+        }
+        return (
+            DaysFromCivil(year, (unsigned int)month, (unsigned int)day) * 86400
+            + hour * 3600
+            + minute * 60
+            + second
+        );
+    }
+
+    std::string Snapshot::FormatTime(int64_t time) {
+        if (time == 0) {
+            return "";
+        }
+        const auto days = ((time >= 0) ? time : time - 86399) / 86400;
+        const auto secondsOfDay = time - days * 86400;
+        const auto z = days + 719468;
+        const auto era = ((z >= 0) ? z : z - 146096) / 146097;
+        const auto dayOfEra = (unsigned int)(z - era * 146097);
+        const auto yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        const auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        const auto monthPrime = (5 * dayOfYear + 2) / 153;
+        const auto day = dayOfYear - (153 * monthPrime + 2) / 5 + 1;
+        const auto month = ((monthPrime < 10) ? monthPrime + 3 : monthPrime - 9);
+        const auto year = (int64_t)yearOfEra + era * 400 + ((month <= 2) ? 1 : 0);
+        return StringExtensions::sprintf(
+            "%04" PRId64 "-%02u-%02uT%02u:%02u:%02uZ",
+            year,
+            month,
+            day,
+            (unsigned int)(secondsOfDay / 3600),
+            (unsigned int)(secondsOfDay / 60 % 60),
+            (unsigned int)(secondsOfDay % 60)
+        );
+    }
+
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+/**
+ * @file Snapshot.hpp
+ *
+ * This module declares the Twarlock::Snapshot structure.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <stdint.h>
+#include <string>
+#include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <vector>
+
+namespace Twarlock {
+
+    /**
+     * This holds a list of users associated with a channel, such as its
+     * followers or banned users, as downloaded at some point in time.
+     *
+     * Snapshots are saved in a compact binary format: user IDs are sorted
+     * and stored as variable-length differences, each distinct name is
+     * stored only once, and times are stored as 64-bit integers.
+     */
+    struct Snapshot {
+        // Types
+
+        /**
+         * These are the kinds of lists which a snapshot may hold.
+         */
+        enum class Kind {
+            /**
+             * The users are following the channel, and the time of each
+             * entry is when the user followed the channel.
+             */
+            Followers = 1,
+
+            /**
+             * The users are banned from the channel, and the time of each
+             * entry is when the ban expires, or zero if it doesn't.
+             */
+            Bans = 2,
+        };
+
+        /**
+         * This holds information about one user in the list.
+         */
+        struct Entry {
+            /**
+             * This is the ID of the user.
+             */
+            intmax_t userid = 0;
+
+            /**
+             * This is the name of the user.
+             */
+            std::string name;
+
+            /**
+             * This is the time associated with the entry, in seconds
+             * since the UNIX epoch (00:00:00 UTC, January 1, 1970),
+             * or zero if there is none.
+             */
+            int64_t time = 0;
+        };
+
+        // Properties
+
+        /**
+         * This indicates what kind of list the snapshot holds.
+         */
+        Kind kind = Kind::Followers;
+
+        /**
+         * This is the name of the channel with which the list is associated.
+         */
+        std::string channelName;
+
+        /**
+         * This is the ID of the channel with which the list is associated.
+         */
+        intmax_t channelId = 0;
+
+        /**
+         * This is the time the list was downloaded, in seconds since
+         * the UNIX epoch.
+         */
+        int64_t time = 0;
+
+        /**
+         * This is the time the list was last downloaded completely,
+         * in seconds since the UNIX epoch.  This differs from the
+         * time property if the list has since been brought up to date
+         * by downloading only the entries added since then.
+         */
+        int64_t fullSyncTime = 0;
+
+        /**
+         * These are the users in the list.
+         */
+        std::vector< Entry > entries;
+
+        // Methods
+
+        /**
+         * This method saves the snapshot to the file with the given path.
+         * The entries are sorted by user ID as part of saving them.
+         * The snapshot is written to a temporary file first, which then
+         * replaces the file, so that a snapshot saved earlier is never
+         * lost to a save which doesn't finish.
+         *
+         * @param[in] filePath
+         *     This is the path of the file to which to save the snapshot.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the snapshot was saved
+         *     is returned.
+         */
+        bool Save(
+            const std::string& filePath,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        );
+
+        /**
+         * This method replaces the contents of the snapshot with those
+         * loaded from the file with the given path.
+         *
+         * @param[in] filePath
+         *     This is the path of the file from which to load the snapshot.
+         *
+         * @param[in] diagnosticsSender
+         *     This is the object to use to publish any diagnostic messages.
+         *
+         * @return
+         *     An indication of whether or not the snapshot was loaded
+         *     is returned.
+         */
+        bool Load(
+            const std::string& filePath,
+            const SystemAbstractions::DiagnosticsSender& diagnosticsSender
+        );
+
+        /**
+         * This function converts the given time, in the format Twitch
+         * uses (e.g. "2020-04-01T12:34:56Z"), into seconds since
+         * the UNIX epoch.
+         *
+         * @param[in] timestamp
+         *     This is the time to convert.
+         *
+         * @return
+         *     The converted time is returned, or zero if the given
+         *     time could not be parsed.
+         */
+        static int64_t ParseTime(const std::string& timestamp);
+
+        /**
+         * This function converts the given time, in seconds since the
+         * UNIX epoch, into the format Twitch uses
+         * (e.g. "2020-04-01T12:34:56Z").
+         *
+         * @param[in] time
+         *     This is the time to convert.
+         *
+         * @return
+         *     The converted time is returned, or an empty string
+         *     if the given time is zero.
+         */
+        static std::string FormatTime(int64_t time);
+    };
+
+}
@@ -7,25 +7,263 @@
  */
 
 #include "Twitch.hpp"
+#include "CaCerts.hpp"
+#include "RateLimiter.hpp"
+#include "ResponseCache.hpp"
+#include "SchedulerStats.hpp"
+#include "UserIdCache.hpp"
 
-#include <AsyncData/MultiProducerSingleConsumerQueue.hpp>
+#include <algorithm>
 #include <condition_variable>
+#include <ctype.h>
+#include <deque>
 #include <future>
 #include <Http/Client.hpp>
 #include <HttpNetworkTransport/HttpClientNetworkTransport.hpp>
 #include <inttypes.h>
 #include <map>
+#include <math.h>
 #include <memory>
 #include <mutex>
+#include <random>
+#include <set>
 #include <StringExtensions/StringExtensions.hpp>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
 #include <SystemAbstractions/NetworkConnection.hpp>
 #include <thread>
 #include <TlsDecorator/TlsDecorator.hpp>
+#include <vector>
 
 namespace {
 
-    constexpr double twitchApiLookupCooldown = 1.0;
+    /**
+     * This is the number of requests Twitch allows per minute, assumed
+     * until Twitch tells us otherwise in the headers of its responses.
+     */
+    constexpr double defaultRateLimit = 30.0;
+
+    /**
+     * This is the period of time, in seconds, over which the rate limit
+     * applies.
+     */
+    constexpr double rateLimitWindow = 60.0;
+
+    /**
+     * This is the maximum number of bytes of a response body to include
+     * in a diagnostic message, so that large responses aren't copied
+     * just to be logged.
+     */
+    constexpr size_t maxLoggedBodyLength = 1024;
+
+    /**
+     * This is the number of seconds for which a credential rejected by
+     * Twitch is left out when choosing credentials for API calls, if
+     * other credentials are available.
+     */
+    constexpr double credentialRecoveryInterval = 60.0;
+
+    /**
+     * This is the host to which Kraken and Helix API calls are made,
+     * unless configured otherwise.
+     */
+    const char* const defaultApiHost = "api.twitch.tv";
+
+    /**
+     * This is the host to which OAuth2 API calls are made,
+     * unless configured otherwise.
+     */
+    const char* const defaultIdHost = "id.twitch.tv";
+
+    /**
+     * This maps the beginnings of Helix resources to the OAuth scopes
+     * tokens need in order to access them.
+     */
+    const std::vector< std::pair< std::string, std::string > > requiredScopes{
+        {"moderation/", "moderation:read"},
+        {"subscriptions", "channel:read:subscriptions"},
+        {"bits/", "bits:read"},
+    };
+
+    /**
+     * This is the default number of seconds an API call waits in the
+     * queue before it's treated as if it had the next higher priority,
+     * so that lower-priority calls aren't starved.
+     */
+    constexpr double defaultPriorityAgingInterval = 10.0;
+
+    /**
+     * This is the number of different API call priorities.
+     */
+    constexpr size_t numPriorities = 3;
+
+    /**
+     * This is the number of different retry policies, one for each of
+     * the Kraken, Helix and OAuth2 APIs, and one for raw requests.
+     */
+    constexpr size_t numRetryPolicies = 4;
+
+    /**
+     * This holds the settings which determine how an API call is
+     * retried after a transient failure.
+     */
+    struct RetryPolicy {
+        /**
+         * This is the maximum number of times to attempt the call.
+         */
+        unsigned int maxAttempts = 5;
+
+        /**
+         * This is the maximum number of seconds to wait before the
+         * first retry.  The maximum doubles with each retry after that.
+         */
+        double baseDelay = 1.0;
+
+        /**
+         * This is the maximum number of seconds to wait before any retry.
+         */
+        double maxDelay = 60.0;
+    };
+
+    /**
+     * This function updates the given retry policy with any settings
+     * found in the given configuration.
+     *
+     * @param[in] configuration
+     *     This holds any retry policy settings to apply.
+     *
+     * @param[in,out] retryPolicy
+     *     This is the retry policy to update.
+     */
+    void ConfigureRetryPolicy(
+        const Json::Value& configuration,
+        RetryPolicy& retryPolicy
+    ) {
+        if (configuration.Has("maxAttempts")) {
+            retryPolicy.maxAttempts = (unsigned int)std::max((int)configuration["maxAttempts"], 1);
+        }
+        if (configuration.Has("baseDelay")) {
+            retryPolicy.baseDelay = std::max((double)configuration["baseDelay"], 0.0);
+        }
+        if (configuration.Has("maxDelay")) {
+            retryPolicy.maxDelay = std::max((double)configuration["maxDelay"], 0.0);
+        }
+    }
+
+    /**
+     * This is the maximum number of users Twitch will look up
+     * in a single API call.
+     */
+    constexpr size_t maxUserLookupsPerApiCall = 100;
+
+    /**
+     * This function returns a copy of the given string with all
+     * letters converted to lower case.
+     *
+     * @param[in] s
+     *     This is the string to convert.
+     *
+     * @return
+     *     A copy of the given string with all letters converted
+     *     to lower case is returned.
+     */
+    std::string ToLower(const std::string& s) {
+        std::string lower(s);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return lower;
+    }
+
+    /**
+     * This function returns an indication of whether or not the given
+     * string could be the login name of a Twitch user, which is made up
+     * only of lower-case letters, digits and underscores.
+     *
+     * @param[in] login
+     *     This is the string to check.
+     *
+     * @return
+     *     An indication of whether or not the given string could be
+     *     the login name of a Twitch user is returned.
+     */
+    bool IsValidLogin(const std::string& login) {
+        if (login.empty()) {
+            return false;
+        }
+        for (const auto c: login) {
+            if (
+                !(
+                    ((c >= 'a') && (c <= 'z'))
+                    || ((c >= '0') && (c <= '9'))
+                    || (c == '_')
+                )
+            ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * This function returns a copy of the given string with every
+     * character other than letters, digits, '-', '.', '_' and '~'
+     * percent-encoded, so that it can be used as the value of
+     * a parameter in the query of a URI.
+     *
+     * @param[in] s
+     *     This is the string to encode.
+     *
+     * @return
+     *     The encoded string is returned.
+     */
+    std::string PercentEncode(const std::string& s) {
+        static const char* const hexDigits = "0123456789ABCDEF";
+        std::string encoded;
+        for (const auto c: s) {
+            if (
+                isalnum((unsigned char)c)
+                || (c == '-')
+                || (c == '.')
+                || (c == '_')
+                || (c == '~')
+            ) {
+                encoded += c;
+            } else {
+                encoded += '%';
+                encoded += hexDigits[((unsigned char)c >> 4) & 0x0F];
+                encoded += hexDigits[(unsigned char)c & 0x0F];
+            }
+        }
+        return encoded;
+    }
+
+    /**
+     * This function returns an indication of whether or not the given
+     * resource is a page of a list after the first, as identified by
+     * a cursor in its query.  Such resources are practically never
+     * requested twice, so there's no point in caching their responses.
+     *
+     * @param[in] resource
+     *     This is the resource to check.
+     *
+     * @return
+     *     An indication of whether or not the given resource has
+     *     a cursor in its query is returned.
+     */
+    bool HasPageCursor(const std::string& resource) {
+        const auto queryStart = resource.find('?');
+        if (queryStart == std::string::npos) {
+            return false;
+        }
+        for (const auto& parameter: StringExtensions::Split(resource.substr(queryStart + 1), '&')) {
+            if (
+                (parameter.compare(0, 6, "after=") == 0)
+                || (parameter.compare(0, 7, "before=") == 0)
+                || (parameter.compare(0, 7, "cursor=") == 0)
+            ) {
+                return true;
+            }
+        }
+        return false;
+    }
 
     template< typename T > void WithoutLock(
         T& lock,
@@ -44,242 +282,1716 @@ namespace Twarlock {
      * This contains the private properties of a Twitch class instance.
      */
     struct Twitch::Impl {
+        // Types
+
+        /**
+         * This holds everything needed to make an API call, and keeps
+         * track of the call across any attempts made to complete it.
+         */
+        struct ApiCall {
+            Api api = Api::Helix;
+            std::string resource;
+
+            /**
+             * This is called with the body of the response, if the API
+             * call succeeds.
+             */
+            std::function< void(const std::string& body) > onSuccess;
+
+            std::function< void(unsigned int statusCode) > onFailure;
+            Priority priority = Priority::Normal;
+
+            /**
+             * If set, this is called to start the API call, rather than
+             * starting it directly.  This allows the call to be filled in
+             * at the last moment, as is done for batched user lookups.
+             */
+            std::function< void() > start;
+
+            /**
+             * This identifies who made the API call.  The results of
+             * each caller's API calls are delivered in order, without
+             * waiting for the results of anyone else's calls.
+             */
+            size_t caller = 0;
+
+            /**
+             * This is the sequence number of the API call, used to deliver
+             * its results in order, or zero if not yet assigned.
+             */
+            int sequence = 0;
+
+            /**
+             * This is the number of attempts made so far to complete
+             * the API call.
+             */
+            unsigned int attempt = 0;
+
+            /**
+             * This is the time at which the API call was last queued.
+             */
+            double queueTime = 0.0;
+
+            /**
+             * If scheduler statistics are being kept, this is the time,
+             * according to SchedulerStats::Now, at which the API call
+             * was first queued.
+             */
+            double postTime = 0.0;
+        };
+
+        /**
+         * This holds one set of credentials used to make API calls,
+         * along with what's needed to spread API calls across them.
+         */
+        struct Credential {
+            std::string clientId;
+            std::string oauthToken;
+
+            /**
+             * These are the OAuth scopes granted to the token.  If empty,
+             * the scopes are not known, and the token is assumed to have
+             * any scope needed.
+             */
+            std::set< std::string > scopes;
+
+            /**
+             * This is used to pace API calls made with these credentials
+             * so that their rate limit is not exceeded.
+             */
+            RateLimiter rateLimiter;
+
+            /**
+             * This is the number of API calls made with these credentials
+             * which have been started but have not yet completed.
+             */
+            size_t apiCallsInProgress = 0;
+
+            /**
+             * This is the time until which these credentials are left out,
+             * after being rejected by Twitch.
+             */
+            double disabledUntil = 0.0;
+
+            /**
+             * This is the number of HTTP requests made with these
+             * credentials.
+             */
+            size_t requestsMade = 0;
+        };
+
+        /**
+         * This holds what's needed to deliver the results of one caller's
+         * API calls in the order the calls were started.
+         */
+        struct Caller {
+            /**
+             * This holds the callbacks of API calls which have completed
+             * but are waiting for earlier API calls to complete.  A call
+             * waiting to be retried leaves a null callback in its place,
+             * and takes a new place when it's started again.
+             *
+             * The keys are the API call sequence numbers.
+             */
+            std::map< int, std::function< void() > > completedApiCalls;
+
+            /**
+             * This is the sequence number of the next API call whose
+             * results should be delivered.
+             */
+            int nextApiCallToComplete = 1;
+
+            /**
+             * This is the sequence number to assign to the next API call
+             * started.
+             */
+            int nextApiCallToStart = 1;
+        };
+
         // Properties
 
-        bool apiCallInProgress = false;
-        AsyncData::MultiProducerSingleConsumerQueue< std::function< void() > > apiCalls;
-        std::string caCerts;
-        Json::Value configuration;
-        SystemAbstractions::DiagnosticsSender diagnosticsSender;
-        std::shared_ptr< Http::Client > httpClient = std::make_shared< Http::Client >();
+        /**
+         * This holds the API calls waiting to be started, with one
+         * queue per priority, highest priority first.
+         */
+        std::deque< std::shared_ptr< ApiCall > > apiCalls[numPriorities];
+
+        /**
+         * This holds the API calls which have been started but have not
+         * yet completed.
+         *
+         * The keys are the same unique identifiers used as the keys of
+         * the httpClientTransactions collection.
+         */
+        std::map< int, std::shared_ptr< ApiCall > > apiCallsInFlight;
+
+        /**
+         * This is the number of API calls which have been started
+         * but have not yet completed.
+         */
+        size_t apiCallsInProgress = 0;
+
+        /**
+         * This holds the certificates of the certificate authorities
+         * to trust when connecting to Twitch.  It's prepared once,
+         * when the object is mobilized, and shared by every connection.
+         */
+        std::shared_ptr< const std::string > caCerts;
+
+        /**
+         * This is the host (optionally followed by a colon and port
+         * number) to which Kraken and Helix API calls are made.
+         * It's normally Twitch's, but may be configured to point
+         * somewhere else, such as a local stand-in for Twitch.
+         */
+        std::string apiHost;
+
+        /**
+         * This is the host (optionally followed by a colon and port
+         * number) to which OAuth2 API calls are made.  It's normally
+         * Twitch's, but may be configured to point somewhere else,
+         * such as a local stand-in for Twitch.
+         */
+        std::string idHost;
+
+        /**
+         * These are the credentials used to make API calls.  The first
+         * one is used for any API call which doesn't go to Kraken or Helix.
+         */
+        std::vector< Credential > credentials;
+
+        /**
+         * This indicates whether or not all API calls have been cancelled,
+         * in which case any further API calls fail immediately.
+         */
+        bool cancelled = false;
+
+        /**
+         * This holds the results of API calls waiting to be delivered,
+         * for each caller which has API calls in progress.
+         *
+         * The keys are the identifiers of the callers.
+         */
+        std::map< size_t, Caller > callers;
+
+        Json::Value configuration;
+
+        /**
+         * This holds onto the network connections made to each server,
+         * so that the number of connections kept alive in the pool
+         * maintained by the HTTP client can be reported.
+         *
+         * The keys are server names.  The values are the connections
+         * made to the server, which may or may not still be alive.
+         */
+        std::map< std::string, std::vector< std::weak_ptr< SystemAbstractions::INetworkConnection > > > connectionsByServer;
+
+        /**
+         * This is the number of network connections made to Twitch.
+         */
+        size_t connectionsMade = 0;
+
+        /**
+         * This holds API calls which failed and are waiting to be retried.
+         *
+         * The keys are the times at which to retry the calls.
+         */
+        std::multimap< double, std::shared_ptr< ApiCall > > delayedApiCalls;
+
+        SystemAbstractions::DiagnosticsSender diagnosticsSender;
+        std::shared_ptr< Http::Client > httpClient = std::make_shared< Http::Client >();
+
+        /**
+         * If not null, this is the transport to use to make API calls,
+         * rather than connecting to Twitch over the network.
+         */
+        std::shared_ptr< Http::IClientTransport > transport;
+
+        /**
+         * This holds onto pending HTTP request transactions being made.
+         *
+         * The keys are unique identifiers.  The values are the transactions.
+         */
+        std::map< int, std::shared_ptr< Http::IClient::Transaction > > httpClientTransactions;
+
+        /**
+         * This is the number of seconds an API call waits in the queue
+         * before it's treated as if it had the next higher priority.
+         */
+        double priorityAgingInterval = defaultPriorityAgingInterval;
+
+        /**
+         * This is the maximum number of API calls which may be
+         * in progress at the same time.
+         */
+        size_t maxConcurrentRequests = 1;
+
+        std::recursive_mutex mutex;
+
+        /**
+         * This is the identifier to give the next caller which asks for
+         * one.  Zero is left for callers which don't.
+         */
+        size_t nextCaller = 1;
+
+        /**
+         * This is used to select unique identifiers as keys for the
+         * httpClientTransactions collection.  It is incremented each
+         * time a key is selected.
+         */
+        int nextHttpClientTransactionId = 1;
+
+        /**
+         * This is the number of HTTP requests made to Twitch.  Requests
+         * beyond the number of connections made reused a connection
+         * kept alive from an earlier request.
+         */
+        size_t requestsMade = 0;
+
+        /**
+         * This is used to generate the random jitter added to the delays
+         * before API calls are retried.
+         */
+        std::mt19937 randomGenerator;
+
+        /**
+         * This holds onto responses to API calls, so that they can be
+         * reused or revalidated rather than downloaded again.
+         */
+        ResponseCache responseCache;
+
+        std::weak_ptr< Impl > selfWeak;
+        bool stopWorker = false;
+        std::shared_ptr< Http::TimeKeeper > timeKeeper;
+        std::condition_variable_any wakeWorker;
+        std::thread worker;
+
+        /**
+         * This holds the promises made to callers waiting for the IDs
+         * of users to be looked up.  Lookups from all callers are
+         * collected here and made together, in batches.
+         *
+         * The keys are user login names, in lower case.  The values
+         * are the promises to fulfill once the user IDs are known.
+         */
+        std::map< std::string, std::vector< std::shared_ptr< std::promise< intmax_t > > > > userIdLookupsPending;
+
+        /**
+         * This indicates whether or not an API call to look up the
+         * user IDs in userIdLookupsPending is in the queue.
+         */
+        bool userIdLookupQueued = false;
+
+        /**
+         * This remembers the IDs of users looked up before, so that
+         * they don't need to be looked up again.
+         */
+        UserIdCache userIdCache;
+
+        /**
+         * This indicates whether or not statistics about how well API
+         * calls are scheduled are kept and reported.
+         */
+        bool schedulerStatsEnabled = false;
+
+        /**
+         * These are the statistics kept about how well API calls
+         * are scheduled, if enabled.
+         */
+        SchedulerStats schedulerStats;
+
+        /**
+         * These determine how API calls are retried after transient
+         * failures.  There is one for each of the Kraken, Helix and OAuth2
+         * APIs, and one for raw requests.
+         */
+        RetryPolicy retryPolicies[numRetryPolicies];
+
+        // Lifecycle
+
+        ~Impl() {
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            Demobilize(lock);
+        }
+        Impl(const Impl&) = delete;
+        Impl(Impl&&) = delete;
+        Impl& operator=(const Impl&) = delete;
+        Impl& operator=(Impl&&) = delete;
+
+        // Methods
+
+        Impl()
+            : diagnosticsSender("Twitch")
+            , randomGenerator(std::random_device()())
+        {
+        }
+
+        /**
+         * This method returns an indication of whether or not any
+         * subscriber wants diagnostic messages at the given level.
+         * It's used to avoid the cost of formatting messages on the
+         * hot path, such as those carrying whole response bodies,
+         * which no one would receive.
+         *
+         * @param[in] level
+         *     This is the level of the message to be published.
+         *
+         * @return
+         *     An indication of whether or not any subscriber wants
+         *     diagnostic messages at the given level is returned.
+         */
+        bool IsDiagnosticsLevelWanted(size_t level) const {
+            return (level >= diagnosticsSender.GetMinLevel());
+        }
+
+        /**
+         * This method fails any API call which is waiting to be started,
+         * waiting to be retried, or in progress, as well as any user ID
+         * lookups which haven't been made yet.  Http::Client has no way
+         * to abort a transaction, so the connections made to Twitch are
+         * closed instead, and responses to any transactions already sent
+         * are ignored.
+         */
+        void Cancel() {
+            cancelled = true;
+            std::vector< std::shared_ptr< ApiCall > > droppedApiCalls;
+            for (auto& queue: apiCalls) {
+                for (auto& apiCall: queue) {
+                    droppedApiCalls.push_back(std::move(apiCall));
+                }
+                queue.clear();
+            }
+            for (auto& delayedApiCallsEntry: delayedApiCalls) {
+                droppedApiCalls.push_back(std::move(delayedApiCallsEntry.second));
+            }
+            delayedApiCalls.clear();
+            for (auto& apiCallsInFlightEntry: apiCallsInFlight) {
+                droppedApiCalls.push_back(std::move(apiCallsInFlightEntry.second));
+            }
+            apiCallsInFlight.clear();
+            httpClientTransactions.clear();
+            for (const auto& connectionsByServerEntry: connectionsByServer) {
+                for (const auto& connectionWeak: connectionsByServerEntry.second) {
+                    const auto connection = connectionWeak.lock();
+                    if (connection != nullptr) {
+                        connection->Close(false);
+                    }
+                }
+            }
+            connectionsByServer.clear();
+            apiCallsInProgress = 0;
+            for (auto& credential: credentials) {
+                credential.apiCallsInProgress = 0;
+            }
+            for (const auto& apiCall: droppedApiCalls) {
+                if (apiCall->onFailure == nullptr) {
+                    continue;
+                }
+                const auto onFailure = apiCall->onFailure;
+                GetCompletedApiCall(*apiCall) = [onFailure]{
+                    onFailure(0);
+                };
+            }
+            for (const auto& userIdLookupsPendingEntry: userIdLookupsPending) {
+                for (const auto& promise: userIdLookupsPendingEntry.second) {
+                    promise->set_value(0);
+                }
+            }
+            userIdLookupsPending.clear();
+            userIdLookupQueued = false;
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                "Cancelled %zu API calls",
+                droppedApiCalls.size()
+            );
+            std::vector< size_t > callersWithResults;
+            for (const auto& callersEntry: callers) {
+                callersWithResults.push_back(callersEntry.first);
+            }
+            for (const auto caller: callersWithResults) {
+                DeliverCompletedApiCalls(caller);
+            }
+        }
+
+        void Demobilize(std::unique_lock< decltype(mutex) >& lock) {
+            if (!worker.joinable()) {
+                return;
+            }
+            stopWorker = true;
+            wakeWorker.notify_one();
+            if (std::this_thread::get_id() == worker.get_id()) {
+                worker.detach();
+            } else {
+                WithoutLock(lock, [this]{ worker.join(); });
+            }
+        }
+
+        void Mobilize(
+            Json::Value&& configuration,
+            std::string&& caCerts,
+            std::shared_ptr< Http::TimeKeeper >&& timeKeeper
+        ) {
+            if (worker.joinable()) {
+                return;
+            }
+            this->configuration = std::move(configuration);
+            maxConcurrentRequests = 1;
+            if (this->configuration.Has("maxConcurrentRequests")) {
+                const int configuredMaxConcurrentRequests = this->configuration["maxConcurrentRequests"];
+                if (configuredMaxConcurrentRequests > 1) {
+                    maxConcurrentRequests = (size_t)configuredMaxConcurrentRequests;
+                }
+            }
+            size_t numCaCerts = 0;
+            auto extractedCaCerts = ExtractCaCerts(caCerts, numCaCerts);
+            if (numCaCerts == 0) {
+                // Rather than trust nothing at all, hand the bundle to
+                // the TLS library as it is, in case it can make more
+                // sense of it.  This isn't a concern when a transport
+                // was given in place of connecting to Twitch.
+                if (transport == nullptr) {
+                    diagnosticsSender.SendDiagnosticInformationString(
+                        SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                        "No PEM-encoded certificates found in CA certificate bundle; using it as is"
+                    );
+                }
+                extractedCaCerts = caCerts;
+            } else {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    1,
+                    "Loaded %zu CA certificates (%zu of %zu bytes kept)",
+                    numCaCerts,
+                    extractedCaCerts.length(),
+                    caCerts.length()
+                );
+            }
+            this->caCerts = std::make_shared< const std::string >(
+                std::move(extractedCaCerts)
+            );
+            this->timeKeeper = timeKeeper;
+            ConfigureCredentials();
+            apiHost = defaultApiHost;
+            if (this->configuration.Has("apiHost")) {
+                apiHost = (std::string)this->configuration["apiHost"];
+            }
+            idHost = defaultIdHost;
+            if (this->configuration.Has("idHost")) {
+                idHost = (std::string)this->configuration["idHost"];
+            }
+            priorityAgingInterval = defaultPriorityAgingInterval;
+            if (this->configuration.Has("priorityAgingInterval")) {
+                priorityAgingInterval = (double)this->configuration["priorityAgingInterval"];
+            }
+            const auto& retryConfiguration = this->configuration["retry"];
+            static const char* const retryPolicyNames[numRetryPolicies] = {
+                "kraken",
+                "helix",
+                "oauth2",
+                "raw",
+            };
+            for (size_t i = 0; i < numRetryPolicies; ++i) {
+                retryPolicies[i] = RetryPolicy();
+                ConfigureRetryPolicy(retryConfiguration, retryPolicies[i]);
+                ConfigureRetryPolicy(retryConfiguration[retryPolicyNames[i]], retryPolicies[i]);
+            }
+            responseCache.Configure(this->configuration["responseCache"]);
+            schedulerStatsEnabled = (
+                this->configuration.Has("schedulerStats")
+                && (bool)this->configuration["schedulerStats"]
+            );
+            schedulerStats = SchedulerStats();
+            if (this->configuration.Has("userIdCache")) {
+                const std::string userIdCachePath = this->configuration["userIdCache"];
+                double userIdCacheTimeToLive = 0.0;
+                if (this->configuration.Has("userIdCacheTimeToLive")) {
+                    userIdCacheTimeToLive = (double)this->configuration["userIdCacheTimeToLive"];
+                }
+                if (
+                    !userIdCache.Open(
+                        userIdCachePath,
+                        userIdCacheTimeToLive,
+                        this->timeKeeper->GetCurrentTime()
+                    )
+                ) {
+                    diagnosticsSender.SendDiagnosticInformationFormatted(
+                        SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                        "Unable to update user ID cache file '%s'",
+                        userIdCachePath.c_str()
+                    );
+                }
+            }
+            stopWorker = false;
+            worker = std::thread(&Impl::Worker, this);
+        }
+
+        /**
+         * This method sets up the credentials used to make API calls.
+         * The "clientId" and "oauthToken" configuration items, if given,
+         * make up the first credentials, followed by any listed in the
+         * "credentials" configuration item.
+         */
+        void ConfigureCredentials() {
+            credentials.clear();
+            double rateLimit = defaultRateLimit;
+            if (configuration.Has("rateLimit")) {
+                rateLimit = (int)configuration["rateLimit"];
+            }
+            const auto now = timeKeeper->GetCurrentTime();
+            const auto addCredential = [&](const Json::Value& credentialConfiguration){
+                Credential credential;
+                if (credentialConfiguration.Has("clientId")) {
+                    credential.clientId = (std::string)credentialConfiguration["clientId"];
+                } else {
+                    credential.clientId = (std::string)configuration["clientId"];
+                }
+                credential.oauthToken = (std::string)credentialConfiguration["oauthToken"];
+                for (const auto& existingCredential: credentials) {
+                    if (
+                        (existingCredential.clientId == credential.clientId)
+                        && (existingCredential.oauthToken == credential.oauthToken)
+                    ) {
+                        return;
+                    }
+                }
+                const auto& scopes = credentialConfiguration["scopes"];
+                for (size_t i = 0; i < scopes.GetSize(); ++i) {
+                    (void)credential.scopes.insert(scopes[i]);
+                }
+                auto credentialRateLimit = rateLimit;
+                if (credentialConfiguration.Has("rateLimit")) {
+                    credentialRateLimit = (int)credentialConfiguration["rateLimit"];
+                }
+                credential.rateLimiter.Configure(
+                    credentialRateLimit,
+                    rateLimitWindow,
+                    now
+                );
+                credentials.push_back(std::move(credential));
+            };
+            if (
+                configuration.Has("clientId")
+                || configuration.Has("oauthToken")
+            ) {
+                addCredential(configuration);
+            }
+            const auto& credentialsConfiguration = configuration["credentials"];
+            for (size_t i = 0; i < credentialsConfiguration.GetSize(); ++i) {
+                addCredential(credentialsConfiguration[i]);
+            }
+            if (credentials.empty()) {
+                addCredential(configuration);
+            }
+            if (credentials.size() > 1) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    1,
+                    "Spreading API calls across %zu credentials",
+                    credentials.size()
+                );
+            }
+        }
+
+        /**
+         * This method returns an indication of whether or not the given
+         * API is one whose calls are spread across all the credentials,
+         * rather than always made with the first ones.
+         *
+         * @param[in] api
+         *     This is the API to check.
+         *
+         * @return
+         *     An indication of whether or not calls to the given API
+         *     are spread across all the credentials is returned.
+         */
+        bool IsPooledApi(Api api) const {
+            return (
+                (credentials.size() > 1)
+                && (
+                    (api == Api::Kraken)
+                    || (api == Api::Helix)
+                )
+            );
+        }
+
+        /**
+         * This method returns the OAuth scope tokens need in order to
+         * make the given API call.
+         *
+         * @param[in] apiCall
+         *     This is the API call to make.
+         *
+         * @return
+         *     The scope needed to make the API call is returned, or an
+         *     empty string if it doesn't need any particular scope.
+         */
+        std::string GetRequiredScope(const ApiCall& apiCall) const {
+            if (apiCall.api == Api::Helix) {
+                for (const auto& requiredScopesEntry: requiredScopes) {
+                    if (apiCall.resource.compare(0, requiredScopesEntry.first.length(), requiredScopesEntry.first) == 0) {
+                        return requiredScopesEntry.second;
+                    }
+                }
+            }
+            return "";
+        }
+
+        /**
+         * This method returns the indices of the credentials which may
+         * be used to make the given API call.  Calls which aren't spread
+         * across the credentials may only use the first ones.  Other calls
+         * may use any credentials having the scope the call needs, or any
+         * credentials at all if none are known to have it, leaving out
+         * credentials recently rejected by Twitch unless no others remain.
+         *
+         * @param[in] apiCall
+         *     This is the API call to make.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The indices of the credentials which may be used to make
+         *     the given API call are returned.
+         */
+        std::vector< size_t > GetCandidateCredentials(
+            const ApiCall& apiCall,
+            double now
+        ) const {
+            std::vector< size_t > candidates;
+            if (!IsPooledApi(apiCall.api)) {
+                candidates.push_back(0);
+                return candidates;
+            }
+            const auto requiredScope = GetRequiredScope(apiCall);
+            for (size_t i = 0; i < credentials.size(); ++i) {
+                const auto& credential = credentials[i];
+                if (
+                    requiredScope.empty()
+                    || credential.scopes.empty()
+                    || (credential.scopes.find(requiredScope) != credential.scopes.end())
+                ) {
+                    candidates.push_back(i);
+                }
+            }
+            if (candidates.empty()) {
+                candidates.push_back(0);
+                return candidates;
+            }
+            std::vector< size_t > enabledCandidates;
+            for (const auto i: candidates) {
+                if (credentials[i].disabledUntil <= now) {
+                    enabledCandidates.push_back(i);
+                }
+            }
+            if (enabledCandidates.empty()) {
+                return candidates;
+            }
+            return enabledCandidates;
+        }
+
+        /**
+         * This method chooses which credentials to use to make the given
+         * API call.  Of the credentials which may be used for the call,
+         * the ones with the most requests left in their rate limit are
+         * chosen, as long as they have at least one request left.
+         *
+         * @param[in] apiCall
+         *     This is the API call to make.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The index of the credentials to use is returned.  If no
+         *     credentials may be used for the call right now, the number
+         *     of credentials is returned instead.
+         */
+        size_t ChooseCredential(
+            const ApiCall& apiCall,
+            double now
+        ) {
+            size_t bestCredential = credentials.size();
+            double bestTokens = 0.0;
+            for (const auto i: GetCandidateCredentials(apiCall, now)) {
+                const auto tokens = credentials[i].rateLimiter.GetAvailableTokens(now);
+                if (
+                    (tokens >= 1.0)
+                    && (
+                        (bestCredential == credentials.size())
+                        || (tokens > bestTokens)
+                    )
+                ) {
+                    bestCredential = i;
+                    bestTokens = tokens;
+                }
+            }
+            return bestCredential;
+        }
+
+        /**
+         * This method returns the time at which the rate limit of any
+         * of the credentials which may be used to make the given API call
+         * will next allow the call to be made.
+         *
+         * @param[in] apiCall
+         *     This is the API call to make.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The time at which the API call can next be made is returned.
+         *     This is the given current time if it can be made now.
+         */
+        double GetNextTokenTime(
+            const ApiCall& apiCall,
+            double now
+        ) {
+            double nextTokenTime = 0.0;
+            for (const auto i: GetCandidateCredentials(apiCall, now)) {
+                const auto credentialNextTokenTime = credentials[i].rateLimiter.GetNextTokenTime(now);
+                if (
+                    (nextTokenTime == 0.0)
+                    || (credentialNextTokenTime < nextTokenTime)
+                ) {
+                    nextTokenTime = credentialNextTokenTime;
+                }
+            }
+            return nextTokenTime;
+        }
+
+        /**
+         * This method returns an indication of whether or not any of the
+         * credentials has a request left in its rate limit.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     An indication of whether or not any of the credentials
+         *     has a request left in its rate limit is returned.
+         */
+        bool HasAvailableTokens(double now) {
+            for (auto& credential: credentials) {
+                if (credential.rateLimiter.GetAvailableTokens(now) >= 1.0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * This method returns the earliest time at which the rate limit
+         * of any of the credentials will allow another request.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The earliest time at which any of the credentials may be
+         *     used to make another request is returned.
+         */
+        double GetEarliestTokenTime(double now) {
+            double earliestTokenTime = 0.0;
+            for (auto& credential: credentials) {
+                const auto credentialNextTokenTime = credential.rateLimiter.GetNextTokenTime(now);
+                if (
+                    (earliestTokenTime == 0.0)
+                    || (credentialNextTokenTime < earliestTokenTime)
+                ) {
+                    earliestTokenTime = credentialNextTokenTime;
+                }
+            }
+            return earliestTokenTime;
+        }
+
+        /**
+         * This method returns an indication of whether or not the response
+         * to the given API call may be answered from, or stored in,
+         * the response cache.
+         *
+         * @param[in] apiCall
+         *     This is the API call to check.
+         *
+         * @return
+         *     An indication of whether or not the response to the given
+         *     API call may be cached is returned.
+         */
+        bool IsCacheable(const ApiCall& apiCall) const {
+            return (
+                responseCache.IsEnabled()
+                && (apiCall.api != Api::RawPost)
+                && (apiCall.priority != Priority::Bulk)
+                && !HasPageCursor(apiCall.resource)
+            );
+        }
+
+        /**
+         * This method returns an indication of whether or not the response
+         * to the given API call is the same whichever credentials are
+         * used to make it.  This is assumed of any call which may be made
+         * with any of the pooled credentials, since they're used
+         * interchangeably for it anyway.
+         *
+         * @param[in] apiCall
+         *     This is the API call to check.
+         *
+         * @return
+         *     An indication of whether or not the response to the given
+         *     API call is the same for all credentials is returned.
+         */
+        bool IsSharedResponse(const ApiCall& apiCall) const {
+            return (
+                IsPooledApi(apiCall.api)
+                && GetRequiredScope(apiCall).empty()
+            );
+        }
+
+        /**
+         * This method returns the host to which calls to the given API
+         * are made.  Raw API calls carry their host in their resource,
+         * so an empty string is returned for them.
+         *
+         * @param[in] api
+         *     This is the API whose host is needed.
+         *
+         * @return
+         *     The host to which calls to the given API are made
+         *     is returned.
+         */
+        const std::string& GetHost(Api api) const {
+            static const std::string noHost;
+            switch (api) {
+                case Api::Kraken:
+                case Api::Helix: {
+                    return apiHost;
+                }
+
+                case Api::OAuth2: {
+                    return idHost;
+                }
+
+                default: {
+                    return noHost;
+                }
+            }
+        }
+
+        /**
+         * This method returns the key under which the given user's ID
+         * is cached.  IDs looked up from anywhere other than Twitch
+         * (such as a local stand-in for Twitch) are kept apart from
+         * the real ones.
+         *
+         * @param[in] login
+         *     This is the login name of the user.
+         *
+         * @return
+         *     The key under which the user's ID is cached is returned.
+         */
+        std::string GetUserIdCacheKey(const std::string& login) const {
+            if (apiHost == defaultApiHost) {
+                return login;
+            }
+            return apiHost + "/" + login;
+        }
+
+        /**
+         * This method returns the key under which the response to the
+         * given API call, made with the given credentials, is cached.
+         * Responses which are the same for all credentials are keyed
+         * without them, so that they're shared by all.
+         *
+         * @param[in] apiCall
+         *     This is the API call whose response is cached.
+         *
+         * @param[in] credentialIndex
+         *     This is the index of the credentials used to make the call.
+         *
+         * @return
+         *     The key under which the response is cached is returned.
+         */
+        std::string GetCacheKey(
+            const ApiCall& apiCall,
+            size_t credentialIndex
+        ) const {
+            const auto& host = GetHost(apiCall.api);
+            if (IsSharedResponse(apiCall)) {
+                return StringExtensions::sprintf(
+                    "%d %s %s",
+                    (int)apiCall.api,
+                    host.c_str(),
+                    apiCall.resource.c_str()
+                );
+            }
+            const auto& credential = credentials[credentialIndex];
+            return StringExtensions::sprintf(
+                "%d %s %s %zx",
+                (int)apiCall.api,
+                host.c_str(),
+                apiCall.resource.c_str(),
+                std::hash< std::string >()(
+                    credential.clientId
+                    + " "
+                    + credential.oauthToken
+                )
+            );
+        }
+
+        /**
+         * This method puts aside the given API call, which failed,
+         * to be made again at the given time.
+         *
+         * The call gives up its place in the order in which results are
+         * delivered, and is given a new place when it's started again,
+         * so that the results of calls started after it aren't held back
+         * while it waits.
+         *
+         * @param[in] apiCall
+         *     This is the API call to make again.
+         *
+         * @param[in] retryTime
+         *     This is the time at which to make the API call again.
+         */
+        void DelayApiCall(
+            std::shared_ptr< ApiCall > apiCall,
+            double retryTime
+        ) {
+            const auto caller = apiCall->caller;
+            if (apiCall->sequence != 0) {
+                GetCompletedApiCall(*apiCall) = nullptr;
+                apiCall->sequence = 0;
+            }
+            (void)delayedApiCalls.insert({retryTime, std::move(apiCall)});
+            DeliverCompletedApiCalls(caller);
+        }
+
+        /**
+         * This method gives the given API call its place in the order
+         * in which the results of its caller's API calls are delivered,
+         * if it doesn't have one already.
+         *
+         * @param[in,out] apiCall
+         *     This is the API call whose results are to be delivered.
+         */
+        void AssignSequence(ApiCall& apiCall) {
+            if (apiCall.sequence == 0) {
+                apiCall.sequence = callers[apiCall.caller].nextApiCallToStart++;
+            }
+        }
+
+        /**
+         * This method gives the given API call its place in the order
+         * in which the results of its caller's API calls are delivered,
+         * if it doesn't have one already, and returns where to store the
+         * function which delivers its results.
+         *
+         * @param[in,out] apiCall
+         *     This is the API call whose results are to be delivered.
+         *
+         * @return
+         *     A reference to where to store the function which delivers
+         *     the results of the API call is returned.
+         */
+        std::function< void() >& GetCompletedApiCall(ApiCall& apiCall) {
+            AssignSequence(apiCall);
+            return callers[apiCall.caller].completedApiCalls[apiCall.sequence];
+        }
+
+        /**
+         * This method delivers the results of the given caller's API calls
+         * which have completed, up to the first one still in progress.
+         *
+         * @param[in] callerId
+         *     This identifies the caller whose results to deliver.
+         */
+        void DeliverCompletedApiCalls(size_t callerId) {
+            for (;;) {
+                // The caller is looked up again each time, since the
+                // callbacks may post or complete other API calls.
+                auto callersEntry = callers.find(callerId);
+                if (callersEntry == callers.end()) {
+                    break;
+                }
+                auto& caller = callersEntry->second;
+                auto completedApiCallsEntry = caller.completedApiCalls.find(caller.nextApiCallToComplete);
+                if (completedApiCallsEntry == caller.completedApiCalls.end()) {
+                    if (
+                        caller.completedApiCalls.empty()
+                        && (caller.nextApiCallToComplete == caller.nextApiCallToStart)
+                    ) {
+                        (void)callers.erase(callersEntry);
+                    }
+                    break;
+                }
+                const auto callback = std::move(completedApiCallsEntry->second);
+                (void)caller.completedApiCalls.erase(completedApiCallsEntry);
+                ++caller.nextApiCallToComplete;
+                if (callback == nullptr) {
+                    // This place was given up by an API call which is
+                    // waiting to be retried.
+                    continue;
+                }
+                if (schedulerStatsEnabled) {
+                    const auto callbackStart = SchedulerStats::Now();
+                    callback();
+                    const auto callbackEnd = SchedulerStats::Now();
+                    schedulerStats.RecordCallback(callbackEnd - callbackStart, callbackEnd);
+                } else {
+                    callback();
+                }
+            }
+        }
+
+        /**
+         * This method starts the given API call, or completes it right
+         * away if it can be answered from the response cache.  If none of
+         * the credentials which may be used to make the call has a request
+         * left in its rate limit, the call isn't started, and should
+         * be queued again.
+         *
+         * @param[in] apiCall
+         *     This is the API call to start.
+         *
+         * @return
+         *     An indication of whether or not the API call was started
+         *     or completed is returned.
+         */
+        bool StartApiCall(std::shared_ptr< ApiCall > apiCall) {
+            const auto api = apiCall->api;
+            const auto& resource = apiCall->resource;
+            const auto& onSuccess = apiCall->onSuccess;
+            const auto& onFailure = apiCall->onFailure;
+            Http::Request request;
+            std::string targetUriString;
+            switch (api) {
+                case Api::Kraken: {
+                    targetUriString = std::string("https://") + apiHost + "/kraken/" + resource;
+                    request.headers.SetHeader("Accept", "application/vnd.twitchtv.v5+json");
+                } break;
+
+                case Api::Helix: {
+                    targetUriString = std::string("https://") + apiHost + "/helix/" + resource;
+                } break;
+
+                case Api::OAuth2: {
+                    targetUriString = std::string("https://") + idHost + "/oauth2/" + resource;
+                } break;
+
+                case Api::RawGet:
+                case Api::RawPost: {
+                    targetUriString = std::string("https://") + resource;
+                } break;
+
+                default: {
+                    diagnosticsSender.SendDiagnosticInformationFormatted(
+                        SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                        "Unknown API requested for: %s",
+                        resource.c_str()
+                    );
+                    GetCompletedApiCall(*apiCall) = [onFailure]{
+                        onFailure(400);
+                    };
+                    DeliverCompletedApiCalls(apiCall->caller);
+                    return true;
+                } break;
+            }
+            const auto now = timeKeeper->GetCurrentTime();
+            const auto cacheable = IsCacheable(*apiCall);
+            if (cacheable) {
+                // A fresh response is given right away, without waiting
+                // for credentials with a request left in their rate limit.
+                // Responses which depend on the credentials are looked up
+                // under each set of credentials which could make the call.
+                std::vector< size_t > cacheCredentials;
+                if (IsSharedResponse(*apiCall)) {
+                    cacheCredentials.push_back(0);
+                } else {
+                    cacheCredentials = GetCandidateCredentials(*apiCall, now);
+                }
+                for (const auto i: cacheCredentials) {
+                    ResponseCache::Entry entry;
+                    if (
+                        responseCache.Find(GetCacheKey(*apiCall, i), entry)
+                        && (now - entry.time < responseCache.GetMaxAge(resource))
+                    ) {
+                        const auto body = std::move(entry.body);
+                        GetCompletedApiCall(*apiCall) = [onSuccess, body]{
+                            onSuccess(*body);
+                        };
+                        DeliverCompletedApiCalls(apiCall->caller);
+                        return true;
+                    }
+                }
+            }
+            const auto credentialIndex = ChooseCredential(*apiCall, now);
+            if (credentialIndex == credentials.size()) {
+                return false;
+            }
+            auto& credential = credentials[credentialIndex];
+            std::string cacheKey;
+            std::shared_ptr< ResponseCache::Entry > cachedResponse;
+            if (cacheable) {
+                // A stale response is kept so that it can be revalidated.
+                cacheKey = GetCacheKey(*apiCall, credentialIndex);
+                ResponseCache::Entry entry;
+                if (responseCache.Find(cacheKey, entry)) {
+                    cachedResponse = std::make_shared< ResponseCache::Entry >(std::move(entry));
+                }
+            }
+            if (!credential.rateLimiter.Acquire(now)) {
+                return false;
+            }
+            AssignSequence(*apiCall);
+            ++apiCall->attempt;
+            ++credential.apiCallsInProgress;
+            ++credential.requestsMade;
+            ++apiCallsInProgress;
+            const auto id = nextHttpClientTransactionId++;
+            if (IsDiagnosticsLevelWanted(0)) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    0,
+                    "Twitch API call %d request: %s",
+                    id,
+                    targetUriString.c_str()
+                );
+            }
+            if (api == Api::RawPost) {
+                request.method = "POST";
+            } else {
+                request.method = "GET";
+            }
+            request.target.ParseFromString(targetUriString);
+            if (!request.target.HasPort()) {
+                request.target.SetPort(443);
+            }
+            if (
+                (api != Api::OAuth2)
+                && (api != Api::RawGet)
+                && (api != Api::RawPost)
+            ) {
+                request.headers.SetHeader("Client-ID", credential.clientId);
+            }
+            if (!credential.oauthToken.empty()) {
+                const auto& oauthToken = credential.oauthToken;
+                if (IsDiagnosticsLevelWanted(0)) {
+                    diagnosticsSender.SendDiagnosticInformationFormatted(
+                        0,
+                        "Using OAuth token: %s",
+                        oauthToken.c_str()
+                    );
+                }
+                switch (api) {
+                    case Api::Helix: {
+                        request.headers.SetHeader(
+                            "Authorization",
+                            StringExtensions::sprintf(
+                                "Bearer %s",
+                                oauthToken.c_str()
+                            )
+                        );
+                    } break;
+
+                    case Api::Kraken:
+                    case Api::OAuth2: {
+                        request.headers.SetHeader(
+                            "Authorization",
+                            StringExtensions::sprintf(
+                                "OAuth %s",
+                                oauthToken.c_str()
+                            )
+                        );
+                    } break;
+
+                    default: {
+                    } break;
+                }
+            }
+            if (cachedResponse != nullptr) {
+                if (!cachedResponse->etag.empty()) {
+                    request.headers.SetHeader("If-None-Match", cachedResponse->etag);
+                }
+                if (!cachedResponse->lastModified.empty()) {
+                    request.headers.SetHeader("If-Modified-Since", cachedResponse->lastModified);
+                }
+            }
+            apiCallsInFlight[id] = apiCall;
+            auto& httpClientTransaction = httpClientTransactions[id];
+            httpClientTransaction = httpClient->Request(request, true);
+            ++requestsMade;
+            auto selfWeakCopy(selfWeak);
+            httpClientTransaction->SetCompletionDelegate(
+                [
+                    id,
+                    apiCall,
+                    credentialIndex,
+                    targetUriString,
+                    cacheKey,
+                    cachedResponse,
+                    selfWeakCopy
+                ]{
+                    auto impl = selfWeakCopy.lock();
+                    if (impl == nullptr) {
+                        return;
+                    }
+                    std::lock_guard< decltype(impl->mutex) > lock(impl->mutex);
+                    auto httpClientTransactionsEntry = impl->httpClientTransactions.find(id);
+                    if (httpClientTransactionsEntry == impl->httpClientTransactions.end()) {
+                        // The API call was cancelled, and its failure
+                        // already delivered.
+                        return;
+                    }
+                    --impl->apiCallsInProgress;
+                    impl->wakeWorker.notify_one();
+                    const auto& onSuccess = apiCall->onSuccess;
+                    const auto& onFailure = apiCall->onFailure;
+                    const auto httpClientTransaction = std::move(httpClientTransactionsEntry->second);
+                    (void)impl->httpClientTransactions.erase(httpClientTransactionsEntry);
+                    (void)impl->apiCallsInFlight.erase(id);
+                    const auto now = impl->timeKeeper->GetCurrentTime();
+                    auto& credential = impl->credentials[credentialIndex];
+                    --credential.apiCallsInProgress;
+                    credential.rateLimiter.Update(
+                        httpClientTransaction->response.headers,
+                        credential.apiCallsInProgress,
+                        now
+                    );
+                    const auto& response = httpClientTransaction->response;
+                    if (
+                        (response.statusCode == 401)
+                        && impl->IsPooledApi(apiCall->api)
+                    ) {
+                        // Leave out credentials Twitch rejects for a while,
+                        // and try the call again with other credentials,
+                        // once for each set of credentials at most.
+                        credential.disabledUntil = now + credentialRecoveryInterval;
+                        impl->diagnosticsSender.SendDiagnosticInformationFormatted(
+                            SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                            "Credentials %zu rejected by Twitch; leaving them out for %.0lf seconds",
+                            credentialIndex,
+                            credentialRecoveryInterval
+                        );
+                        if (apiCall->attempt < impl->credentials.size()) {
+                            impl->DelayApiCall(apiCall, now);
+                            return;
+                        }
+                    }
+                    if (impl->ShouldRetry(*apiCall, response.statusCode)) {
+                        const auto delay = impl->GetRetryDelay(*apiCall, response, now);
+                        impl->diagnosticsSender.SendDiagnosticInformationFormatted(
+                            SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                            "Twitch API call %d (%s) failure: %u -- retrying in %.1lf seconds (attempt %u)",
+                            id,
+                            targetUriString.c_str(),
+                            response.statusCode,
+                            delay,
+                            apiCall->attempt + 1
+                        );
+                        impl->DelayApiCall(apiCall, now + delay);
+                        return;
+                    }
+                    auto& completedApiCall = impl->GetCompletedApiCall(*apiCall);
+                    if (
+                        (response.statusCode == 304)
+                        && (cachedResponse != nullptr)
+                    ) {
+                        cachedResponse->time = now;
+                        impl->responseCache.Store(cacheKey, *cachedResponse);
+                        const auto body = cachedResponse->body;
+                        completedApiCall = [onSuccess, body]{
+                            onSuccess(*body);
+                        };
+                    } else if (response.statusCode == 200) {
+                        // Take the body from the transaction rather than
+                        // copying it, and share it between the cache and
+                        // the caller.
+                        const auto body = std::make_shared< const std::string >(
+                            std::move(httpClientTransaction->response.body)
+                        );
+                        if (!cacheKey.empty()) {
+                            ResponseCache::Entry entry;
+                            if (response.headers.HasHeader("ETag")) {
+                                entry.etag = response.headers.GetHeaderValue("ETag");
+                            }
+                            if (response.headers.HasHeader("Last-Modified")) {
+                                entry.lastModified = response.headers.GetHeaderValue("Last-Modified");
+                            }
+                            if (
+                                !entry.etag.empty()
+                                || !entry.lastModified.empty()
+                                || (impl->responseCache.GetMaxAge(apiCall->resource) > 0.0)
+                            ) {
+                                entry.body = body;
+                                entry.time = now;
+                                impl->responseCache.Store(cacheKey, entry);
+                            }
+                        }
+                        if (impl->IsDiagnosticsLevelWanted(0)) {
+                            impl->diagnosticsSender.SendDiagnosticInformationFormatted(
+                                0,
+                                "Twitch API call %d success: %.*s%s",
+                                id,
+                                (int)std::min(body->length(), maxLoggedBodyLength),
+                                body->data(),
+                                ((body->length() > maxLoggedBodyLength) ? "..." : "")
+                            );
+                        }
+                        completedApiCall = [onSuccess, body]{
+                            onSuccess(*body);
+                        };
+                    } else {
+                        impl->diagnosticsSender.SendDiagnosticInformationFormatted(
+                            SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                            "Twitch API call %d (%s) failure: %u (%.*s%s)",
+                            id,
+                            targetUriString.c_str(),
+                            response.statusCode,
+                            (int)std::min(response.body.length(), maxLoggedBodyLength),
+                            response.body.data(),
+                            ((response.body.length() > maxLoggedBodyLength) ? "..." : "")
+                        );
+                        const auto statusCode = httpClientTransaction->response.statusCode;
+                        completedApiCall = [onFailure, statusCode]{
+                            onFailure(statusCode);
+                        };
+                    }
+                    impl->DeliverCompletedApiCalls(apiCall->caller);
+                }
+            );
+            return true;
+        }
+
+        void QueueApiCall(std::shared_ptr< ApiCall > apiCall) {
+            if (timeKeeper != nullptr) {
+                apiCall->queueTime = timeKeeper->GetCurrentTime();
+            }
+            if (
+                schedulerStatsEnabled
+                && (apiCall->postTime == 0.0)
+            ) {
+                apiCall->postTime = SchedulerStats::Now();
+            }
+            auto& queue = apiCalls[(size_t)apiCall->priority];
+            if (apiCall->attempt == 0) {
+                queue.push_back(std::move(apiCall));
+            } else {
+                queue.push_front(std::move(apiCall));
+            }
+            wakeWorker.notify_one();
+        }
 
         /**
-         * This holds onto pending HTTP request transactions being made.
+         * This method returns an indication of whether or not the given
+         * API call should be made again, given the status code returned
+         * by its last attempt.
          *
-         * The keys are unique identifiers.  The values are the transactions.
+         * Calls are retried after transient failures (connection failures,
+         * rate limiting, and server errors) until the retry policy for
+         * their API runs out of attempts.  Calls which aren't idempotent
+         * (RawPost) are only retried if rate limited, since then Twitch
+         * is known not to have acted on them.
+         *
+         * @param[in] apiCall
+         *     This is the API call which failed.
+         *
+         * @param[in] statusCode
+         *     This is the status code returned by the last attempt.
+         *
+         * @return
+         *     An indication of whether or not the API call should be
+         *     made again is returned.
          */
-        std::map< int, std::shared_ptr< Http::IClient::Transaction > > httpClientTransactions;
+        bool ShouldRetry(
+            const ApiCall& apiCall,
+            unsigned int statusCode
+        ) const {
+            if (apiCall.attempt >= GetRetryPolicy(apiCall.api).maxAttempts) {
+                return false;
+            }
+            if (statusCode == 429) {
+                return true;
+            }
+            if (apiCall.api == Api::RawPost) {
+                return false;
+            }
+            switch (statusCode) {
+                case 0:
+                case 500:
+                case 502:
+                case 503:
+                case 504: {
+                    return true;
+                }
 
-        std::recursive_mutex mutex;
-        double nextApiCallTime = 0.0;
+                default: {
+                    return false;
+                }
+            }
+        }
 
         /**
-         * This is used to select unique identifiers as keys for the
-         * httpClientTransactions collection.  It is incremented each
-         * time a key is selected.
+         * This method determines how long to wait before making the given
+         * API call again.  If Twitch said when to try again, through the
+         * Retry-After header, or (if rate limited) the Ratelimit-Reset
+         * header, that's honored.  Otherwise the delay grows exponentially
+         * with each attempt, with full jitter, so that calls failing
+         * together don't all retry together.
+         *
+         * @param[in] apiCall
+         *     This is the API call which failed.
+         *
+         * @param[in] response
+         *     This is the response to the last attempt.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The number of seconds to wait before making the API call
+         *     again is returned.
          */
-        int nextHttpClientTransactionId = 1;
-
-        std::weak_ptr< Impl > selfWeak;
-        bool stopWorker = false;
-        std::shared_ptr< Http::TimeKeeper > timeKeeper;
-        std::condition_variable_any wakeWorker;
-        std::thread worker;
-
-        // Lifecycle
-
-        ~Impl() {
-            std::unique_lock< decltype(mutex) > lock(mutex);
-            Demobilize(lock);
+        double GetRetryDelay(
+            const ApiCall& apiCall,
+            const Http::Response& response,
+            double now
+        ) {
+            const auto& retryPolicy = GetRetryPolicy(apiCall.api);
+            double delay;
+            if (
+                response.headers.HasHeader("Retry-After")
+                && (sscanf(((std::string)response.headers.GetHeaderValue("Retry-After")).c_str(), "%lf", &delay) == 1)
+            ) {
+                return std::min(std::max(delay, 0.0), retryPolicy.maxDelay);
+            }
+            if (
+                (response.statusCode == 429)
+                && response.headers.HasHeader("Ratelimit-Reset")
+                && (sscanf(((std::string)response.headers.GetHeaderValue("Ratelimit-Reset")).c_str(), "%lf", &delay) == 1)
+            ) {
+                return std::min(std::max(delay - now, 0.0), retryPolicy.maxDelay);
+            }
+            delay = std::min(
+                retryPolicy.baseDelay * pow(2.0, (double)(apiCall.attempt - 1)),
+                retryPolicy.maxDelay
+            );
+            return std::uniform_real_distribution< double >(0.0, delay)(randomGenerator);
         }
-        Impl(const Impl&) = delete;
-        Impl(Impl&&) = delete;
-        Impl& operator=(const Impl&) = delete;
-        Impl& operator=(Impl&&) = delete;
 
-        // Methods
+        const RetryPolicy& GetRetryPolicy(Api api) const {
+            switch (api) {
+                case Api::Kraken: {
+                    return retryPolicies[0];
+                }
 
-        Impl()
-            : diagnosticsSender("Twitch")
-        {
-        }
+                case Api::Helix: {
+                    return retryPolicies[1];
+                }
 
-        void Demobilize(std::unique_lock< decltype(mutex) >& lock) {
-            if (!worker.joinable()) {
-                return;
-            }
-            stopWorker = true;
-            wakeWorker.notify_one();
-            if (std::this_thread::get_id() == worker.get_id()) {
-                worker.detach();
-            } else {
-                WithoutLock(lock, [this]{ worker.join(); });
+                case Api::OAuth2: {
+                    return retryPolicies[2];
+                }
+
+                default: {
+                    return retryPolicies[3];
+                }
             }
         }
 
-        void Mobilize(
-            Json::Value&& configuration,
-            std::string&& caCerts,
-            std::shared_ptr< Http::TimeKeeper >&& timeKeeper
-        ) {
-            if (worker.joinable()) {
-                return;
+        bool HasQueuedApiCalls() const {
+            for (const auto& queue: apiCalls) {
+                if (!queue.empty()) {
+                    return true;
+                }
             }
-            this->configuration = std::move(configuration);
-            this->caCerts = std::move(caCerts);
-            this->timeKeeper = timeKeeper;
-            stopWorker = false;
-            worker = std::thread(&Impl::Worker, this);
+            return false;
         }
 
-        void NextApiCall() {
-            if (apiCalls.IsEmpty()) {
-                nextApiCallTime = 0.0;
-            } else {
-                const auto apiCall = apiCalls.Remove();
-                apiCall();
+        /**
+         * This method removes from the queues the next API call to start.
+         * The call chosen is the one with the highest priority, where
+         * calls are treated as having one level higher priority for each
+         * priorityAgingInterval they have waited.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     The next API call to start is returned.
+         */
+        std::shared_ptr< ApiCall > TakeNextApiCall(double now) {
+            size_t bestQueue = numPriorities;
+            double bestPriority = 0.0;
+            for (size_t i = 0; i < numPriorities; ++i) {
+                if (apiCalls[i].empty()) {
+                    continue;
+                }
+                auto priority = (double)i;
+                if (priorityAgingInterval > 0.0) {
+                    priority -= floor((now - apiCalls[i].front()->queueTime) / priorityAgingInterval);
+                }
+                if (
+                    (bestQueue == numPriorities)
+                    || (priority < bestPriority)
+                ) {
+                    bestQueue = i;
+                    bestPriority = priority;
+                }
             }
+            const auto apiCall = std::move(apiCalls[bestQueue].front());
+            apiCalls[bestQueue].pop_front();
+            return apiCall;
         }
 
         void PostApiCall(
             Api api,
             const std::string& resource,
-            std::function< void(Json::Value&& response) > onSuccess,
-            std::function< void(unsigned int statusCode) > onFailure
+            std::function< void(const std::string& body) > onSuccess,
+            std::function< void(unsigned int statusCode) > onFailure,
+            Priority priority,
+            size_t caller
         ) {
-            apiCalls.Add(
-                [
-                    api,
-                    resource,
-                    onSuccess,
-                    onFailure,
-                    this
-                ]{
-                    Http::Request request;
-                    std::string targetUriString;
-                    switch (api) {
-                        case Api::Kraken: {
-                            targetUriString = std::string("https://api.twitch.tv/kraken/") + resource;
-                            request.headers.SetHeader("Accept", "application/vnd.twitchtv.v5+json");
-                        } break;
-
-                        case Api::Helix: {
-                            targetUriString = std::string("https://api.twitch.tv/helix/") + resource;
-                        } break;
-
-                        case Api::OAuth2: {
-                            targetUriString = std::string("https://id.twitch.tv/oauth2/") + resource;
-                        } break;
-
-                        case Api::RawGet:
-                        case Api::RawPost: {
-                            targetUriString = std::string("https://") + resource;
-                        } break;
-
-                        default: {
-                            diagnosticsSender.SendDiagnosticInformationFormatted(
-                                SystemAbstractions::DiagnosticsSender::Levels::ERROR,
-                                "Unknown API requested for: %s",
-                                resource.c_str()
-                            );
-                            onFailure(400);
-                            return;
-                        } break;
-                    }
-                    apiCallInProgress = true;
-                    const auto id = nextHttpClientTransactionId++;
-                    diagnosticsSender.SendDiagnosticInformationFormatted(
-                        0,
-                        "Twitch API call %d request: %s",
-                        id,
-                        targetUriString.c_str()
-                    );
-                    if (api == Api::RawPost) {
-                        request.method = "POST";
-                    } else {
-                        request.method = "GET";
+            const auto apiCall = std::make_shared< ApiCall >();
+            apiCall->api = api;
+            apiCall->resource = resource;
+            apiCall->onSuccess = onSuccess;
+            apiCall->onFailure = onFailure;
+            apiCall->priority = priority;
+            apiCall->caller = caller;
+            if (cancelled) {
+                GetCompletedApiCall(*apiCall) = [onFailure]{
+                    onFailure(0);
+                };
+                DeliverCompletedApiCalls(caller);
+                return;
+            }
+            QueueApiCall(apiCall);
+        }
+
+        void StartUserIdLookups() {
+            userIdLookupQueued = false;
+            if (userIdLookupsPending.empty()) {
+                return;
+            }
+            const auto lookups = std::make_shared< decltype(userIdLookupsPending) >();
+            std::string uri = "users";
+            while (
+                !userIdLookupsPending.empty()
+                && (lookups->size() < maxUserLookupsPerApiCall)
+            ) {
+                auto userIdLookupsPendingEntry = userIdLookupsPending.begin();
+                uri += (lookups->empty() ? '?' : '&');
+                uri += "login=";
+                uri += PercentEncode(userIdLookupsPendingEntry->first);
+                (void)lookups->insert(std::move(*userIdLookupsPendingEntry));
+                (void)userIdLookupsPending.erase(userIdLookupsPendingEntry);
+            }
+            if (!userIdLookupsPending.empty()) {
+                QueueUserIdLookups();
+            }
+            const auto apiCall = std::make_shared< ApiCall >();
+            apiCall->api = Api::Helix;
+            apiCall->resource = uri;
+            apiCall->priority = Priority::Interactive;
+
+            // Lookups don't need to wait for the results of anyone else's
+            // API calls.
+            apiCall->caller = nextCaller++;
+            apiCall->onSuccess = [lookups, this](const std::string& body){
+                const auto response = Json::Value::FromEncoding(body);
+                const auto& data = response["data"];
+                for (size_t i = 0; i < data.GetSize(); ++i) {
+                    const std::string login = data[i]["login"];
+                    auto lookupsEntry = lookups->find(login);
+                    if (lookupsEntry == lookups->end()) {
+                        continue;
                     }
-                    request.target.ParseFromString(targetUriString);
-                    request.target.SetPort(443);
+                    intmax_t userid;
                     if (
-                        (api != Api::OAuth2)
-                        && (api != Api::RawGet)
-                        && (api != Api::RawPost)
+                        sscanf(
+                            ((std::string)data[i]["id"]).c_str(), "%" SCNdMAX,
+                            &userid
+                        ) != 1
                     ) {
-                        request.headers.SetHeader("Client-ID", configuration["clientId"]);
-                    }
-                    if (configuration.Has("oauthToken")) {
-                        const std::string oauthToken = configuration["oauthToken"];
                         diagnosticsSender.SendDiagnosticInformationFormatted(
-                            0,
-                            "Using OAuth token: %s",
-                            oauthToken.c_str()
+                            SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                            "Twitch API returned invalid ID for user '%s'",
+                            login.c_str()
                         );
-                        switch (api) {
-                            case Api::Helix: {
-                                request.headers.SetHeader(
-                                    "Authorization",
-                                    StringExtensions::sprintf(
-                                        "Bearer %s",
-                                        oauthToken.c_str()
-                                    )
-                                );
-                            } break;
-
-                            case Api::Kraken:
-                            case Api::OAuth2: {
-                                request.headers.SetHeader(
-                                    "Authorization",
-                                    StringExtensions::sprintf(
-                                        "OAuth %s",
-                                        oauthToken.c_str()
-                                    )
-                                );
-                            } break;
-
-                            default: {
-                            } break;
-                        }
+                        continue;
                     }
-                    auto& httpClientTransaction = httpClientTransactions[id];
-                    httpClientTransaction = httpClient->Request(request);
-                    auto selfWeakCopy(selfWeak);
-                    httpClientTransaction->SetCompletionDelegate(
-                        [
-                            id,
-                            onSuccess,
-                            onFailure,
-                            targetUriString,
-                            selfWeakCopy
-                        ]{
-                            auto impl = selfWeakCopy.lock();
-                            if (impl == nullptr) {
-                                return;
-                            }
-                            std::lock_guard< decltype(impl->mutex) > lock(impl->mutex);
-                            impl->apiCallInProgress = false;
-                            impl->nextApiCallTime = impl->timeKeeper->GetCurrentTime() + twitchApiLookupCooldown;
-                            impl->wakeWorker.notify_one();
-                            auto httpClientTransactionsEntry = impl->httpClientTransactions.find(id);
-                            if (httpClientTransactionsEntry == impl->httpClientTransactions.end()) {
-                                return;
-                            }
-                            const auto& httpClientTransaction = httpClientTransactionsEntry->second;
-                            if (httpClientTransaction->response.statusCode == 200) {
-                                impl->diagnosticsSender.SendDiagnosticInformationFormatted(
-                                    0,
-                                    "Twitch API call %d success: %s",
-                                    id,
-                                    httpClientTransaction->response.body.c_str()
-                                );
-                                onSuccess(Json::Value::FromEncoding(httpClientTransaction->response.body));
-                            } else {
-                                impl->diagnosticsSender.SendDiagnosticInformationFormatted(
-                                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
-                                    "Twitch API call %d (%s) failure: %u (%s)",
-                                    id,
-                                    targetUriString.c_str(),
-                                    httpClientTransaction->response.statusCode,
-                                    httpClientTransaction->response.body.c_str()
-                                );
-                                onFailure(httpClientTransaction->response.statusCode);
-                            }
-                            (void)impl->httpClientTransactions.erase(httpClientTransactionsEntry);
-                        }
-                    );
+                    userIdCache.Add(GetUserIdCacheKey(login), userid, timeKeeper->GetCurrentTime());
+                    for (const auto& promise: lookupsEntry->second) {
+                        promise->set_value(userid);
+                    }
+                    (void)lookups->erase(lookupsEntry);
                 }
-            );
-            wakeWorker.notify_one();
+                for (const auto& lookupsEntry: *lookups) {
+                    for (const auto& promise: lookupsEntry.second) {
+                        promise->set_value(0);
+                    }
+                }
+            };
+            apiCall->onFailure = [lookups](unsigned int statusCode){
+                for (const auto& lookupsEntry: *lookups) {
+                    for (const auto& promise: lookupsEntry.second) {
+                        promise->set_value(0);
+                    }
+                }
+            };
+            if (!StartApiCall(apiCall)) {
+                apiCalls[(size_t)apiCall->priority].push_front(apiCall);
+            }
+        }
+
+        void QueueUserIdLookups() {
+            userIdLookupQueued = true;
+            const auto apiCall = std::make_shared< ApiCall >();
+
+            // The API and resource are filled in so that the worker
+            // can tell whether or not credentials are available to make
+            // the lookups before starting them.
+            apiCall->api = Api::Helix;
+            apiCall->resource = "users";
+            apiCall->priority = Priority::Interactive;
+            apiCall->start = [this]{
+                StartUserIdLookups();
+            };
+            QueueApiCall(apiCall);
+        }
+
+        void LookUpUserId(
+            const std::string& name,
+            std::shared_ptr< std::promise< intmax_t > > promise
+        ) {
+            if (cancelled) {
+                promise->set_value(0);
+                return;
+            }
+            const auto login = ToLower(name);
+
+            // Leave out names which can't be logins, so that they don't
+            // cause Twitch to reject the lookups of everyone else in the
+            // same batch.
+            if (!IsValidLogin(login)) {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                    "'%s' is not a valid user name",
+                    name.c_str()
+                );
+                promise->set_value(0);
+                return;
+            }
+            intmax_t userid;
+            if (
+                (timeKeeper != nullptr)
+                && userIdCache.Find(GetUserIdCacheKey(login), timeKeeper->GetCurrentTime(), userid)
+            ) {
+                promise->set_value(userid);
+                return;
+            }
+            userIdLookupsPending[login].push_back(promise);
+            if (!userIdLookupQueued) {
+                QueueUserIdLookups();
+            }
         }
 
         void Worker() {
@@ -300,53 +2012,178 @@ namespace Twarlock {
             (void)httpClient->SubscribeToDiagnostics(diagnosticsPublisher);
             Http::Client::MobilizationDependencies httpClientDeps;
             httpClientDeps.timeKeeper = timeKeeper;
-            const auto transport = std::make_shared< HttpNetworkTransport::HttpClientNetworkTransport >();
-            transport->SubscribeToDiagnostics(diagnosticsPublisher);
-            transport->SetConnectionFactory(
-                [
-                    diagnosticsPublisher,
-                    this
-                ](
-                    const std::string& scheme,
-                    const std::string& serverName
-                ) -> std::shared_ptr< SystemAbstractions::INetworkConnection > {
-                    const auto decorator = std::make_shared< TlsDecorator::TlsDecorator >();
-                    const auto connection = std::make_shared< SystemAbstractions::NetworkConnection >();
-                    decorator->ConfigureAsClient(connection, caCerts, serverName);
-                    return decorator;
-                }
-            );
-            httpClientDeps.transport = transport;
+            if (transport == nullptr) {
+                const auto networkTransport = std::make_shared< HttpNetworkTransport::HttpClientNetworkTransport >();
+                networkTransport->SubscribeToDiagnostics(diagnosticsPublisher);
+                networkTransport->SetConnectionFactory(
+                    [
+                        diagnosticsPublisher,
+                        this
+                    ](
+                        const std::string& scheme,
+                        const std::string& serverName
+                    ) -> std::shared_ptr< SystemAbstractions::INetworkConnection > {
+                        std::lock_guard< decltype(mutex) > lock(mutex);
+                        const auto decorator = std::make_shared< TlsDecorator::TlsDecorator >();
+                        const auto connection = std::make_shared< SystemAbstractions::NetworkConnection >();
+                        decorator->ConfigureAsClient(connection, *caCerts, serverName);
+                        auto& connections = connectionsByServer[serverName];
+                        connections.erase(
+                            std::remove_if(
+                                connections.begin(),
+                                connections.end(),
+                                [](const std::weak_ptr< SystemAbstractions::INetworkConnection >& connection){
+                                    return connection.expired();
+                                }
+                            ),
+                            connections.end()
+                        );
+                        connections.push_back(decorator);
+                        ++connectionsMade;
+                        diagnosticsSender.SendDiagnosticInformationFormatted(
+                            1,
+                            "New connection to %s (%zu in pool)",
+                            serverName.c_str(),
+                            connections.size()
+                        );
+                        return decorator;
+                    }
+                );
+                httpClientDeps.transport = networkTransport;
+            } else {
+                httpClientDeps.transport = transport;
+            }
             httpClient->Mobilize(httpClientDeps);
             while (!stopWorker) {
                 auto now = timeKeeper->GetCurrentTime();
-                if (
-                    !apiCallInProgress
-                    && (now >= nextApiCallTime)
+                while (
+                    !delayedApiCalls.empty()
+                    && (delayedApiCalls.begin()->first <= now)
+                ) {
+                    QueueApiCall(std::move(delayedApiCalls.begin()->second));
+                    (void)delayedApiCalls.erase(delayedApiCalls.begin());
+                }
+                // API calls which can't be made yet because their
+                // credentials have no requests left in their rate limit
+                // are set aside, so that calls which other credentials
+                // could make, or which the response cache can answer,
+                // aren't held up behind them.  Afterwards they're put back
+                // at the front of their queues, and this is set to the
+                // earliest time at which any of them can be made.
+                double blockedUntil = 0.0;
+                std::vector< std::shared_ptr< ApiCall > > blockedApiCalls;
+                while (
+                    (apiCallsInProgress < maxConcurrentRequests)
+                    && HasQueuedApiCalls()
                 ) {
-                    NextApiCall();
+                    const auto apiCall = TakeNextApiCall(now);
+                    const auto firstAttempt = (apiCall->attempt == 0);
+                    bool started;
+                    double nextTokenTime = 0.0;
+                    if (
+                        (apiCall->start != nullptr)
+                        || !IsCacheable(*apiCall)
+                    ) {
+                        // Once no credentials have any requests left,
+                        // there's no need to look any further at calls
+                        // which can only be made with a request.
+                        if (!HasAvailableTokens(now)) {
+                            nextTokenTime = GetEarliestTokenTime(now);
+                        }
+                    }
+                    if (nextTokenTime != 0.0) {
+                        started = false;
+                    } else if (apiCall->start == nullptr) {
+                        started = StartApiCall(apiCall);
+                    } else if (ChooseCredential(*apiCall, now) == credentials.size()) {
+                        started = false;
+                    } else {
+                        apiCall->start();
+                        started = true;
+                    }
+                    if (!started) {
+                        if (nextTokenTime == 0.0) {
+                            nextTokenTime = GetNextTokenTime(*apiCall, now);
+                        }
+                        if (
+                            (blockedUntil == 0.0)
+                            || (nextTokenTime < blockedUntil)
+                        ) {
+                            blockedUntil = nextTokenTime;
+                        }
+                        blockedApiCalls.push_back(apiCall);
+                        continue;
+                    }
+                    if (
+                        schedulerStatsEnabled
+                        && firstAttempt
+                    ) {
+                        schedulerStats.RecordDispatch(SchedulerStats::Now() - apiCall->postTime);
+                    }
                 }
+                for (
+                    auto blockedApiCall = blockedApiCalls.rbegin();
+                    blockedApiCall != blockedApiCalls.rend();
+                    ++blockedApiCall
+                ) {
+                    apiCalls[(size_t)(*blockedApiCall)->priority].push_front(std::move(*blockedApiCall));
+                }
+                const auto nowClock = std::chrono::system_clock::now();
+                now = timeKeeper->GetCurrentTime();
+                double wakeTime = 0.0;
                 if (
-                    !apiCallInProgress
-                    && (nextApiCallTime != 0.0)
+                    (apiCallsInProgress < maxConcurrentRequests)
+                    && HasQueuedApiCalls()
                 ) {
-                    const auto nowClock = std::chrono::system_clock::now();
-                    now = timeKeeper->GetCurrentTime();
-                    if (nextApiCallTime > now) {
-                        const auto timeoutMilliseconds = (int)ceil(
-                            (nextApiCallTime - now)
-                            * 1000.0
-                        );
-                        wakeWorker.wait_until(
-                            lock,
-                            nowClock + std::chrono::milliseconds(timeoutMilliseconds)
-                        );
+                    wakeTime = std::max(blockedUntil, now);
+                }
+                if (!delayedApiCalls.empty()) {
+                    const auto retryTime = delayedApiCalls.begin()->first;
+                    if (
+                        (wakeTime == 0.0)
+                        || (retryTime < wakeTime)
+                    ) {
+                        wakeTime = retryTime;
                     }
-                } else {
+                }
+                if (wakeTime == 0.0) {
                     wakeWorker.wait(lock);
+                } else if (wakeTime > now) {
+                    const auto timeoutMilliseconds = (int)ceil(
+                        (wakeTime - now)
+                        * 1000.0
+                    );
+                    wakeWorker.wait_until(
+                        lock,
+                        nowClock + std::chrono::milliseconds(timeoutMilliseconds)
+                    );
                 }
             }
             httpClient->Demobilize();
+            if (credentials.size() > 1) {
+                for (size_t i = 0; i < credentials.size(); ++i) {
+                    diagnosticsSender.SendDiagnosticInformationFormatted(
+                        2,
+                        "Made %zu requests with credentials %zu",
+                        credentials[i].requestsMade,
+                        i
+                    );
+                }
+            }
+            diagnosticsSender.SendDiagnosticInformationFormatted(
+                2,
+                "Made %zu requests over %zu connections (%zu reused)",
+                requestsMade,
+                connectionsMade,
+                (
+                    (requestsMade > connectionsMade)
+                    ? requestsMade - connectionsMade
+                    : 0
+                )
+            );
+            if (schedulerStatsEnabled) {
+                schedulerStats.Report(diagnosticsSender);
+            }
         }
     };
 
@@ -367,6 +2204,11 @@ namespace Twarlock {
         return impl_->diagnosticsSender.SubscribeToDiagnostics(delegate, minLevel);
     }
 
+    void Twitch::SetTransport(std::shared_ptr< Http::IClientTransport > transport) {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->transport = std::move(transport);
+    }
+
     void Twitch::Mobilize(
         Json::Value configuration,
         std::string caCerts,
@@ -385,44 +2227,92 @@ namespace Twarlock {
         impl_->Demobilize(lock);
     }
 
+    void Twitch::Cancel() {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->Cancel();
+    }
+
+    size_t Twitch::NewCaller() {
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        return impl_->nextCaller++;
+    }
+
     void Twitch::PostApiCall(
         Api api,
         const std::string& targetUriString,
         std::function< void(Json::Value&& response) > onSuccess,
-        std::function< void(unsigned int statusCode) > onFailure
+        std::function< void(unsigned int statusCode) > onFailure,
+        Priority priority,
+        size_t caller
+    ) {
+        PostApiCallForBody(
+            api,
+            targetUriString,
+            [onSuccess](const std::string& body){
+                onSuccess(Json::Value::FromEncoding(body));
+            },
+            onFailure,
+            priority,
+            caller
+        );
+    }
+
+    void Twitch::PostApiCallForBody(
+        Api api,
+        const std::string& targetUriString,
+        std::function< void(const std::string& body) > onSuccess,
+        std::function< void(unsigned int statusCode) > onFailure,
+        Priority priority,
+        size_t caller
     ) {
+        const auto postStart = SchedulerStats::Now();
         std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
-        impl_->PostApiCall(api, targetUriString, onSuccess, onFailure);
+        impl_->PostApiCall(api, targetUriString, onSuccess, onFailure, priority, caller);
+        if (impl_->schedulerStatsEnabled) {
+            size_t numQueued = 0;
+            for (const auto& queue: impl_->apiCalls) {
+                numQueued += queue.size();
+            }
+            impl_->schedulerStats.RecordPost(
+                SchedulerStats::Now() - postStart,
+                numQueued
+            );
+        }
     }
 
     intmax_t Twitch::GetUserIdByName(const std::string& name) {
-        const auto done = std::make_shared< std::promise< intmax_t > >();
-        PostApiCall(
-            Twitch::Api::Kraken,
-            StringExtensions::sprintf("users?login=%s", name.c_str()),
-            [&](Json::Value&& response){
-                intmax_t userid;
-                if (
-                    sscanf(
-                        ((std::string)response["users"][0]["_id"]).c_str(), "%" SCNdMAX,
-                        &userid
-                    ) == 1
-                ) {
-                    done->set_value(userid);
-                } else {
-                    impl_->diagnosticsSender.SendDiagnosticInformationFormatted(
-                        SystemAbstractions::DiagnosticsSender::Levels::WARNING,
-                        "Twitch API returned invalid ID for user '%s'",
-                        name.c_str()
-                    );
-                    done->set_value(0);
-                }
-            },
-            [&](unsigned int statusCode){
-                done->set_value(0);
+        const auto userIds = GetUserIdsByNames({name});
+        const auto userIdsEntry = userIds.find(name);
+        if (userIdsEntry == userIds.end()) {
+            impl_->diagnosticsSender.SendDiagnosticInformationFormatted(
+                SystemAbstractions::DiagnosticsSender::Levels::WARNING,
+                "Could not get ID of user '%s'",
+                name.c_str()
+            );
+            return 0;
+        }
+        return userIdsEntry->second;
+    }
+
+    std::map< std::string, intmax_t > Twitch::GetUserIdsByNames(const std::vector< std::string >& names) {
+        std::vector< std::future< intmax_t > > userIdFutures;
+        userIdFutures.reserve(names.size());
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            for (const auto& name: names) {
+                const auto promise = std::make_shared< std::promise< intmax_t > >();
+                userIdFutures.push_back(promise->get_future());
+                impl_->LookUpUserId(name, promise);
             }
-        );
-        return done->get_future().get();
+        }
+        std::map< std::string, intmax_t > userIds;
+        for (size_t i = 0; i < names.size(); ++i) {
+            const auto userid = userIdFutures[i].get();
+            if (userid != 0) {
+                userIds[names[i]] = userid;
+            }
+        }
+        return userIds;
     }
 
 }
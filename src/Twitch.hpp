@@ -9,12 +9,15 @@
  */
 
 #include <functional>
+#include <Http/IClientTransport.hpp>
 #include <Http/TimeKeeper.hpp>
 #include <Json/Value.hpp>
+#include <map>
 #include <memory>
 #include <stdint.h>
 #include <string>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
+#include <vector>
 
 namespace Twarlock {
 
@@ -32,6 +35,31 @@ namespace Twarlock {
             RawPost,
         };
 
+        /**
+         * These are the classes of priority an API call may have.
+         * Calls with higher priority are started before calls with
+         * lower priority, although calls which have waited a long time
+         * are eventually treated as if they had higher priority.
+         */
+        enum class Priority {
+            /**
+             * This is for short calls made on behalf of a user who is
+             * waiting for the result.
+             */
+            Interactive,
+
+            /**
+             * This is for most calls.
+             */
+            Normal,
+
+            /**
+             * This is for calls which are part of a long job, such as
+             * downloading every page of a large list.
+             */
+            Bulk,
+        };
+
         // Lifecycle Methods
     public:
         ~Twitch() noexcept;
@@ -68,6 +96,20 @@ namespace Twarlock {
             size_t minLevel = 0
         );
 
+        /**
+         * This method replaces the transport through which API calls are
+         * made, which otherwise connects to Twitch over the network
+         * using TLS.  It's used to drive the class without a network,
+         * such as in benchmarks.
+         *
+         * @note
+         *     This must be called before Mobilize in order to take effect.
+         *
+         * @param[in] transport
+         *     This is the transport to use to make API calls.
+         */
+        void SetTransport(std::shared_ptr< Http::IClientTransport > transport);
+
         void Mobilize(
             Json::Value configuration,
             std::string caCerts,
@@ -76,15 +118,95 @@ namespace Twarlock {
 
         void Demobilize();
 
+        /**
+         * This method cancels all API calls which haven't completed yet,
+         * delivering their failures right away, and causes any API calls
+         * posted afterwards to fail immediately.  It's used to stop
+         * whatever is being done as quickly as possible, such as when
+         * the user interrupts the program.
+         *
+         * Requests already sent are aborted by closing the connections
+         * to Twitch.  If a transport was given with SetTransport, its
+         * connections aren't known, so those requests run to completion
+         * and their responses are ignored.
+         */
+        void Cancel();
+
+        /**
+         * This method returns a new identifier for a caller to give with
+         * its API calls.  The results of each caller's API calls are
+         * delivered in the order the calls were started, without waiting
+         * for the results of anyone else's calls.  Callers which don't
+         * give an identifier share one.
+         *
+         * @return
+         *     A new identifier for a caller of the API is returned.
+         */
+        size_t NewCaller();
+
         void PostApiCall(
             Api api,
             const std::string& resource,
             std::function< void(Json::Value&& response) > onSuccess,
-            std::function< void(unsigned int statusCode) > onFailure
+            std::function< void(unsigned int statusCode) > onFailure,
+            Priority priority = Priority::Normal,
+            size_t caller = 0
+        );
+
+        /**
+         * This method makes an API call in the same way as PostApiCall,
+         * except that the body of the response is given to the caller
+         * as it was received, rather than decoded as JSON.  This lets
+         * the caller decode only the parts of the response it needs,
+         * for example using VisitListEntries.
+         *
+         * @param[in] api
+         *     This is the API providing the resource.
+         *
+         * @param[in] resource
+         *     This is the resource to request.
+         *
+         * @param[in] onSuccess
+         *     This is called with the body of the response, if the API
+         *     call succeeds.
+         *
+         * @param[in] onFailure
+         *     This is called with the status code of the response,
+         *     if the API call fails.
+         *
+         * @param[in] priority
+         *     This is the priority of the API call.
+         *
+         * @param[in] caller
+         *     This identifies who is making the API call, as returned
+         *     by NewCaller, or is zero if not given.
+         */
+        void PostApiCallForBody(
+            Api api,
+            const std::string& resource,
+            std::function< void(const std::string& body) > onSuccess,
+            std::function< void(unsigned int statusCode) > onFailure,
+            Priority priority = Priority::Normal,
+            size_t caller = 0
         );
 
         intmax_t GetUserIdByName(const std::string& name);
 
+        /**
+         * This method looks up the IDs of the users with the given
+         * login names.  Lookups requested by all callers are combined
+         * into as few API calls as possible.
+         *
+         * @param[in] names
+         *     These are the login names of the users to look up.
+         *
+         * @return
+         *     The IDs of the users found are returned, keyed by the
+         *     login names given.  Users that could not be found are
+         *     left out.
+         */
+        std::map< std::string, intmax_t > GetUserIdsByNames(const std::vector< std::string >& names);
+
         // Private properties
     private:
         /**
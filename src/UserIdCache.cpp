@@ -0,0 +1,239 @@
+/**
+ * @file UserIdCache.cpp
+ *
+ * This module contains the implementation of the Twarlock::UserIdCache class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "UserIdCache.hpp"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unordered_map>
+
+namespace {
+
+    /**
+     * This holds what is known about one user in the cache.
+     */
+    struct Entry {
+        /**
+         * This is the ID of the user.
+         */
+        intmax_t userid = 0;
+
+        /**
+         * This is the time at which the user's ID was looked up.
+         */
+        double time = 0.0;
+    };
+
+    /**
+     * This function writes the given entry to the given file,
+     * as one line.
+     *
+     * @param[in] file
+     *     This is the file to which to write the entry.
+     *
+     * @param[in] login
+     *     This is the login name of the user.
+     *
+     * @param[in] entry
+     *     This is the entry to write.
+     *
+     * @return
+     *     An indication of whether or not the entry was written
+     *     is returned.
+     */
+    bool WriteEntry(
+        FILE* file,
+        const std::string& login,
+        const Entry& entry
+    ) {
+        return (
+            fprintf(
+                file,
+                "%s\t%" PRIdMAX "\t%.0lf\n",
+                login.c_str(),
+                entry.userid,
+                entry.time
+            ) > 0
+        );
+    }
+
+}
+
+namespace Twarlock {
+
+    /**
+     * This contains the private properties of a UserIdCache class instance.
+     */
+    struct UserIdCache::Impl {
+        /**
+         * This holds the entries of the cache.
+         *
+         * The keys are user login names.
+         */
+        std::unordered_map< std::string, Entry > entries;
+
+        /**
+         * This is the path to the file holding the cache, or an empty
+         * string if the cache isn't backed by a file.
+         */
+        std::string path;
+
+        /**
+         * This is the number of seconds for which an entry is kept,
+         * or zero if entries are kept forever.
+         */
+        double timeToLive = 0.0;
+
+        /**
+         * This method returns an indication of whether or not the given
+         * entry is too old to be used.
+         *
+         * @param[in] entry
+         *     This is the entry to check.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     An indication of whether or not the given entry is too old
+         *     to be used is returned.
+         */
+        bool IsStale(
+            const Entry& entry,
+            double now
+        ) const {
+            return (
+                (timeToLive > 0.0)
+                && (now - entry.time >= timeToLive)
+            );
+        }
+
+        /**
+         * This method rewrites the cache file to hold exactly the
+         * entries currently in the cache.  The new contents are written
+         * to a temporary file first, which then replaces the cache file,
+         * so that the cache file is never left partially written.
+         *
+         * @return
+         *     An indication of whether or not the cache file was rewritten
+         *     is returned.
+         */
+        bool Compact() {
+            const auto tempPath = path + ".tmp";
+            const auto file = fopen(tempPath.c_str(), "wb");
+            if (file == NULL) {
+                return false;
+            }
+            bool success = true;
+            for (const auto& entriesEntry: entries) {
+                if (!WriteEntry(file, entriesEntry.first, entriesEntry.second)) {
+                    success = false;
+                    break;
+                }
+            }
+            if (fclose(file) != 0) {
+                success = false;
+            }
+            if (success) {
+#ifdef _WIN32
+                (void)remove(path.c_str());
+#endif /* _WIN32 */
+                success = (rename(tempPath.c_str(), path.c_str()) == 0);
+            }
+            if (!success) {
+                (void)remove(tempPath.c_str());
+            }
+            return success;
+        }
+    };
+
+    UserIdCache::~UserIdCache() noexcept = default;
+    UserIdCache::UserIdCache(UserIdCache&&) noexcept = default;
+    UserIdCache& UserIdCache::operator=(UserIdCache&&) noexcept = default;
+
+    UserIdCache::UserIdCache()
+        : impl_(new Impl())
+    {
+    }
+
+    bool UserIdCache::Open(
+        const std::string& path,
+        double timeToLive,
+        double now
+    ) {
+        impl_->entries.clear();
+        impl_->path = path;
+        impl_->timeToLive = timeToLive;
+        size_t linesRead = 0;
+        const auto file = fopen(path.c_str(), "rb");
+        if (file != NULL) {
+            char line[256];
+            while (fgets(line, sizeof(line), file) != NULL) {
+                ++linesRead;
+                char login[128];
+                Entry entry;
+                if (
+                    sscanf(
+                        line,
+                        "%127[^\t]\t%" SCNdMAX "\t%lf",
+                        login,
+                        &entry.userid,
+                        &entry.time
+                    ) != 3
+                ) {
+                    continue;
+                }
+                if (impl_->IsStale(entry, now)) {
+                    continue;
+                }
+                impl_->entries[login] = entry;
+            }
+            (void)fclose(file);
+        }
+        if (linesRead == impl_->entries.size()) {
+            return true;
+        }
+        return impl_->Compact();
+    }
+
+    bool UserIdCache::Find(
+        const std::string& login,
+        double now,
+        intmax_t& userid
+    ) const {
+        const auto entriesEntry = impl_->entries.find(login);
+        if (
+            (entriesEntry == impl_->entries.end())
+            || impl_->IsStale(entriesEntry->second, now)
+        ) {
+            return false;
+        }
+        userid = entriesEntry->second.userid;
+        return true;
+    }
+
+    void UserIdCache::Add(
+        const std::string& login,
+        intmax_t userid,
+        double now
+    ) {
+        auto& entry = impl_->entries[login];
+        entry.userid = userid;
+        entry.time = now;
+        if (impl_->path.empty()) {
+            return;
+        }
+        const auto file = fopen(impl_->path.c_str(), "ab");
+        if (file == NULL) {
+            return;
+        }
+        (void)WriteEntry(file, login, entry);
+        (void)fclose(file);
+    }
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+/**
+ * @file UserIdCache.hpp
+ *
+ * This module declares the Twarlock::UserIdCache class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace Twarlock {
+
+    /**
+     * This remembers the IDs of Twitch users, keyed by login name,
+     * in a file, so that they don't have to be looked up again
+     * every time the program runs.
+     *
+     * The file holds one line per user, with the login name, user ID,
+     * and the time the ID was looked up, separated by tabs.  New
+     * entries are appended to the end of the file, and the file
+     * is rewritten without stale or duplicate entries when opened.
+     */
+    class UserIdCache {
+        // Lifecycle Methods
+    public:
+        ~UserIdCache() noexcept;
+        UserIdCache(const UserIdCache&) = delete;
+        UserIdCache(UserIdCache&&) noexcept;
+        UserIdCache& operator=(const UserIdCache&) = delete;
+        UserIdCache& operator=(UserIdCache&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor of the class.
+         */
+        UserIdCache();
+
+        /**
+         * This method loads the cache from the given file, and arranges
+         * for any new entries to be added to it.
+         *
+         * @param[in] path
+         *     This is the path to the file holding the cache.  It is
+         *     created if it doesn't exist.
+         *
+         * @param[in] timeToLive
+         *     This is the number of seconds for which an entry is kept,
+         *     so that renamed users are eventually looked up again.
+         *     If zero, entries are kept forever.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @return
+         *     An indication of whether or not the cache file could be
+         *     read and rewritten is returned.
+         */
+        bool Open(
+            const std::string& path,
+            double timeToLive,
+            double now
+        );
+
+        /**
+         * This method looks up the ID of the user with the given
+         * login name.
+         *
+         * @param[in] login
+         *     This is the login name of the user to look up.
+         *
+         * @param[in] now
+         *     This is the current time.
+         *
+         * @param[out] userid
+         *     This is where to store the ID of the user, if found.
+         *
+         * @return
+         *     An indication of whether or not a fresh entry for the
+         *     user was found is returned.
+         */
+        bool Find(
+            const std::string& login,
+            double now,
+            intmax_t& userid
+        ) const;
+
+        /**
+         * This method adds the ID of the user with the given login
+         * name to the cache, appending it to the cache file.
+         *
+         * @param[in] login
+         *     This is the login name of the user.
+         *
+         * @param[in] userid
+         *     This is the ID of the user.
+         *
+         * @param[in] now
+         *     This is the current time.
+         */
+        void Add(
+            const std::string& login,
+            intmax_t userid,
+            double now
+        );
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
@@ -10,10 +10,14 @@
 #include "Commands.hpp"
 #include "Environment.hpp"
 #include "LoadFile.hpp"
+#include "Server.hpp"
 #include "TimeKeeper.hpp"
 #include "Twitch.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <Json/Value.hpp>
 #include <map>
@@ -27,6 +31,7 @@
 #include <StringExtensions/StringExtensions.hpp>
 #include <SystemAbstractions/DiagnosticsSender.hpp>
 #include <SystemAbstractions/File.hpp>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -156,7 +161,7 @@ namespace {
         }
     }
 
-    const std::string cfgArgSummary = "[-c <CFG>]";
+    const std::string cfgArgSummary = "[-c <CFG>] [--follow] [--format <FMT>] [--output <FILE>] [--resume] [--server <SOCK>] [--snapshot <SNAP>]";
 
     const std::string cfgArgDetails = (
         "Path to file containing the program configuration"
@@ -166,6 +171,32 @@ namespace {
         " and then 'Twarlock.json' in directory containing the program."
     );
 
+    const std::string fmtArgDetails = (
+        "Format in which commands which list things write their results:"
+        " 'human' (the default), 'ndjson' (one JSON object per line),"
+        " 'csv' (comma-separated values) or 'tsv' (tab-separated values)"
+    );
+
+    const std::string fileArgDetails = (
+        "Path to file to which commands which list things write their"
+        " results.  If not specified, results are written to the standard"
+        " output."
+    );
+
+    const std::string sockArgDetails = (
+        "Path of the local socket on which a Twarlock server, started"
+        " with the serve command, is listening.  If specified, the command"
+        " is sent to the server to execute, rather than being executed"
+        " by this program."
+    );
+
+    const std::string snapArgDetails = (
+        "Path to file to which the followers and bans commands save"
+        " a snapshot of the list downloaded, in a compact binary format"
+        " which can be read back with the snapshot command, and which"
+        " the followers-sync command brings up to date"
+    );
+
     /**
      * This function prints to the standard error stream information
      * about how to use this program.
@@ -191,6 +222,10 @@ namespace {
             {
                 {"CFG", cfgArgDetails},
                 {"CMD", cmdSummaries.str()},
+                {"FILE", fileArgDetails},
+                {"FMT", fmtArgDetails},
+                {"SOCK", sockArgDetails},
+                {"SNAP", snapArgDetails},
             }
         );
         PrintUsageInformation(
@@ -205,7 +240,7 @@ namespace {
     /**
      * This flag indicates whether or not the application should shut down.
      */
-    bool shutDown = false;
+    std::atomic< bool > shutDown(false);
 
     /**
      * This function is set up to be called when the SIGINT signal is
@@ -245,17 +280,34 @@ namespace {
         Twarlock::Environment& environment,
         SystemAbstractions::DiagnosticsSender& diagnosticsSender
     ) {
+        struct Option {
+            std::string* value;
+            bool* flag;
+            const char* description;
+        };
+        const std::map< std::string, Option > options{
+            {"--follow", {nullptr, &environment.follow, ""}},
+            {"--format", {&environment.outputFormat, nullptr, "output format"}},
+            {"--output", {&environment.outputFilePath, nullptr, "output file path"}},
+            {"--resume", {nullptr, &environment.resume, ""}},
+            {"--server", {&environment.serverSocketPath, nullptr, "server socket path"}},
+            {"--snapshot", {&environment.snapshotFilePath, nullptr, "snapshot file path"}},
+        };
+        const Option* option = nullptr;
         enum class State {
             FirstArgument,
             ConfigFile,
+            OptionValue,
             Help,
             CommandToExecute,
             CommandArguments,
             ExtraArguments,
         } state = State::FirstArgument;
+        auto stateAfterOption = State::FirstArgument;
         int i = 1;
         while (i < argc) {
             const std::string arg(argv[i]);
+            const auto optionsEntry = options.find(arg);
             switch (state) {
                 case State::FirstArgument: {
                     if (arg == "-c") {
@@ -265,6 +317,15 @@ namespace {
                     } else if (arg == "-h") {
                         ++i;
                         state = State::Help;
+                    } else if (optionsEntry != options.end()) {
+                        option = &optionsEntry->second;
+                        ++i;
+                        if (option->flag == nullptr) {
+                            stateAfterOption = State::FirstArgument;
+                            state = State::OptionValue;
+                        } else {
+                            *option->flag = true;
+                        }
                     } else {
                         environment.mode = Twarlock::Environment::Mode::Execute;
                         state = State::CommandToExecute;
@@ -277,6 +338,12 @@ namespace {
                     state = State::CommandToExecute;
                 } break;
 
+                case State::OptionValue: {
+                    *option->value = arg;
+                    ++i;
+                    state = stateAfterOption;
+                } break;
+
                 case State::Help: {
                     environment.mode = Twarlock::Environment::Mode::CommandHelp;
                     environment.command = arg;
@@ -285,9 +352,20 @@ namespace {
                 } break;
 
                 case State::CommandToExecute: {
-                    environment.command = arg;
-                    ++i;
-                    state = State::CommandArguments;
+                    if (optionsEntry != options.end()) {
+                        option = &optionsEntry->second;
+                        ++i;
+                        if (option->flag == nullptr) {
+                            stateAfterOption = State::CommandToExecute;
+                            state = State::OptionValue;
+                        } else {
+                            *option->flag = true;
+                        }
+                    } else {
+                        environment.command = arg;
+                        ++i;
+                        state = State::CommandArguments;
+                    }
                 } break;
 
                 case State::CommandArguments: {
@@ -319,6 +397,15 @@ namespace {
                 return false;
             } break;
 
+            case State::OptionValue: {
+                diagnosticsSender.SendDiagnosticInformationFormatted(
+                    SystemAbstractions::DiagnosticsSender::Levels::ERROR,
+                    "%s expected",
+                    option->description
+                );
+                return false;
+            } break;
+
             case State::Help: {
                 environment.mode = Twarlock::Environment::Mode::OverallHelp;
             } break;
@@ -412,6 +499,10 @@ int main(int argc, char* argv[]) {
             } else {
                 auto argDetails = command->second.argDetails;
                 argDetails["CFG"] = cfgArgDetails;
+                argDetails["FILE"] = fileArgDetails;
+                argDetails["FMT"] = fmtArgDetails;
+                argDetails["SOCK"] = sockArgDetails;
+                argDetails["SNAP"] = snapArgDetails;
                 PrintUsageInformation(
                     cfgArgSummary + " " + environment.command + " " + command->second.argSummary,
                     command->second.cmdSummary,
@@ -431,6 +522,19 @@ int main(int argc, char* argv[]) {
                 exitStatus = EXIT_FAILURE;
                 break;
             }
+            if (!environment.serverSocketPath.empty()) {
+                if (
+                    !Twarlock::ExecuteOnServer(
+                        environment.serverSocketPath,
+                        environment,
+                        diagnosticsSender,
+                        shutDown
+                    )
+                ) {
+                    exitStatus = EXIT_FAILURE;
+                }
+                break;
+            }
             std::vector< std::string > configurationPaths;
             if (environment.configurationFilePath.empty()) {
                 configurationPaths.push_back(
@@ -488,7 +592,10 @@ int main(int argc, char* argv[]) {
                 break;
             }
             std::string caCerts;
-            const auto caCertsPath = SystemAbstractions::File::GetExeParentDirectory() + "/cert.pem";
+            auto caCertsPath = SystemAbstractions::File::GetExeParentDirectory() + "/cert.pem";
+            if (environment.configuration.Has("caCerts")) {
+                caCertsPath = (std::string)environment.configuration["caCerts"];
+            }
             if (
                 !Twarlock::LoadFile(
                     caCertsPath,
@@ -510,6 +617,28 @@ int main(int argc, char* argv[]) {
                 caCerts,
                 timeKeeper
             );
+
+            // Watch for the user interrupting the program, and cancel
+            // any API calls in progress when they do, so that the command
+            // isn't left waiting for them to complete.
+            std::mutex commandMutex;
+            std::condition_variable commandDone;
+            bool commandFinished = false;
+            std::thread interruptWatcher(
+                [&]{
+                    std::unique_lock< std::mutex > lock(commandMutex);
+                    while (!commandFinished) {
+                        if (shutDown) {
+                            twitch.Cancel();
+                            break;
+                        }
+                        (void)commandDone.wait_for(
+                            lock,
+                            std::chrono::milliseconds(100)
+                        );
+                    }
+                }
+            );
             if (
                 !command->second.execute(
                     environment,
@@ -520,6 +649,12 @@ int main(int argc, char* argv[]) {
             ) {
                 exitStatus = EXIT_FAILURE;
             }
+            {
+                std::lock_guard< std::mutex > lock(commandMutex);
+                commandFinished = true;
+                commandDone.notify_all();
+            }
+            interruptWatcher.join();
             twitch.Demobilize();
         } break;
 
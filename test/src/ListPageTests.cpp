@@ -0,0 +1,254 @@
+/**
+ * @file ListPageTests.cpp
+ *
+ * This module contains the unit tests of the Twarlock::ListPage structure
+ * and the Twarlock::VisitListEntries function.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <gtest/gtest.h>
+#include <ListPage.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+    /**
+     * This decodes the given encoding of a page, extracting the given
+     * fields, and returns the page.
+     *
+     * @param[in] encoding
+     *     This is the JSON encoding of the page.
+     *
+     * @param[in] fields
+     *     These are the names of the fields to extract.
+     *
+     * @param[out] decoded
+     *     This is where to store whether or not the encoding was valid.
+     *
+     * @return
+     *     The decoded page is returned.
+     */
+    Twarlock::ListPage DecodePage(
+        const std::string& encoding,
+        const std::vector< std::string >& fields,
+        bool& decoded
+    ) {
+        Twarlock::ListPage page;
+        page.fields = fields;
+        decoded = page.Decode(encoding);
+        return page;
+    }
+
+}
+
+TEST(ListPageTests, DecodeFieldsCursorAndTotal) {
+    bool decoded;
+    const auto page = DecodePage(
+        (
+            "{"
+            "\"total\": 2,"
+            " \"data\": ["
+            "{\"from_id\": \"123\", \"from_name\": \"alice\", \"extra\": [1, {\"a\": 2}]},"
+            "{\"from_name\": \"bob\", \"from_id\": \"456\"}"
+            "],"
+            " \"pagination\": {\"cursor\": \"abc\"}"
+            "}"
+        ),
+        {"from_id", "from_name"},
+        decoded
+    );
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(2, page.total);
+    EXPECT_EQ("abc", page.cursor);
+    ASSERT_EQ(2, page.GetSize());
+    EXPECT_EQ("123", page.Get(0, 0));
+    EXPECT_EQ("alice", page.Get(0, 1));
+    EXPECT_EQ("456", page.Get(1, 0));
+    EXPECT_EQ("bob", page.Get(1, 1));
+}
+
+TEST(ListPageTests, DecodeEscapes) {
+    bool decoded;
+    const auto page = DecodePage(
+        "{\"data\": [{\"s\": \"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\te\\u0041\\u00e9\\u20ac\"}]}",
+        {"s"},
+        decoded
+    );
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(1, page.GetSize());
+    EXPECT_EQ("a\"b\\c/d\b\f\n\r\teA\xC3\xA9\xE2\x82\xAC", page.Get(0, 0));
+}
+
+TEST(ListPageTests, DecodeSurrogatePair) {
+    bool decoded;
+    const auto page = DecodePage(
+        "{\"data\": [{\"s\": \"\\ud83d\\ude00\"}]}",
+        {"s"},
+        decoded
+    );
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(1, page.GetSize());
+    EXPECT_EQ("\xF0\x9F\x98\x80", page.Get(0, 0));
+}
+
+TEST(ListPageTests, DecodeUnpairedSurrogatesAsReplacementCharacters) {
+    struct TestVector {
+        std::string encoded;
+        std::string expected;
+    };
+    const std::vector< TestVector > testVectors{
+        // High surrogate followed by an escape which isn't a low surrogate
+        {"\\ud83d\\u0041", "\xEF\xBF\xBD" "A"},
+
+        // High surrogate followed by another high surrogate
+        {"\\ud83d\\ud83d\\ude00", "\xEF\xBF\xBD\xF0\x9F\x98\x80"},
+
+        // High surrogate at the end of the string
+        {"x\\ud83d", "x\xEF\xBF\xBD"},
+
+        // High surrogate followed by a plain character
+        {"\\ud83dz", "\xEF\xBF\xBD" "z"},
+
+        // Low surrogate on its own
+        {"\\ude00", "\xEF\xBF\xBD"},
+    };
+    for (const auto& testVector: testVectors) {
+        bool decoded;
+        const auto page = DecodePage(
+            "{\"data\": [{\"s\": \"" + testVector.encoded + "\"}]}",
+            {"s"},
+            decoded
+        );
+        ASSERT_TRUE(decoded) << testVector.encoded;
+        ASSERT_EQ(1, page.GetSize()) << testVector.encoded;
+        EXPECT_EQ(testVector.expected, page.Get(0, 0)) << testVector.encoded;
+    }
+}
+
+TEST(ListPageTests, DecodeNestedDottedFields) {
+    bool decoded;
+    const auto page = DecodePage(
+        (
+            "{\"data\": [{"
+            "\"event_type\": \"moderation.user.ban\","
+            " \"event_data\": {\"user_id\": \"42\", \"detail\": {\"reason\": \"spam\"}, \"skipped\": {\"x\": 1}},"
+            " \"user_id\": \"7\""
+            "}]}"
+        ),
+        {"event_type", "event_data.user_id", "event_data.detail.reason", "event_data.skipped"},
+        decoded
+    );
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(1, page.GetSize());
+    EXPECT_EQ("moderation.user.ban", page.Get(0, 0));
+    EXPECT_EQ("42", page.Get(0, 1));
+    EXPECT_EQ("spam", page.Get(0, 2));
+    EXPECT_EQ("", page.Get(0, 3));
+}
+
+TEST(ListPageTests, DecodeNullAndMissingFieldsAsEmpty) {
+    bool decoded;
+    const auto page = DecodePage(
+        (
+            "{\"data\": ["
+            "{\"a\": null, \"b\": 5, \"c\": true},"
+            "{\"a\": \"x\"}"
+            "]}"
+        ),
+        {"a", "b", "c"},
+        decoded
+    );
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(2, page.GetSize());
+    EXPECT_EQ("", page.Get(0, 0));
+    EXPECT_EQ("5", page.Get(0, 1));
+    EXPECT_EQ("true", page.Get(0, 2));
+    EXPECT_EQ("x", page.Get(1, 0));
+    EXPECT_EQ("", page.Get(1, 1));
+    EXPECT_EQ("", page.Get(1, 2));
+}
+
+TEST(ListPageTests, DecodeWithoutPagination) {
+    bool decoded;
+    const auto page = DecodePage(
+        "{\"data\": [{\"a\": \"1\"}]}",
+        {"a"},
+        decoded
+    );
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ("", page.cursor);
+    EXPECT_EQ(0, page.total);
+    ASSERT_EQ(1, page.GetSize());
+}
+
+TEST(ListPageTests, DecodeEmptyPaginationAndNullCursor) {
+    for (const auto& pagination: {"{}", "{\"cursor\": null}", "null"}) {
+        bool decoded;
+        const auto page = DecodePage(
+            std::string("{\"data\": [], \"pagination\": ") + pagination + "}",
+            {"a"},
+            decoded
+        );
+        ASSERT_TRUE(decoded) << pagination;
+        EXPECT_EQ("", page.cursor) << pagination;
+        EXPECT_EQ(0, page.GetSize()) << pagination;
+    }
+}
+
+TEST(ListPageTests, ReplaceContentsOnDecode) {
+    Twarlock::ListPage page;
+    page.fields = {"a"};
+    ASSERT_TRUE(page.Decode("{\"data\": [{\"a\": \"1\"}, {\"a\": \"2\"}], \"pagination\": {\"cursor\": \"c\"}}"));
+    ASSERT_TRUE(page.Decode("{\"data\": [{\"a\": \"3\"}]}"));
+    ASSERT_EQ(1, page.GetSize());
+    EXPECT_EQ("3", page.Get(0, 0));
+    EXPECT_EQ("", page.cursor);
+}
+
+TEST(ListPageTests, RejectMalformedInput) {
+    const std::vector< std::string > testVectors{
+        "",
+        "[]",
+        "{",
+        "{\"data\": [",
+        "{\"data\": [{\"a\": \"1\"}",
+        "{\"data\": [{\"a\": \"1\"},]}",
+        "{\"data\": [{\"a\" \"1\"}]}",
+        "{\"data\": [{\"a\": \"unterminated}]}",
+        "{\"data\": [{\"a\": \"bad \\x escape\"}]}",
+        "{\"data\": [{\"a\": \"\\u12\"}]}",
+        "{\"data\": [{\"a\": \"\\ud83d\\u12\"}]}",
+        "{\"data\": [{\"a\": }]}",
+        "{\"total\": }",
+        "{\"pagination\": {\"cursor\": \"abc}}",
+        "{data: []}",
+    };
+    for (const auto& testVector: testVectors) {
+        bool decoded;
+        (void)DecodePage(testVector, {"a"}, decoded);
+        EXPECT_FALSE(decoded) << testVector;
+    }
+}
+
+TEST(ListPageTests, VisitEntriesInOrder) {
+    std::vector< std::string > visited;
+    std::string cursor = "stale";
+    intmax_t total = -1;
+    ASSERT_TRUE(
+        Twarlock::VisitListEntries(
+            "{\"data\": [{\"id\": \"1\"}, {\"id\": \"2\"}, {\"id\": \"3\"}]}",
+            {"id"},
+            [&](const std::vector< std::string >& values){
+                visited.push_back(values[0]);
+            },
+            cursor,
+            total
+        )
+    );
+    EXPECT_EQ((std::vector< std::string >{"1", "2", "3"}), visited);
+    EXPECT_EQ("", cursor);
+    EXPECT_EQ(0, total);
+}